@@ -0,0 +1,69 @@
+// Measures SHA-256 throughput of the addon's software and hardware backends, on one thread and on every core, next to
+// node:crypto (OpenSSL) on one thread as a reference.
+//
+// Usage: node bench/hash.js [megabytes] [iterations]
+import { createHash } from 'node:crypto';
+import os from 'node:os';
+import { performance } from 'node:perf_hooks';
+import { fileURLToPath } from 'node:url';
+import native from 'node-gyp-build';
+import nstool from '../index.js';
+
+const [megabyteArgument = '64', iterationArgument = '5'] = process.argv.slice(2);
+const bytes = Number.parseInt(megabyteArgument, 10) * 1024 * 1024;
+const iterations = Number.parseInt(iterationArgument, 10);
+const addon = native(fileURLToPath(new URL('..', import.meta.url)));
+
+function row(backend, threads, total, seconds) {
+  const megabytesPerSecond = total / seconds / 1024 / 1024;
+
+  return {
+    backend,
+    threads,
+    'MB/s': megabytesPerSecond.toFixed(0),
+    'MB/s per core': (megabytesPerSecond / threads).toFixed(0),
+  };
+}
+
+// Keeps the fastest run after a warm-up run.
+function measure(backend, threads) {
+  let best = Infinity;
+  let total = 0;
+
+  for (let i = 0; i <= iterations; i++) {
+    const result = addon.hashBenchmark(bytes, threads, backend);
+
+    if (i > 0) {
+      best = Math.min(best, result.seconds);
+      total = result.bytes;
+    }
+  }
+
+  return row(backend, threads, total, best);
+}
+
+function measureNodeCrypto() {
+  const buffer = Buffer.alloc(bytes);
+  let best = Infinity;
+
+  for (let i = 0; i <= iterations; i++) {
+    const start = performance.now();
+    createHash('sha256').update(buffer).digest();
+
+    if (i > 0) {
+      best = Math.min(best, (performance.now() - start) / 1000);
+    }
+  }
+
+  return row('node:crypto', 1, bytes, best);
+}
+
+const cores = os.availableParallelism();
+const backend = nstool.cryptoBackend();
+const backends = [...new Set(['software', backend.sha256])];
+
+console.log(`SHA-256: ${backend.sha256} (cpu sha2: ${backend.cpu.sha2}), ${megabyteArgument} MiB per thread`);
+console.table([
+  ...backends.flatMap((name) => [measure(name, 1), measure(name, cores)]),
+  measureNodeCrypto(),
+]);
@@ -0,0 +1,96 @@
+// Compares the file stream and memory-mapped input backends by reading every file of a package through open() and
+// read(), on a cold and a warm page cache. Dropping the page cache needs Linux and root; elsewhere only warm runs are
+// measured.
+//
+// Usage: node bench/input.js <source> [iterations]
+import fs from 'node:fs';
+import os from 'node:os';
+import path from 'node:path';
+import { performance } from 'node:perf_hooks';
+import nstool from '../index.js';
+
+const [source, iterationArgument = '5'] = process.argv.slice(2);
+const iterations = Number.parseInt(iterationArgument, 10);
+const chunkSize = 1024 * 1024;
+
+if (!source) {
+  console.error('Usage: node bench/input.js <source> [iterations]');
+  process.exit(1);
+}
+
+function dropPageCache() {
+  try {
+    fs.writeFileSync('/proc/sys/vm/drop_caches', '3');
+    return true;
+  } catch {
+    return false;
+  }
+}
+
+// Discover the virtual paths once by extracting through the engine.
+const outputDirectory = fs.mkdtempSync(path.join(os.tmpdir(), 'node-nstool-bench-'));
+const listing = nstool.open({ source }).extract({ outputDirectory });
+
+if (listing.error) {
+  throw new Error(listing.errorMessage);
+}
+
+const files = listing.files.map((file) => ({
+  innerPath: `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`,
+  size: fs.statSync(file).size,
+}));
+fs.rmSync(outputDirectory, { recursive: true, force: true });
+
+function readAll(input, access) {
+  const start = performance.now();
+  const pkg = nstool.open({ source, input, access });
+  const target = Buffer.alloc(chunkSize);
+  let bytes = 0;
+
+  for (const { innerPath, size } of files) {
+    for (let offset = 0; offset < size; offset += chunkSize) {
+      bytes += pkg.read(innerPath, offset, chunkSize, target);
+    }
+  }
+
+  pkg.close();
+
+  return { ms: performance.now() - start, bytes };
+}
+
+const rows = [];
+const canDropCache = process.platform === 'linux' && dropPageCache();
+
+for (const cache of canDropCache ? ['cold', 'warm'] : ['warm']) {
+  for (const [input, access] of [['stream', 'normal'], ['mmap', 'sequential'], ['mmap', 'random']]) {
+    const durations = [];
+    let bytes = 0;
+
+    if (cache === 'warm') {
+      readAll(input, access);
+    }
+
+    for (let i = 0; i < iterations; i++) {
+      if (cache === 'cold') {
+        dropPageCache();
+      }
+
+      const run = readAll(input, access);
+      durations.push(run.ms);
+      bytes = run.bytes;
+    }
+
+    durations.sort((a, b) => a - b);
+    const median = durations[Math.floor(durations.length / 2)];
+
+    rows.push({
+      cache,
+      input,
+      access,
+      medianMs: median.toFixed(2),
+      mibPerSecond: (bytes / 1024 / 1024 / (median / 1000)).toFixed(1),
+    });
+  }
+}
+
+console.table(rows);
@@ -0,0 +1,72 @@
+// Compares the JSON.parse and native result construction paths of information() on a package. Each path is measured
+// in a process of its own, so the peak resident set size it reports belongs to that path alone.
+//
+// Usage: node bench/parse.js <source> [iterations]
+import { fork } from 'node:child_process';
+import { fileURLToPath } from 'node:url';
+import { performance } from 'node:perf_hooks';
+import nstool from '../index.js';
+
+const [source, iterationArgument = '10', parser] = process.argv.slice(2);
+const iterations = Number.parseInt(iterationArgument, 10);
+
+if (!source) {
+  console.error('Usage: node bench/parse.js <source> [iterations]');
+  process.exit(1);
+}
+
+const mebibytes = (bytes) => (bytes / 1024 / 1024).toFixed(1);
+
+function measure() {
+  const durations = [];
+  let peakHeap = 0;
+  let peakExternal = 0;
+
+  // Warm up before measuring.
+  nstool.information({ source, parser });
+
+  for (let i = 0; i < iterations; i++) {
+    globalThis.gc?.();
+
+    const start = performance.now();
+    const result = nstool.information({ source, parser });
+    durations.push(performance.now() - start);
+
+    if (result.error) {
+      throw new Error(result.errorMessage);
+    }
+
+    // Sampled while the result is still alive, so whatever it holds counts towards the peak.
+    const usage = process.memoryUsage();
+    peakHeap = Math.max(peakHeap, usage.heapUsed);
+    peakExternal = Math.max(peakExternal, usage.external);
+  }
+
+  durations.sort((a, b) => a - b);
+
+  return {
+    parser,
+    medianMs: durations[Math.floor(durations.length / 2)].toFixed(2),
+    minMs: durations[0].toFixed(2),
+    peakHeapMiB: mebibytes(peakHeap),
+    peakExternalMiB: mebibytes(peakExternal),
+    // maxRSS is the high-water mark of the whole process in KiB, which includes the native side of each call.
+    peakRssMiB: mebibytes(process.resourceUsage().maxRSS * 1024),
+  };
+}
+
+function run(name) {
+  return new Promise((resolve, reject) => {
+    const child = fork(fileURLToPath(import.meta.url), [source, iterationArgument, name]);
+
+    child.once('message', resolve);
+    child.once('error', reject);
+    child.once('exit', (code) => code !== 0 && reject(new Error(`The ${name} measurement exited with ${code}.`)));
+  });
+}
+
+if (parser) {
+  process.send(measure(), () => process.disconnect());
+} else {
+  console.table([await run('json'), await run('native')]);
+}
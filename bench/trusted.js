@@ -0,0 +1,67 @@
+// Compares extracting the RomFS of a package with and without trusted: true, on one thread and on every core. The
+// default pattern selects section 1 of every content archive, which is the RomFS of a program; pass another to
+// measure a different section.
+//
+// Usage: node bench/trusted.js <source> [pattern] [iterations]
+import fs from 'node:fs';
+import os from 'node:os';
+import path from 'node:path';
+import nstool from '../index.js';
+
+const [source, pattern = '/**/*.nca/1/**', iterationArgument = '3'] = process.argv.slice(2);
+const iterations = Number.parseInt(iterationArgument, 10);
+
+if (!source) {
+  console.error('Usage: node bench/trusted.js <source> [pattern] [iterations]');
+  process.exit(1);
+}
+
+// Keeps the best run, each into a fresh directory that is removed afterwards.
+function measure(trusted, concurrency) {
+  let best;
+
+  for (let i = 0; i < iterations; i++) {
+    const outputDirectory = fs.mkdtempSync(path.join(os.tmpdir(), 'node-nstool-bench-'));
+    const result = nstool.extract({ source, outputDirectory, include: [pattern], concurrency, trusted });
+
+    fs.rmSync(outputDirectory, { recursive: true, force: true });
+
+    if (result.error) {
+      throw new Error(result.errorMessage);
+    }
+
+    if (result.trusted !== trusted) {
+      throw new Error(`The extraction reported trusted: ${result.trusted}.`);
+    }
+
+    if (!best || result.throughput.seconds < best.seconds) {
+      best = result.throughput;
+    }
+  }
+
+  if (best.fileCount === 0) {
+    throw new Error(`Nothing in ${source} matches ${pattern}.`);
+  }
+
+  return {
+    trusted,
+    concurrency,
+    files: best.fileCount,
+    'MB': (best.bytes / 1024 / 1024).toFixed(0),
+    'seconds': best.seconds.toFixed(2),
+    'MB/s': (best.bytesPerSecond / 1024 / 1024).toFixed(0),
+  };
+}
+
+const rows = [1, os.availableParallelism()].flatMap((concurrency) => [
+  measure(false, concurrency),
+  measure(true, concurrency),
+]);
+
+console.table(rows);
+
+for (let i = 0; i < rows.length; i += 2) {
+  const delta = (Number(rows[i]['seconds']) / Number(rows[i + 1]['seconds']) - 1) * 100;
+
+  console.log(`concurrency ${rows[i].concurrency}: trusted is ${delta.toFixed(1)}% faster`);
+}
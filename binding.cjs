@@ -36,14 +36,20 @@ function usePrebuiltLibraries() {
 switch (arg[0]) {
   case 'sources': {
     const directory = './deps/nstool/src';
+    // Compiled through the wrappers in src/ instead, see src/nstool-main.cpp, src/nstool-nca-process.cpp and
+    // src/nstool-settings.cpp.
+    const wrapped = ['main.cpp', 'NcaProcess.cpp', 'Settings.cpp'];
 
-    fs.readdirSync(directory).filter((file) => file.endsWith('.c') || file.endsWith('.cpp')).forEach((file) => list.push(`${directory}/${file}`));
+    fs.readdirSync(directory)
+      .filter((file) => (file.endsWith('.c') || file.endsWith('.cpp')) && !wrapped.includes(file))
+      .forEach((file) => list.push(`${directory}/${file}`));
     break;
   }
   case 'include_dirs':
     list = [
       './deps/nstool/src',
       './src/include',
+      './deps',
       './deps/nstool/deps/libfmt/include',
       './deps/nstool/deps/liblz4/include',
       './deps/nstool/deps/libmbedtls/include',
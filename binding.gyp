@@ -6,14 +6,48 @@
         {
             'target_name': 'node-nstool',
             'sources': [
+                'src/batch.cpp',
+                'src/block-cache.cpp',
+                'src/cancellation.cpp',
+                'src/compact-tree.cpp',
+                'src/container.cpp',
+                'src/cpu-features.cpp',
+                'src/crypto-backend.cpp',
+                'src/event-stream.cpp',
+                'src/extract.cpp',
+                'src/file-type.cpp',
+                'src/index-handle.cpp',
+                'src/json-value.cpp',
+                'src/key-cache.cpp',
+                'src/mapped-file-stream.cpp',
+                'src/metadata-index.cpp',
                 'src/node-nstool.cpp',
+                'src/nstool-main.cpp',
+                'src/nstool-nca-process.cpp',
+                'src/nstool-session.cpp',
+                'src/nstool-settings.cpp',
+                'src/offset-probe.cpp',
+                'src/output-sink.cpp',
+                'src/package-fs.cpp',
+                'src/package.cpp',
+                'src/parallel.cpp',
+                'src/progress.cpp',
+                'src/scan.cpp',
+                'src/selection.cpp',
+                'src/sha256.cpp',
+                'src/split-source.cpp',
+                'src/string-list.cpp',
+                'src/verify.cpp',
                 "<!@(node binding.cjs sources)"
             ],
             'cflags': [
                 '-std=c++20',
             ],
             'cflags_cc': [
-                '-std=c++20'
+                '-std=c++20',
+                # Gives every nstool run its own std::cout, see src/include/nstool-output.h.
+                '-include',
+                'nstool-output.h'
             ],
             'cflags!': [
                 '-fno-exceptions',
@@ -27,7 +61,8 @@
                 "<!(node -p \"require('node-api-headers').include_dir\")",
                 "<!(node -p \"require('node-addon-api').include_dir\")",
                 "<!@(node -p \"require('node-addon-api').include\")",
-                "<!@(node binding.cjs include_dirs)"
+                "<!@(node binding.cjs include_dirs)",
+                'scripts'
             ],
             'libraries': [
                 '<!@(node binding.cjs libraries)'
@@ -38,6 +73,8 @@
             ],
             'defines': [
                 'NODE_ADDON_API',
+                # Compile against the same mbedtls configuration the library was built with, see scripts/cmake-build.cjs.
+                'MBEDTLS_USER_CONFIG_FILE=<mbedtls-config.h>',
             ],
             'msvs_settings': {
                 'VCCLCompilerTool': {
@@ -48,6 +85,7 @@
                         '/utf-8'
                     ],
                     'ExceptionHandling': 1,
+                    'ForcedIncludeFiles': ['nstool-output.h'],
                     'RuntimeLibrary': 2
                 },
             },
@@ -62,7 +100,8 @@
                     '-arch arm64',
                     '-std=c++20',
                     '-stdlib=libc++',
-                    '-fexceptions'
+                    '-fexceptions',
+                    '-include nstool-output.h'
                 ],
                 'OTHER_LDFLAGS': [
                     '-arch x86_64',
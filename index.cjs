@@ -1,14 +1,566 @@
 const fs = require('node:fs');
+const os = require('node:os');
+const path = require('node:path');
+const { Readable } = require('node:stream');
 const nstool = require('node-gyp-build')(__dirname);
 
+// Streams a file inside a package. Each chunk is read and decrypted on the libuv threadpool, and the next chunk is
+// only requested once the consumer asks for more.
+class PackageReadStream extends Readable {
+  constructor(pkg, innerPath, options, ownsPackage) {
+    super({ highWaterMark: options?.highWaterMark ?? 64 * 1024 });
+
+    this.pkg = pkg;
+    this.innerPath = innerPath;
+    this.position = options?.start ?? 0;
+    // Like fs.createReadStream(), end is inclusive.
+    this.end = options?.end ?? Infinity;
+    this.ownsPackage = ownsPackage;
+    this.reader = undefined;
+  }
+
+  // The reader keeps the file open between chunks, so each chunk continues where the previous one ended.
+  _construct(callback) {
+    try {
+      this.reader = new nstool.PackageReader(this.pkg.handle, this.innerPath);
+      callback();
+    } catch (error) {
+      callback(error);
+    }
+  }
+
+  _read(size) {
+    const length = Math.min(size, this.end - this.position + 1);
+
+    if (length <= 0) {
+      this.push(null);
+      return;
+    }
+
+    this.reader.readAsync(this.position, length).then((chunk) => {
+      if (chunk.length === 0) {
+        this.push(null);
+        return;
+      }
+
+      this.position += chunk.length;
+      this.push(chunk);
+    }, (error) => this.destroy(error));
+  }
+
+  _destroy(error, callback) {
+    this.reader?.close();
+
+    if (this.ownsPackage) {
+      this.pkg.close();
+    }
+
+    callback(error);
+  }
+}
+
+// A filesystem tree that lists one directory level at a time, for fstree: 'lazy'.
+class LazyTree {
+  // Closes the packages of trees that were garbage collected without close(), so their source files are not held open
+  // until the native handle happens to be collected as well.
+  static packages = new FinalizationRegistry((pkg) => pkg.close());
+
+  constructor(pkg, ownsPackage) {
+    this.pkg = pkg;
+    this.ownsPackage = ownsPackage;
+
+    if (ownsPackage) {
+      LazyTree.packages.register(this, pkg, this);
+    }
+  }
+
+  // Lists the directories, files and nested containers directly below a virtual path.
+  children(innerPath = '/') {
+    if (typeof innerPath !== 'string') {
+      return nodeNSTool.error('The path of the directory you want to list must be a string.');
+    }
+
+    try {
+      return this.pkg.handle.children(innerPath);
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  close() {
+    if (this.ownsPackage) {
+      LazyTree.packages.unregister(this);
+      this.pkg.close();
+    }
+  }
+}
+
+// Path lookups over the typed arrays returned by exportTree(). Only needs the plain { parent, nameOffset, nameLength,
+// size, dataOffset, flags, names } object, so a tree transferred to a worker thread can be wrapped again on the other
+// side.
+class CompactTree {
+  static directoryFlag = 1;
+  static containerFlag = 2;
+
+  constructor(tree) {
+    this.parent = tree.parent;
+    this.nameOffset = tree.nameOffset;
+    this.nameLength = tree.nameLength;
+    this.size = tree.size;
+    this.dataOffset = tree.dataOffset;
+    this.flags = tree.flags;
+    this.names = Buffer.isBuffer(tree.names)
+      ? tree.names
+      : Buffer.from(tree.names.buffer, tree.names.byteOffset, tree.names.byteLength);
+    this.firstChild = undefined;
+    this.childCount = undefined;
+  }
+
+  get length() {
+    return this.parent.length;
+  }
+
+  // Children are contiguous in breadth-first order, so each entry only needs its first child and their count.
+  index() {
+    if (this.firstChild) {
+      return;
+    }
+
+    this.firstChild = new Int32Array(this.length).fill(-1);
+    this.childCount = new Uint32Array(this.length);
+
+    for (let entry = 1; entry < this.length; ++entry) {
+      const parent = this.parent[entry];
+
+      if (this.childCount[parent]++ === 0) {
+        this.firstChild[parent] = entry;
+      }
+    }
+  }
+
+  name(entry) {
+    const start = this.nameOffset[entry];
+
+    return this.names.toString('utf8', start, start + this.nameLength[entry]);
+  }
+
+  path(entry) {
+    const segments = [];
+
+    for (let current = entry; current > 0; current = this.parent[current]) {
+      segments.push(this.name(current));
+    }
+
+    return `/${segments.reverse().join('/')}`;
+  }
+
+  isDirectory(entry) {
+    return (this.flags[entry] & CompactTree.directoryFlag) !== 0;
+  }
+
+  isContainer(entry) {
+    return (this.flags[entry] & CompactTree.containerFlag) !== 0;
+  }
+
+  children(entry = 0) {
+    this.index();
+
+    const first = this.firstChild[entry];
+
+    return first < 0 ? [] : Array.from({ length: this.childCount[entry] }, (_, offset) => first + offset);
+  }
+
+  // The index of the entry at a virtual path, or -1. Names are compared as bytes without decoding the string table.
+  lookup(innerPath) {
+    this.index();
+
+    let entry = 0;
+
+    for (const segment of innerPath.split('/')) {
+      if (segment === '') {
+        continue;
+      }
+
+      const name = Buffer.from(segment);
+      const first = this.firstChild[entry];
+      const last = first + this.childCount[entry];
+
+      entry = -1;
+
+      for (let child = first; child < last; ++child) {
+        const start = this.nameOffset[child];
+        const end = start + this.nameLength[child];
+
+        if (end - start === name.length && this.names.compare(name, 0, name.length, start, end) === 0) {
+          entry = child;
+          break;
+        }
+      }
+
+      if (entry < 0) {
+        return -1;
+      }
+    }
+
+    return entry;
+  }
+
+  // Where the data of the file at a virtual path starts in the source, or -1 when the path is not a file of the tree
+  // or its offset is unknown.
+  dataOffsetOf(innerPath) {
+    const entry = this.lookup(innerPath);
+
+    return entry < 0 ? -1 : this.dataOffset[entry];
+  }
+}
+
+// A package opened with nodeNSTool.open(). The native handle keeps the parsed container between calls.
+class Package {
+  constructor(handle, parameters, fstree, trusted) {
+    this.handle = handle;
+    this.parameters = parameters;
+    this.fstree = fstree;
+    this.trusted = trusted;
+  }
+
+  info() {
+    try {
+      const results = this.handle.info();
+
+      results.parameters = this.parameters;
+      results.trusted = this.trusted;
+
+      return results;
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  // info() produced on the libuv threadpool.
+  async infoAsync() {
+    try {
+      const results = await this.handle.infoAsync();
+
+      results.parameters = this.parameters;
+      results.trusted = this.trusted;
+
+      return results;
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  tree() {
+    if (this.fstree === 'lazy') {
+      return new LazyTree(this, false);
+    }
+
+    try {
+      return this.handle.tree();
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  // The whole tree as typed arrays and a string table, wrapped in a CompactTree.
+  exportTree(options) {
+    try {
+      return new CompactTree(this.handle.exportTree(options?.nested ?? false));
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  async exportTreeAsync(options) {
+    try {
+      return new CompactTree(await this.handle.exportTreeAsync(options?.nested ?? false));
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  checkExtractOptions(options) {
+    const invalid = nodeNSTool.checkOutputDirectory(options)
+      ?? nodeNSTool.checkConcurrency(options)
+      ?? nodeNSTool.checkChunkSize(options)
+      ?? nodeNSTool.checkSelection(options)
+      ?? nodeNSTool.checkProgress(options)
+      ?? nodeNSTool.checkSignal(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    if (typeof options?.path !== 'undefined' && typeof options.path !== 'string') {
+      return nodeNSTool.error('The path of the file or directory you want to extract must be a string.');
+    }
+
+    return undefined;
+  }
+
+  // A { files, include } selection when either is given, otherwise the single path.
+  target(options) {
+    if (typeof options.files !== 'undefined' || typeof options.include !== 'undefined') {
+      return { files: options.files ?? [], include: options.include ?? [] };
+    }
+
+    return options.path;
+  }
+
+  extract(options) {
+    const invalid = this.checkExtractOptions(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    if (typeof options.onProgress !== 'undefined') {
+      return nodeNSTool.error('Progress is only reported by extractAsync().');
+    }
+
+    try {
+      return this.handle.extract(
+        options.outputDirectory,
+        this.target(options),
+        options.concurrency,
+        options.chunkSize,
+      );
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  async extractAsync(options) {
+    const invalid = this.checkExtractOptions(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    const { token, release } = nodeNSTool.cancellation(options.signal);
+
+    try {
+      return await this.handle.extractAsync(
+        options.outputDirectory,
+        this.target(options),
+        options.concurrency,
+        options.chunkSize,
+        options.onProgress,
+        token,
+      );
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    } finally {
+      release();
+    }
+  }
+
+  read(innerPath, offset = 0, length = undefined, target = undefined) {
+    if (typeof innerPath !== 'string') {
+      return nodeNSTool.error('The path of the file you want to read must be a string.');
+    }
+
+    if (typeof target !== 'undefined' && !Buffer.isBuffer(target)) {
+      return nodeNSTool.error('The target to read into must be a Buffer.');
+    }
+
+    try {
+      // Returns a new Buffer, or the number of bytes written into the target.
+      return this.handle.read(innerPath, offset, length, target);
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  createReadStream(innerPath, options) {
+    const invalid = nodeNSTool.checkReadStreamOptions(innerPath, options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    return new PackageReadStream(this, innerPath, options, false);
+  }
+
+  close() {
+    this.handle.close();
+  }
+}
+
+// A persistent index of information results opened with nodeNSTool.openIndex(). Unchanged sources are answered from
+// the index file without running nstool.
+class MetadataIndex {
+  constructor(handle) {
+    this.handle = handle;
+  }
+
+  // The index is keyed by the arguments, so sources are made absolute to match however they were given.
+  prepare(options) {
+    const source = typeof options?.source === 'string' ? path.resolve(options.source) : options?.source;
+
+    return nodeNSTool.prepare({ ...options, source }, nodeNSTool.informationParameters(options));
+  }
+
+  information(options) {
+    const passing = this.prepare(options);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    try {
+      const results = this.handle.information(passing);
+
+      results.parameters = passing;
+
+      return results;
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  async informationAsync(options) {
+    const passing = this.prepare(options);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    try {
+      const results = await nodeNSTool.abortable(this.handle.informationAsync(passing), options?.signal);
+
+      results.parameters = passing;
+
+      return results;
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  checkVerifyOptions(options) {
+    const { sample } = options ?? {};
+
+    if (typeof sample !== 'undefined' && (!Number.isInteger(sample) || sample < 1)) {
+      return nodeNSTool.error('The "sample" option must be a positive integer.');
+    }
+
+    return undefined;
+  }
+
+  verify(options) {
+    const invalid = this.checkVerifyOptions(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    try {
+      return this.handle.verify(options?.sample);
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  async verifyAsync(options) {
+    const invalid = this.checkVerifyOptions(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    try {
+      return await this.handle.verifyAsync(options?.sample);
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  compact() {
+    try {
+      return this.handle.compact();
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  stats() {
+    try {
+      return this.handle.stats();
+    } catch (error) {
+      return nodeNSTool.error(error.message);
+    }
+  }
+
+  close() {
+    this.handle.close();
+  }
+}
+
 const nodeNSTool = {
+  CompactTree,
   error(errorMessage) {
     return {
       error: true,
       errorMessage,
     };
   },
-  run(options, parameters) {
+  prepare(options, parameters) {
+    if (typeof options?.parser !== 'undefined' && !['json', 'native'].includes(options.parser)) {
+      return this.error(`The parser must be either "json" or "native". Given: ${options.parser}`);
+    }
+
+    const invalid = this.checkSignal(options) ?? this.checkFsTree(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    this.outputParameters(options, parameters);
+
+    if (typeof options?.type !== 'undefined') {
+      parameters.push('--type');
+      parameters.push(options.type.toLowerCase());
+    }
+
+    // Make sure that the user provided a source file to process, or the parts of a split dump in order.
+    const parts = typeof options?.source === 'string' ? [options.source] : options?.source;
+
+    if (!Array.isArray(parts) || parts.length === 0 || parts.some((part) => typeof part !== 'string')) {
+      return this.error('Provide a source file using the "source" option.');
+    }
+
+    // Make sure that every source file is readable.
+    for (const part of parts) {
+      try {
+        fs.accessSync(part, fs.constants.R_OK);
+      } catch {
+        return this.error(`The source file is not readable. Given: ${part}`);
+      }
+    }
+
+    return [...parameters, parts[0]];
+  },
+  // The parts to pass to the native side when the source is given as a list of parts.
+  sourceParts(source) {
+    return Array.isArray(source) ? source : undefined;
+  },
+  // nstool runs find the parts of a split dump from its first part, so parts given under other names are only read
+  // through open(), createReadStream() and verify().
+  checkPartNames(source) {
+    if (!Array.isArray(source) || source.length < 2) {
+      return undefined;
+    }
+
+    const found = nstool.splitParts(source[0]);
+
+    if (found.length === source.length && found.every((part, index) => part === source[index])) {
+      return undefined;
+    }
+
+    return this.error('nstool finds split parts by name. Read parts named otherwise with open() or verify().');
+  },
+  // Adds the switches that select what nstool prints.
+  outputParameters(options, parameters) {
     if (typeof options?.showKeys !== 'undefined') {
       parameters.push('--showkeys');
     }
@@ -21,47 +573,145 @@ const nodeNSTool = {
       parameters.push('--verbose');
     }
 
-    if (typeof options?.type !== 'undefined') {
-      parameters.push('--type');
-      parameters.push(options.type.toLowerCase());
+    return parameters;
+  },
+  run(options, parameters) {
+    if (typeof options?.onEvent !== 'undefined') {
+      return this.error('Events are only streamed by the asynchronous methods.');
     }
 
-    // Make sure that the user provided a source file to process.
-    if (typeof options?.source === 'undefined' || typeof options.source !== 'string') {
-      return this.error('Provide a source file using the "source" option.');
+    const passing = this.prepare(options, parameters);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    const misnamed = this.checkPartNames(options.source);
+
+    if (misnamed) {
+      return misnamed;
     }
 
-    // Make sure that the source file is readable.
     try {
-      fs.accessSync(options.source, fs.constants.R_OK);
-    } catch {
-      return this.error(`The source file is not readable. Given: ${options.source}`);
+      // The native parser builds the result object directly instead of handing a JSON string to JSON.parse.
+      const results = options.parser === 'native'
+        ? nstool.runObject(...passing)
+        : JSON.parse(nstool.run(...passing));
+
+      results.parameters = passing;
+
+      return results;
+    } catch (error) {
+      // Convert Napi::Error exceptions.
+      return this.error(error.message);
+    }
+  },
+  async runAsync(options, parameters) {
+    const invalid = this.checkEvents(options);
+
+    if (invalid) {
+      return invalid;
     }
 
-    const passing = [...parameters, options.source];
+    const passing = this.prepare(options, parameters);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    const misnamed = this.checkPartNames(options.source);
+
+    if (misnamed) {
+      return misnamed;
+    }
+
+    if (typeof options.onEvent !== 'undefined') {
+      return this.runStreamingAsync(options, passing);
+    }
+
+    const { token, release } = this.cancellation(options.signal);
+    const cancellable = token ? [...passing, token] : passing;
 
     try {
-      const results = JSON.parse(nstool.run(...passing));
+      // nstool runs on the libuv threadpool so the event loop stays responsive. An abort stops the run at its next
+      // read of the source, and the call settles once the run has stopped.
+      const results = options.parser === 'native'
+        ? await nstool.runObjectAsync(...cancellable)
+        : JSON.parse(await nstool.runAsync(...cancellable));
 
       results.parameters = passing;
 
       return results;
     } catch (error) {
-      // Convert Napi::Error exceptions.
+      // Convert rejected Napi::Error values.
       return this.error(error.message);
+    } finally {
+      release();
     }
   },
-  information(options) {
+  checkEvents(options) {
+    if (typeof options?.onEvent !== 'undefined' && typeof options.onEvent !== 'function') {
+      return this.error('The "onEvent" option must be a function.');
+    }
+
+    const { size, policy } = options?.eventQueue ?? {};
+
+    if (typeof size !== 'undefined' && (!Number.isInteger(size) || size < 1)) {
+      return this.error('The event queue size must be a positive integer.');
+    }
+
+    if (typeof policy !== 'undefined' && !['block', 'drop', 'coalesce'].includes(policy)) {
+      return this.error(`The event queue policy must be "block", "drop" or "coalesce". Given: ${policy}`);
+    }
+
+    return undefined;
+  },
+  // Hands events to options.onEvent while nstool runs instead of collecting them in the result. After an abort
+  // onEvent receives nothing more, and the call settles once the run has stopped.
+  async runStreamingAsync(options, passing) {
+    const { token, release } = this.cancellation(options.signal);
+
+    try {
+      const results = await nstool.runStreamingAsync(
+        passing,
+        options.onEvent,
+        options.eventQueue?.size,
+        options.eventQueue?.policy,
+        token,
+      );
+
+      results.parameters = passing;
+
+      return results;
+    } catch (error) {
+      // Convert rejected Napi::Error values.
+      return this.error(error.message);
+    } finally {
+      release();
+    }
+  },
+  checkFsTree(options) {
+    if (typeof options?.fstree !== 'undefined' && ![false, 'lazy', 'full'].includes(options.fstree)) {
+      return this.error(`The fstree option must be false, "lazy" or "full". Given: ${options.fstree}`);
+    }
+
+    return undefined;
+  },
+  informationParameters(options) {
     const parameters = [
       'nstool',
       '--json',
-      '--fstree',
     ];
 
-    return this.run(options, parameters);
+    // Building and serialising the tree is most of the work on large RomFS images, so only ask for it when wanted.
+    if ((options?.fstree ?? 'full') === 'full') {
+      parameters.push('--fstree');
+    }
+
+    return parameters;
   },
-  extract(options) {
-    // Make sure that the user provided a source file to process.
+  checkOutputDirectory(options) {
+    // Make sure that the user provided an output directory.
     if (typeof options?.outputDirectory === 'undefined') {
       return this.error('Provide a full path to an output directory using the "outputDirectory " option.');
     }
@@ -77,6 +727,129 @@ const nodeNSTool = {
       return this.error(`The output directory is not writable. Given: ${options.outputDirectory}`);
     }
 
+    return undefined;
+  },
+  checkConcurrency(options) {
+    const { concurrency } = options ?? {};
+
+    if (typeof concurrency !== 'undefined' && (!Number.isInteger(concurrency) || concurrency < 1)) {
+      return this.error('The "concurrency" option must be a positive integer.');
+    }
+
+    return undefined;
+  },
+  // Files larger than chunkSize bytes are split across the extraction threads; 0 copies every file on one thread.
+  checkChunkSize(options) {
+    const { chunkSize } = options ?? {};
+
+    if (typeof chunkSize !== 'undefined' && (!Number.isSafeInteger(chunkSize) || chunkSize < 0)) {
+      return this.error('The "chunkSize" option must be a non-negative integer.');
+    }
+
+    return undefined;
+  },
+  checkSelection(options) {
+    for (const name of ['files', 'include']) {
+      const list = options?.[name];
+
+      if (typeof list !== 'undefined' && (!Array.isArray(list) || list.some((item) => typeof item !== 'string'))) {
+        return this.error(`The "${name}" option must be an array of strings.`);
+      }
+    }
+
+    return undefined;
+  },
+  checkProgress(options) {
+    if (typeof options?.onProgress !== 'undefined' && typeof options.onProgress !== 'function') {
+      return this.error('The "onProgress" option must be a function.');
+    }
+
+    return undefined;
+  },
+  checkSignal(options) {
+    const { signal } = options ?? {};
+
+    if (typeof signal !== 'undefined' && !(signal instanceof AbortSignal)) {
+      return this.error('The "signal" option must be an AbortSignal.');
+    }
+
+    if (signal?.aborted) {
+      return this.error('The operation was aborted.');
+    }
+
+    return undefined;
+  },
+  // Connects an AbortSignal to a native cancellation token. Returns the token, if any, and a function that
+  // disconnects them once the call has settled.
+  cancellation(signal) {
+    if (typeof signal === 'undefined') {
+      return { token: undefined, release() {} };
+    }
+
+    const token = new nstool.Cancellation();
+    const cancel = () => token.cancel();
+
+    signal.addEventListener('abort', cancel, { once: true });
+
+    return { token, release: () => signal.removeEventListener('abort', cancel) };
+  },
+  // Rejects as soon as the signal aborts, for work that cannot be cancelled natively.
+  abortable(promise, signal) {
+    if (typeof signal === 'undefined') {
+      return promise;
+    }
+
+    return new Promise((resolve, reject) => {
+      const abort = () => reject(new Error('The operation was aborted.'));
+
+      signal.addEventListener('abort', abort, { once: true });
+      promise.then(resolve, reject).finally(() => signal.removeEventListener('abort', abort));
+    });
+  },
+  // Whether the options need the native extraction engine rather than nstool's --extract. A signal needs it too, as
+  // only the engine can stop in the middle of a file and clean up after itself, and so does trusted, as nstool's own
+  // runs always read the hash layers.
+  usesEngine(options) {
+    return ['concurrency', 'chunkSize', 'files', 'include', 'onProgress', 'signal', 'trusted']
+      .some((name) => typeof options?.[name] !== 'undefined');
+  },
+  // Options for the native extraction engine.
+  engineExtractOptions(options) {
+    const invalid = this.checkOutputDirectory(options)
+      ?? this.checkConcurrency(options)
+      ?? this.checkChunkSize(options)
+      ?? this.checkSelection(options)
+      ?? this.checkProgress(options)
+      ?? this.checkSignal(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    if (typeof options.fileName !== 'undefined' && typeof options.fileName !== 'string') {
+      return this.error('The file name of the file you want to extract must be a string.');
+    }
+
+    return {
+      outputDirectory: options.outputDirectory,
+      path: typeof options.fileName === 'string' && !options.fileName.startsWith('/')
+        ? `/${options.fileName}`
+        : options.fileName,
+      files: options.files,
+      include: options.include,
+      concurrency: options.concurrency,
+      chunkSize: options.chunkSize,
+      onProgress: options.onProgress,
+      signal: options.signal,
+    };
+  },
+  extractParameters(options) {
+    const invalid = this.checkOutputDirectory(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
     const parameters = [
       'nstool',
       '--json',
@@ -95,8 +868,422 @@ const nodeNSTool = {
       parameters.push(options.fileName);
     }
 
+    return parameters;
+  },
+  // The nstool arguments of a package, or the error shape for invalid options.
+  prepareOpen(options) {
+    if (typeof options?.input !== 'undefined' && !['stream', 'mmap'].includes(options.input)) {
+      return this.error(`The input must be either "stream" or "mmap". Given: ${options.input}`);
+    }
+
+    if (typeof options?.access !== 'undefined' && !['normal', 'sequential', 'random'].includes(options.access)) {
+      return this.error(`The access must be "normal", "sequential" or "random". Given: ${options.access}`);
+    }
+
+    if (typeof options?.trusted !== 'undefined' && typeof options.trusted !== 'boolean') {
+      return this.error('The "trusted" option must be a boolean.');
+    }
+
+    return this.prepare(options, this.informationParameters(options));
+  },
+  // The addon options of a package.
+  packageOptions(options) {
+    return {
+      input: options.input,
+      access: options.access,
+      parts: this.sourceParts(options.source),
+      trusted: options.trusted ?? false,
+    };
+  },
+  open(options) {
+    const passing = this.prepareOpen(options);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    try {
+      const handle = new nstool.Package(passing, this.packageOptions(options));
+
+      return new Package(handle, passing, options.fstree, options.trusted ?? false);
+    } catch (error) {
+      // Convert Napi::Error exceptions.
+      return this.error(error.message);
+    }
+  },
+  // open() with the keys loaded and the source opened on the libuv threadpool.
+  async openAsync(options) {
+    const passing = this.prepareOpen(options);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    try {
+      const handle = await nstool.Package.openAsync(passing, this.packageOptions(options));
+
+      return new Package(handle, passing, options.fstree, options.trusted ?? false);
+    } catch (error) {
+      return this.error(error.message);
+    }
+  },
+  openIndex(file) {
+    if (typeof file !== 'string') {
+      return this.error('The path of the index file must be a string.');
+    }
+
+    try {
+      return new MetadataIndex(new nstool.MetadataIndex(file));
+    } catch (error) {
+      // Convert Napi::Error exceptions.
+      return this.error(error.message);
+    }
+  },
+  checkReadStreamOptions(innerPath, options) {
+    if (typeof innerPath !== 'string') {
+      return this.error('The path of the file you want to read must be a string.');
+    }
+
+    for (const name of ['start', 'end', 'highWaterMark']) {
+      if (typeof options?.[name] !== 'undefined' && (!Number.isInteger(options[name]) || options[name] < 0)) {
+        return this.error(`The "${name}" option must be a non-negative integer.`);
+      }
+    }
+
+    return undefined;
+  },
+  createReadStream(source, innerPath, options) {
+    const invalid = this.checkReadStreamOptions(innerPath, options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    const pkg = this.open({
+      source,
+      type: options?.type,
+      input: options?.input,
+      access: options?.access,
+      trusted: options?.trusted,
+    });
+
+    if (pkg.error) {
+      return pkg;
+    }
+
+    // The stream owns this package and closes it when it ends or is destroyed.
+    return new PackageReadStream(pkg, innerPath, options, true);
+  },
+  // The parts of the split dump a path names, in order, or the path on its own.
+  splitParts(source) {
+    if (typeof source !== 'string') {
+      return this.error('The source must be a string.');
+    }
+
+    return nstool.splitParts(source);
+  },
+  reloadKeys() {
+    // Opened packages keep the keys they were opened with.
+    nstool.reloadKeys();
+  },
+  // Which AES and SHA-256 implementations are used on this machine, and the CPU features they were chosen from.
+  cryptoBackend() {
+    return nstool.cryptoBackend();
+  },
+  // Sets the capacity, in megabytes, of the decrypted block cache shared by every package read through open() or
+  // createReadStream(). 0, the default, disables it. Returns the cache statistics.
+  configureBlockCache(options) {
+    const { size } = options ?? {};
+
+    if (typeof size !== 'number' || !Number.isFinite(size) || size < 0) {
+      return this.error('The "size" option must be a non-negative number of megabytes.');
+    }
+
+    nstool.configureBlockCache(size);
+
+    return this.blockCacheStats();
+  },
+  // Drops every cached block and resets the counters; the capacity is kept.
+  clearBlockCache() {
+    nstool.clearBlockCache();
+  },
+  blockCacheStats() {
+    return nstool.blockCacheStats();
+  },
+  information(options) {
+    if (options?.fstree === 'lazy') {
+      const pkg = this.open(options);
+
+      if (pkg.error) {
+        return pkg;
+      }
+
+      return this.withLazyTree(pkg, pkg.info());
+    }
+
+    return this.run(options, this.informationParameters(options));
+  },
+  async informationAsync(options) {
+    if (options?.fstree === 'lazy') {
+      const pkg = await this.openAsync(options);
+
+      if (pkg.error) {
+        return pkg;
+      }
+
+      // Events are only streamed by an nstool run of their own; otherwise the package produces its information.
+      if (typeof options.onEvent !== 'undefined') {
+        return this.withLazyTree(pkg, await this.runAsync(options, this.informationParameters(options)));
+      }
+
+      try {
+        return this.withLazyTree(pkg, await this.abortable(pkg.infoAsync(), options.signal));
+      } catch (error) {
+        return this.withLazyTree(pkg, this.error(error.message));
+      }
+    }
+
+    return this.runAsync(options, this.informationParameters(options));
+  },
+  // Attaches a tree that owns the package, or closes the package when there is nothing to attach it to.
+  withLazyTree(pkg, results) {
+    if (results.error) {
+      pkg.close();
+      return results;
+    }
+
+    return { ...results, tree: new LazyTree(pkg, true) };
+  },
+  // Reads the information of many sources in one call, fanned out over native threads. Resolves with one result per
+  // source, in order, each in the shape information() returns; a failing source only fails its own entry. onResult,
+  // when given, receives each result and the index of its source as soon as that source is done.
+  async informationBatch(sources, options) {
+    if (!Array.isArray(sources)) {
+      return this.error('The sources must be an array of file paths.');
+    }
+
+    const invalid = this.checkConcurrency(options) ?? this.checkSignal(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    if (typeof options?.onResult !== 'undefined' && typeof options.onResult !== 'function') {
+      return this.error('The "onResult" option must be a function.');
+    }
+
+    const invocations = sources.map(
+      (source) => this.checkPartNames(source)
+        ?? this.prepare({ ...options, source }, this.informationParameters(options)),
+    );
+    const results = new Array(sources.length);
+    // The index of each runnable invocation among the sources.
+    const positions = [];
+
+    invocations.forEach((passing, index) => {
+      if (Array.isArray(passing)) {
+        positions.push(index);
+        return;
+      }
+
+      results[index] = passing;
+      options?.onResult?.(passing, index);
+    });
+
+    const { token, release } = this.cancellation(options?.signal);
+
+    try {
+      await nstool.informationBatch(
+        positions.map((index) => invocations[index]),
+        options?.concurrency ?? os.availableParallelism(),
+        (next, result) => {
+          const index = positions[next];
+
+          if (!result.error) {
+            result.parameters = invocations[index];
+          }
+
+          results[index] = result;
+          options?.onResult?.(result, index);
+        },
+        token,
+      );
+    } catch (error) {
+      // Convert rejected Napi::Error values.
+      return this.error(error.message);
+    } finally {
+      release();
+    }
+
+    return results;
+  },
+  // Checks every hashed region of a package on all cores and reports each section. Integrity failures are part of
+  // the report; anything that keeps the check from running comes back as the error shape.
+  async verify(source, options) {
+    const invalid = this.checkConcurrency(options) ?? this.checkSignal(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    const passing = this.prepare({ ...options, source }, ['nstool', '--verify']);
+
+    if (!Array.isArray(passing)) {
+      return passing;
+    }
+
+    const { token, release } = this.cancellation(options?.signal);
+
+    try {
+      return await nstool.verify(
+        passing,
+        options?.concurrency ?? os.availableParallelism(),
+        token,
+        this.sourceParts(source),
+      );
+    } catch (error) {
+      // Convert rejected Napi::Error values.
+      return this.error(error.message);
+    } finally {
+      release();
+    }
+  },
+  checkScanOptions(rootDirectory, options) {
+    if (typeof rootDirectory !== 'string') {
+      return this.error('The root directory to scan must be a string.');
+    }
+
+    const invalid = this.checkConcurrency(options) ?? this.checkSignal(options) ?? this.checkFsTree(options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    const { extensions } = options ?? {};
+
+    if (typeof extensions !== 'undefined'
+      && (!Array.isArray(extensions) || extensions.some((item) => typeof item !== 'string'))) {
+      return this.error('The "extensions" option must be an array of strings.');
+    }
+
+    return undefined;
+  },
+  // Finds and parses every package below a directory. Returns an object-mode stream that yields
+  // { source, type, result } as each package completes, where result has the shape information() returns.
+  scan(rootDirectory, options) {
+    const invalid = this.checkScanOptions(rootDirectory, options);
+
+    if (invalid) {
+      return invalid;
+    }
+
+    const parameters = this.outputParameters(options, this.informationParameters(options));
+    // The scan has a token of its own, so destroying the stream stops it just like aborting the signal.
+    const token = new nstool.Cancellation();
+    const abort = () => token.cancel();
+    let control;
+    // A full stream holds the scanning threads until it is read from again.
+    const stream = new Readable({
+      objectMode: true,
+      read() {
+        control?.resume();
+      },
+      destroy(error, callback) {
+        token.cancel();
+        control?.resume();
+        callback(error);
+      },
+    });
+
+    control = nstool.scan(
+      rootDirectory,
+      (options?.extensions ?? ['nsp', 'xci', 'nca', 'nsz']).map((extension) => extension.replace(/^\./, '')),
+      options?.recursive ?? true,
+      options?.concurrency ?? os.availableParallelism(),
+      parameters,
+      (entry) => {
+        if (!entry.result.error) {
+          entry.result.parameters = [...parameters, '--type', entry.type, entry.source];
+        }
+
+        return stream.push(entry);
+      },
+      token,
+    );
+    // Only listen once the scan has started, so a scan that fails to start leaves nothing attached to the signal.
+    options?.signal?.addEventListener('abort', abort, { once: true });
+    control.done
+      .then(() => stream.push(null), (error) => stream.destroy(error))
+      .finally(() => options?.signal?.removeEventListener('abort', abort));
+
+    return stream;
+  },
+  extract(options) {
+    if (this.usesEngine(options)) {
+      return this.extractConcurrently(options);
+    }
+
+    const parameters = this.extractParameters(options);
+
+    if (!Array.isArray(parameters)) {
+      return parameters;
+    }
+
     return this.run(options, parameters);
   },
+  async extractAsync(options) {
+    if (this.usesEngine(options)) {
+      return this.extractConcurrentlyAsync(options);
+    }
+
+    const parameters = this.extractParameters(options);
+
+    if (!Array.isArray(parameters)) {
+      return parameters;
+    }
+
+    return this.runAsync(options, parameters);
+  },
+  // Extracts through the native engine and returns its report of the written files and throughput. nstool's
+  // information output is not included, so the source is parsed only once.
+  extractConcurrently(options) {
+    const engineOptions = this.engineExtractOptions(options);
+
+    if (engineOptions.error) {
+      return engineOptions;
+    }
+
+    const pkg = this.open(options);
+
+    if (pkg.error) {
+      return pkg;
+    }
+
+    try {
+      return pkg.extract(engineOptions);
+    } finally {
+      pkg.close();
+    }
+  },
+  async extractConcurrentlyAsync(options) {
+    const engineOptions = this.engineExtractOptions(options);
+
+    if (engineOptions.error) {
+      return engineOptions;
+    }
+
+    const pkg = await this.openAsync(options);
+
+    if (pkg.error) {
+      return pkg;
+    }
+
+    try {
+      return await pkg.extractAsync(engineOptions);
+    } finally {
+      pkg.close();
+    }
+  },
 };
 
 module.exports = nodeNSTool;
@@ -4,6 +4,8 @@ import { createRequire } from 'node:module';
 import os from 'node:os';
 import path from 'node:path';
 import test from 'node:test';
+import v8 from 'node:v8';
+import vm from 'node:vm';
 import addon from './index.js';
 
 const require = createRequire(import.meta.url);
@@ -30,6 +32,15 @@ for (const fixturePath of Object.values(fixturePaths)) {
   }
 }
 
+// The keys nstool loads by default. Tests that decrypt fixtures themselves need them and are skipped without them.
+const prodKeysPath = path.join(os.homedir(), '.switch', 'prod.keys');
+const missingKeys = !fs.existsSync(prodKeysPath) && `no keys at ${prodKeysPath}`;
+
+// A new, empty directory for the files a test writes.
+function temporaryDirectory() {
+  return fs.mkdtempSync(path.join(os.tmpdir(), 'node-nstool-'));
+}
+
 test('prebuild files are present in the repository', () => {
   for (const prebuildFilePath of prebuildFilePaths) {
     assert.ok(fs.existsSync(prebuildFilePath), `Missing prebuild file: ${prebuildFilePath}`);
@@ -46,6 +57,8 @@ test('current platform prebuild loads as a native addon', () => {
   assert.equal(typeof prebuildAddon.run, 'function');
 });
 
+// information() and the other calls that run nstool.
+
 test('information returns data, events and parameters for test.nsp', () => {
   const source = fixturePaths['test.nsp'];
   const result = addon.information({ source });
@@ -71,8 +84,623 @@ test('information returns data, events and parameters for test.xci', () => {
   assert.equal(typeof result.data.gameCardHeader, 'object');
 });
 
+test('informationAsync resolves with the same shape as information', async () => {
+  const source = fixturePaths['test.nsp'];
+  const result = await addon.informationAsync({ source });
+
+  assert.equal(result.error, undefined);
+  assert.deepEqual(result, addon.information({ source }));
+});
+
+test('concurrent asynchronous calls keep their output separate', async () => {
+  const sources = [
+    fixturePaths['test.nsp'], fixturePaths['test.xci'], fixturePaths['test.nsp'], fixturePaths['test.xci'],
+  ];
+  const results = await Promise.all(sources.map((source) => addon.informationAsync({ source })));
+
+  results.forEach((result, index) => {
+    assert.equal(result.error, undefined);
+    assert.deepEqual(result, addon.information({ source: sources[index] }));
+  });
+});
+
+test('async wrappers resolve with an error shape instead of rejecting', async () => {
+  assert.deepEqual(await addon.informationAsync({}), {
+    error: true,
+    errorMessage: 'Provide a source file using the "source" option.',
+  });
+  assert.deepEqual(await addon.extractAsync({ source: fixturePaths['test.nsp'] }), {
+    error: true,
+    errorMessage: 'Provide a full path to an output directory using the "outputDirectory " option.',
+  });
+});
+
+test('onEvent streams the events instead of collecting them in the result', async () => {
+  const source = fixturePaths['test.nsp'];
+  const expected = addon.information({ source });
+  const events = [];
+  const result = await addon.informationAsync({
+    source,
+    onEvent: (event) => events.push(event),
+    eventQueue: { size: 4, policy: 'block' },
+  });
+
+  assert.deepEqual(result.data, expected.data);
+  assert.deepEqual(result.events, []);
+  assert.deepEqual(events, expected.events);
+  assert.deepEqual(result.eventCounts, { delivered: events.length, dropped: 0, coalesced: 0 });
+});
+
+test('aborting a streaming call stops the events and settles once the run has stopped', async () => {
+  const controller = new AbortController();
+  let afterAbort = 0;
+  const pending = addon.informationAsync({
+    source: fixturePaths['test.nsp'],
+    signal: controller.signal,
+    onEvent: () => {
+      if (controller.signal.aborted) {
+        afterAbort += 1;
+      }
+    },
+  });
+
+  controller.abort();
+
+  assert.deepEqual(await pending, { error: true, errorMessage: 'The operation was aborted.' });
+  await new Promise((resolve) => setImmediate(resolve));
+  assert.equal(afterAbort, 0);
+});
+
+test('onEvent is rejected by the synchronous methods and validated', async () => {
+  const source = fixturePaths['test.nsp'];
+
+  assert.deepEqual(addon.information({ source, onEvent: () => {} }), {
+    error: true,
+    errorMessage: 'Events are only streamed by the asynchronous methods.',
+  });
+  assert.deepEqual(await addon.informationAsync({ source, onEvent: () => {}, eventQueue: { policy: 'lifo' } }), {
+    error: true,
+    errorMessage: 'The event queue policy must be "block", "drop" or "coalesce". Given: lifo',
+  });
+});
+
+test('native parser produces the same result as JSON.parse', async () => {
+  for (const source of Object.values(fixturePaths)) {
+    const expected = addon.information({ source });
+
+    assert.deepEqual(addon.information({ source, parser: 'native' }), expected);
+    assert.deepEqual(await addon.informationAsync({ source, parser: 'native' }), expected);
+  }
+});
+
+test('wrapper returns an error shape for an unknown parser', () => {
+  assert.deepEqual(addon.information({ source: fixturePaths['test.nsp'], parser: 'yaml' }), {
+    error: true,
+    errorMessage: 'The parser must be either "json" or "native". Given: yaml',
+  });
+});
+
+test('calls given an aborted signal return an error shape without running', async () => {
+  const signal = AbortSignal.abort();
+  const aborted = { error: true, errorMessage: 'The operation was aborted.' };
+
+  assert.deepEqual(await addon.informationAsync({ source: fixturePaths['test.nsp'], signal }), aborted);
+  assert.deepEqual(await addon.informationBatch([fixturePaths['test.nsp']], { signal }), aborted);
+  assert.deepEqual(addon.scan(path.resolve('.'), { signal }), aborted);
+});
+
+test('aborting informationAsync stops the nstool run at its next read', async () => {
+  const source = fixturePaths['test.nsp'];
+  const native = require('node-gyp-build')(path.resolve('.'));
+  const token = new native.Cancellation();
+
+  token.cancel();
+
+  // The worker itself rejects, from the read that noticed the token, rather than running to completion.
+  await assert.rejects(native.runAsync('nstool', '--json', source, token), { message: 'The operation was aborted.' });
+
+  const controller = new AbortController();
+  const pending = addon.informationAsync({ source, signal: controller.signal });
+
+  controller.abort();
+
+  assert.deepEqual(await pending, { error: true, errorMessage: 'The operation was aborted.' });
+  assert.equal((await addon.informationAsync({ source })).error, undefined);
+});
+
+test('split dumps are read from their parts as one source', async () => {
+  const source = fixturePaths['test.xci'];
+  const contents = fs.readFileSync(source);
+  const directory = temporaryDirectory();
+  // Uneven cuts, so reads cross part boundaries inside headers and file data.
+  const cuts = [0, 0x1234, Math.floor(contents.length / 2) + 1, contents.length];
+  const parts = cuts.slice(1).map((end, index) => {
+    const part = path.join(directory, `test.xc${index}`);
+
+    fs.writeFileSync(part, contents.subarray(cuts[index], end));
+
+    return part;
+  });
+
+  assert.deepEqual(addon.splitParts(parts[1]), parts);
+  assert.deepEqual(addon.splitParts(source), [source]);
+
+  const whole = addon.open({ source });
+  const outputDirectory = temporaryDirectory();
+  const [file] = whole.extract({ outputDirectory }).files;
+  const innerPath = `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`;
+  const expected = fs.readFileSync(file);
+
+  const information = whole.info();
+
+  for (const options of [{ source: parts[0] }, { source: parts }, { source: parts, input: 'mmap' }]) {
+    const split = addon.open(options);
+
+    assert.deepEqual(split.exportTree().names, whole.exportTree().names);
+    assert.deepEqual(split.read(innerPath), expected);
+    assert.deepEqual(split.info().data, information.data);
+    split.close();
+  }
+
+  whole.close();
+  assert.equal((await addon.verify(parts)).ok, true);
+  assert.deepEqual(addon.information({ source: parts[1] }).data, information.data);
+  assert.deepEqual((await addon.informationBatch([parts[0]]))[0].data, information.data);
+  assert.deepEqual(addon.information({ source: [parts[1], parts[0], parts[2]] }), {
+    error: true,
+    errorMessage: 'nstool finds split parts by name. Read parts named otherwise with open() or verify().',
+  });
+});
+
+test('wrapper returns an error shape when source is missing', () => {
+  assert.deepEqual(addon.information({}), {
+    error: true,
+    errorMessage: 'Provide a source file using the "source" option.',
+  });
+});
+
+// informationBatch() and scan().
+
+test('informationBatch returns one result per source with per-source errors', async () => {
+  const missing = path.resolve('missing.nsp');
+  const delivered = [];
+  const results = await addon.informationBatch(
+    [fixturePaths['test.nsp'], missing, fixturePaths['test.xci']],
+    { concurrency: 2, onResult: (result, index) => delivered.push([index, result]) }
+  );
+
+  assert.equal(results.length, 3);
+  assert.deepEqual(delivered.map(([index]) => index).sort(), [0, 1, 2]);
+  for (const [index, result] of delivered) {
+    assert.equal(result, results[index]);
+  }
+  assert.deepEqual(results[0], addon.information({ source: fixturePaths['test.nsp'] }));
+  assert.deepEqual(results[1], {
+    error: true,
+    errorMessage: `The source file is not readable. Given: ${missing}`,
+  });
+  assert.deepEqual(results[2], addon.information({ source: fixturePaths['test.xci'] }));
+});
+
+test('scan finds and parses the packages in a directory by their magic bytes', async () => {
+  const entries = [];
+
+  for await (const entry of addon.scan(path.resolve('.'), { recursive: false, concurrency: 2 })) {
+    entries.push(entry);
+  }
+
+  entries.sort((a, b) => a.source.localeCompare(b.source));
+
+  assert.deepEqual(entries.map(({ source, type }) => [source, type]), [
+    [fixturePaths['test.nsp'], 'pfs'],
+    [fixturePaths['test.xci'], 'gc'],
+  ]);
+  assert.deepEqual(entries[0].result.data, addon.information({ source: fixturePaths['test.nsp'] }).data);
+});
+
+test('scan returns an error shape for invalid extensions', () => {
+  assert.deepEqual(addon.scan(path.resolve('.'), { extensions: 'nsp' }), {
+    error: true,
+    errorMessage: 'The "extensions" option must be an array of strings.',
+  });
+});
+
+// Metadata indexes.
+
+test('a metadata index answers unchanged sources and survives reopening and compaction', () => {
+  const file = path.join(temporaryDirectory(), 'metadata.index');
+  const expected = addon.information({ source: fixturePaths['test.nsp'] });
+  const index = addon.openIndex(file);
+
+  assert.deepEqual(index.information({ source: fixturePaths['test.nsp'] }), expected);
+  assert.deepEqual(index.information({ source: fixturePaths['test.nsp'] }), expected);
+  assert.deepEqual(index.stats(), { entries: 1, bytes: fs.statSync(file).size, hits: 1, misses: 1 });
+  assert.deepEqual(index.verify(), { checked: 1, unchanged: 1, stale: 0, mismatched: 0 });
+  index.close();
+
+  const reopened = addon.openIndex(file);
+
+  assert.deepEqual(reopened.information({ source: fixturePaths['test.nsp'] }), expected);
+  assert.equal(reopened.stats().hits, 1);
+  assert.equal(reopened.compact().entries, 1);
+  assert.deepEqual(reopened.information({ source: fixturePaths['test.nsp'] }), expected);
+  reopened.close();
+});
+
+test('a metadata index keeps stale entries dropped and skips damaged records', () => {
+  const directory = temporaryDirectory();
+  const file = path.join(directory, 'metadata.index');
+  const source = path.join(directory, 'copy.nsp');
+
+  fs.copyFileSync(fixturePaths['test.nsp'], source);
+
+  const index = addon.openIndex(file);
+
+  index.information({ source });
+  fs.appendFileSync(source, Buffer.alloc(1));
+  assert.deepEqual(index.verify(), { checked: 1, unchanged: 0, stale: 1, mismatched: 0 });
+  index.close();
+
+  // A record whose key size runs past the end of the file, as left by a torn write.
+  const damaged = Buffer.alloc(4);
+  damaged.writeUInt32LE(0xffffff00);
+  fs.appendFileSync(file, damaged);
+
+  const reopened = addon.openIndex(file);
+
+  assert.equal(reopened.stats().entries, 0);
+  assert.equal(reopened.stats().bytes, fs.statSync(file).size);
+  reopened.close();
+});
+
+test('a metadata index written without device numbers is started again', () => {
+  const file = path.join(temporaryDirectory(), 'metadata.index');
+  const header = Buffer.from('NSTI\x01\x00\x00\x00', 'latin1');
+
+  fs.writeFileSync(file, Buffer.concat([header, Buffer.alloc(64, 1)]));
+
+  const index = addon.openIndex(file);
+
+  assert.deepEqual(index.stats(), { entries: 0, bytes: 8, hits: 0, misses: 0 });
+  index.close();
+  assert.equal(fs.readFileSync(file).readUInt32LE(4), 2);
+});
+
+test('openIndex returns an error shape for a file that is not an index', () => {
+  const file = path.join(temporaryDirectory(), 'not.index');
+
+  fs.writeFileSync(file, 'not an index');
+
+  assert.deepEqual(addon.openIndex(file), {
+    error: true,
+    errorMessage: `The file is not a metadata index: ${file}`,
+  });
+});
+
+// Opened packages, their trees and reads.
+
+test('open keeps a package parsed across info, tree and extract', () => {
+  const source = fixturePaths['test.nsp'];
+  const pkg = addon.open({ source });
+
+  assert.equal(pkg.error, undefined);
+  assert.deepEqual(pkg.info(), addon.information({ source }));
+  assert.deepEqual(pkg.tree(), pkg.info().data.tree);
+
+  const outputDirectory = temporaryDirectory();
+  const result = pkg.extract({ outputDirectory });
+
+  assert.equal(result.error, undefined);
+  assert.ok(result.files.length > 0, 'extract should report the files it wrote');
+  for (const file of result.files) {
+    assert.ok(fs.existsSync(file), `Extracted file is missing: ${file}`);
+  }
+
+  pkg.close();
+
+  assert.deepEqual(pkg.info(), {
+    error: true,
+    errorMessage: 'The package has been closed.',
+  });
+});
+
+test('fstree controls whether the tree is built, skipped or listed lazily', () => {
+  const source = fixturePaths['test.xci'];
+  const full = addon.information({ source, fstree: 'full' });
+  const skipped = addon.information({ source, fstree: false });
+  const lazy = addon.information({ source, fstree: 'lazy' });
+
+  assert.ok(!skipped.parameters.includes('--fstree'));
+  assert.equal(skipped.data.tree, undefined);
+  assert.equal(lazy.data.tree, undefined);
+
+  const root = lazy.tree.children('/');
+
+  assert.ok(Array.isArray(root) && root.length > 0);
+
+  for (const child of root) {
+    assert.ok(['directory', 'file', 'container'].includes(child.type));
+    assert.equal(typeof child.name, 'string');
+  }
+
+  const file = root.find((child) => child.type !== 'directory')
+    ?? root.flatMap((child) => lazy.tree.children(`/${child.name}`)).find((child) => child.type !== 'directory');
+
+  assert.equal(typeof file.size, 'number');
+  assert.equal(typeof full.data.tree, 'object');
+  lazy.tree.close();
+});
+
+test('a lazy tree releases its package on close() and when it is garbage collected', async () => {
+  const source = fixturePaths['test.xci'];
+  const closed = addon.information({ source, fstree: 'lazy' });
+  const closedPackage = closed.tree.pkg;
+
+  closed.tree.close();
+  assert.match(closedPackage.info().errorMessage, /closed/);
+
+  let collected = addon.information({ source, fstree: 'lazy' });
+  const collectedPackage = collected.tree.pkg;
+
+  assert.equal(collectedPackage.info().error, undefined);
+  collected = undefined;
+
+  v8.setFlagsFromString('--expose-gc');
+  const gc = vm.runInNewContext('gc');
+
+  for (let attempt = 0; attempt < 20 && !collectedPackage.info().error; attempt += 1) {
+    gc();
+    await new Promise((resolve) => setImmediate(resolve));
+  }
+
+  assert.match(collectedPackage.info().errorMessage, /closed/);
+});
+
+test('openAsync and informationAsync with a lazy tree read the package on the threadpool', async () => {
+  const source = fixturePaths['test.xci'];
+  const pkg = await addon.openAsync({ source, fstree: 'lazy' });
+
+  assert.equal(pkg.error, undefined);
+  assert.deepEqual(await pkg.infoAsync(), pkg.info());
+  pkg.close();
+
+  const lazy = await addon.informationAsync({ source, fstree: 'lazy' });
+  const expected = addon.information({ source, fstree: 'lazy' });
+
+  assert.deepEqual(lazy.data, expected.data);
+  assert.deepEqual(lazy.tree.children('/'), expected.tree.children('/'));
+  lazy.tree.close();
+  expected.tree.close();
+  assert.equal((await addon.openAsync({ source: `${source}.missing` })).error, true);
+});
+
+test('exportTree flattens the package tree into typed arrays with path lookups', async () => {
+  const pkg = addon.open({ source: fixturePaths['test.xci'] });
+  const tree = pkg.exportTree();
+
+  assert.ok(tree instanceof addon.CompactTree);
+  assert.ok(tree.parent instanceof Int32Array);
+  assert.ok(tree.nameOffset instanceof Uint32Array);
+  assert.ok(tree.size instanceof Float64Array);
+  assert.ok(tree.dataOffset instanceof Float64Array);
+  assert.ok(tree.flags instanceof Uint8Array);
+  assert.ok(Buffer.isBuffer(tree.names));
+  assert.equal(tree.parent[0], -1);
+  assert.ok(tree.isDirectory(0));
+
+  const file = tree.children(0)
+    .flatMap((entry) => (tree.isDirectory(entry) ? tree.children(entry) : [entry]))
+    .find((entry) => !tree.isDirectory(entry));
+  const innerPath = tree.path(file);
+
+  assert.equal(tree.lookup(innerPath), file);
+  assert.equal(tree.size[file], pkg.read(innerPath).length);
+  assert.equal(tree.lookup('/missing/entry'), -1);
+  assert.equal(tree.dataOffset[0], -1);
+
+  // Game card partitions store their files as they are, so the data offset points at the file's own bytes.
+  const length = Math.min(tree.size[file], 64);
+  const stored = Buffer.alloc(length);
+  const descriptor = fs.openSync(fixturePaths['test.xci'], 'r');
+
+  fs.readSync(descriptor, stored, 0, length, tree.dataOffsetOf(innerPath));
+  fs.closeSync(descriptor);
+  assert.deepEqual(stored, pkg.read(innerPath, 0, length));
+  assert.equal(tree.dataOffsetOf('/missing/entry'), -1);
+
+  const copy = new addon.CompactTree(structuredClone(await pkg.exportTreeAsync()));
+
+  assert.equal(copy.lookup(innerPath), file);
+  assert.equal(copy.dataOffsetOf(innerPath), tree.dataOffset[file]);
+  pkg.close();
+});
+
+test('extraction writes the files of a package in the order their data is stored', () => {
+  const pkg = addon.open({ source: fixturePaths['test.nsp'] });
+  const tree = pkg.exportTree({ nested: true });
+  const outputDirectory = temporaryDirectory();
+  const { files } = pkg.extract({ outputDirectory, include: ['/*.nca/*/**'] });
+  const offsets = files
+    .map((file) => tree.dataOffsetOf(`/${path.relative(outputDirectory, file).split(path.sep).join('/')}`))
+    .filter((offset) => offset >= 0);
+
+  assert.ok(offsets.length > 1);
+  assert.deepEqual(offsets, [...offsets].sort((a, b) => a - b));
+  pkg.close();
+});
+
+test('fstree returns an error shape for an unknown mode', () => {
+  assert.deepEqual(addon.information({ source: fixturePaths['test.nsp'], fstree: 'eager' }), {
+    error: true,
+    errorMessage: 'The fstree option must be false, "lazy" or "full". Given: eager',
+  });
+});
+
+test('packages open again after the key cache is reloaded', () => {
+  const source = fixturePaths['test.xci'];
+  const before = addon.open({ source });
+
+  addon.reloadKeys();
+
+  const after = addon.open({ source });
+
+  assert.equal(after.error, undefined);
+  assert.deepEqual(after.tree(), before.tree());
+
+  before.close();
+  after.close();
+});
+
+test('read returns the same bytes as extract', () => {
+  const pkg = addon.open({ source: fixturePaths['test.nsp'] });
+  const outputDirectory = temporaryDirectory();
+  const [file] = pkg.extract({ outputDirectory }).files;
+  const innerPath = `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`;
+  const expected = fs.readFileSync(file);
+
+  assert.deepEqual(pkg.read(innerPath), expected);
+  assert.deepEqual(pkg.read(innerPath, 1, 16), expected.subarray(1, 17));
+  assert.equal(pkg.read(innerPath, expected.length + 1, 16).length, 0);
+
+  const target = Buffer.alloc(8);
+
+  assert.equal(pkg.read(innerPath, 0, 64, target), Math.min(8, expected.length));
+  assert.deepEqual(target.subarray(0, Math.min(8, expected.length)), expected.subarray(0, 8));
+
+  pkg.close();
+});
+
+test('createReadStream streams the same bytes as read', async () => {
+  const source = fixturePaths['test.nsp'];
+  const pkg = addon.open({ source });
+  const outputDirectory = temporaryDirectory();
+  const [file] = pkg.extract({ outputDirectory }).files;
+  const innerPath = `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`;
+  const expected = fs.readFileSync(file);
+
+  const chunks = [];
+  for await (const chunk of addon.createReadStream(source, innerPath, { highWaterMark: 4096 })) {
+    chunks.push(chunk);
+  }
+  assert.deepEqual(Buffer.concat(chunks), expected);
+
+  const ranged = [];
+  for await (const chunk of pkg.createReadStream(innerPath, { start: 2, end: 33 })) {
+    ranged.push(chunk);
+  }
+  assert.deepEqual(Buffer.concat(ranged), expected.subarray(2, 34));
+
+  const closing = pkg.createReadStream(innerPath, { highWaterMark: 16 });
+  pkg.close();
+  await assert.rejects(async () => {
+    for await (const chunk of closing) {
+      assert.ok(chunk.length > 0);
+    }
+  }, /The package has been closed/);
+});
+
+test('memory-mapped input reads the same bytes as the file stream', () => {
+  const source = fixturePaths['test.xci'];
+  const streamed = addon.open({ source });
+  const mapped = addon.open({ source, input: 'mmap', access: 'sequential' });
+  const outputDirectory = temporaryDirectory();
+  const { files } = mapped.extract({ outputDirectory });
+
+  assert.ok(files.length > 0);
+  for (const file of files) {
+    const innerPath = `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`;
+
+    assert.deepEqual(mapped.read(innerPath), streamed.read(innerPath));
+  }
+
+  streamed.close();
+  mapped.close();
+});
+
+test('trusted packages read the same bytes and say so in their results', () => {
+  const source = fixturePaths['test.nsp'];
+  const checked = addon.open({ source });
+  const trusted = addon.open({ source, trusted: true });
+  const outputDirectory = temporaryDirectory();
+  const extracted = trusted.extract({ outputDirectory });
+
+  assert.equal(checked.info().trusted, false);
+  assert.equal(trusted.info().trusted, true);
+  assert.equal(extracted.trusted, true);
+  assert.equal(checked.extract({ outputDirectory: temporaryDirectory() }).trusted, false);
+  for (const file of extracted.files) {
+    const innerPath = `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`;
+
+    assert.deepEqual(trusted.read(innerPath), checked.read(innerPath));
+  }
+
+  checked.close();
+  trusted.close();
+  assert.equal(addon.extract({ source, outputDirectory: temporaryDirectory(), trusted: true }).trusted, true);
+  assert.deepEqual(addon.open({ source, trusted: 'yes' }), {
+    error: true,
+    errorMessage: 'The "trusted" option must be a boolean.',
+  });
+});
+
+test('open returns an error shape for an unknown input backend', () => {
+  assert.deepEqual(addon.open({ source: fixturePaths['test.nsp'], input: 'tape' }), {
+    error: true,
+    errorMessage: 'The input must be either "stream" or "mmap". Given: tape',
+  });
+});
+
+test('open returns an error shape when source is missing', () => {
+  assert.deepEqual(addon.open({}), {
+    error: true,
+    errorMessage: 'Provide a source file using the "source" option.',
+  });
+});
+
+test('the block cache serves repeated reads across packages of the same source', () => {
+  const source = fixturePaths['test.nsp'];
+  const uncached = addon.open({ source });
+  const tree = uncached.exportTree({ nested: true });
+  // A file inside a section of a content archive, as the cache holds decrypted sections.
+  const file = Array.from(tree.parent.keys())
+    .find((entry) => !tree.isDirectory(entry) && !tree.isContainer(entry) && tree.path(entry).includes('.nca/'));
+  const innerPath = tree.path(file);
+  const expected = uncached.read(innerPath);
+
+  uncached.close();
+  assert.equal(addon.configureBlockCache({ size: 16 }).capacity, 16 * 1024 * 1024);
+  addon.clearBlockCache();
+
+  const first = addon.open({ source });
+  assert.deepEqual(first.read(innerPath), expected);
+  first.close();
+
+  const cold = addon.blockCacheStats();
+  assert.equal(cold.hits, 0);
+  assert.ok(cold.misses > 0);
+  assert.equal(cold.blocks, cold.misses);
+
+  const second = addon.open({ source });
+  assert.deepEqual(second.read(innerPath), expected);
+  assert.deepEqual(second.read(innerPath, 1, 16), expected.subarray(1, 17));
+  second.close();
+
+  const warm = addon.blockCacheStats();
+  assert.equal(warm.misses, cold.misses);
+  assert.ok(warm.hits >= cold.misses + 1);
+
+  addon.configureBlockCache({ size: 0 });
+  assert.equal(addon.blockCacheStats().bytes, 0);
+  assert.deepEqual(addon.configureBlockCache({ size: -1 }), {
+    error: true,
+    errorMessage: 'The "size" option must be a non-negative number of megabytes.',
+  });
+});
+
+// extract() and the native extraction engine.
+
 test('extract writes files to the output directory', () => {
-  const outputDirectory = fs.mkdtempSync(path.join(os.tmpdir(), 'node-nstool-'));
+  const outputDirectory = temporaryDirectory();
   const source = fixturePaths['test.nsp'];
 
   const result = addon.extract({ source, outputDirectory });
@@ -85,10 +713,210 @@ test('extract writes files to the output directory', () => {
   assert.ok(fs.readdirSync(outputDirectory).length > 0, 'output directory should contain extracted files');
 });
 
-test('wrapper returns an error shape when source is missing', () => {
-  assert.deepEqual(addon.information({}), {
+test('extractAsync writes files to the output directory', async () => {
+  const outputDirectory = temporaryDirectory();
+  const source = fixturePaths['test.nsp'];
+
+  const result = await addon.extractAsync({ source, outputDirectory });
+
+  assert.equal(result.error, undefined);
+  assert.deepEqual(result.parameters, [
+    'nstool', '--json', '--fstree', '--extract', outputDirectory, source,
+  ]);
+  assert.ok(fs.readdirSync(outputDirectory).length > 0, 'output directory should contain extracted files');
+});
+
+test('extract with a concurrency uses the parallel engine and reports throughput', async () => {
+  const source = fixturePaths['test.xci'];
+  const sequentialDirectory = temporaryDirectory();
+  const sequential = addon.open({ source }).extract({ outputDirectory: sequentialDirectory });
+
+  for (const run of [addon.extract.bind(addon), addon.extractAsync.bind(addon)]) {
+    const outputDirectory = temporaryDirectory();
+    const result = await run({ source, outputDirectory, concurrency: 4 });
+
+    assert.equal(result.error, undefined);
+    assert.equal(result.data, undefined);
+    assert.equal(result.throughput.fileCount, sequential.files.length);
+    assert.equal(result.throughput.bytes, sequential.throughput.bytes);
+    assert.ok(result.throughput.concurrency >= 1 && result.throughput.concurrency <= 4);
+
+    for (const file of result.files) {
+      const relative = path.relative(outputDirectory, file);
+
+      assert.deepEqual(fs.readFileSync(file), fs.readFileSync(path.join(sequentialDirectory, relative)));
+    }
+  }
+});
+
+test('extract splits large files into chunks decrypted on several threads', async () => {
+  const source = fixturePaths['test.xci'];
+  const wholeDirectory = temporaryDirectory();
+  const whole = addon.open({ source }).extract({ outputDirectory: wholeDirectory });
+  const outputDirectory = temporaryDirectory();
+  // Small enough to split every file of the fixture into several chunks, and not a multiple of the AES block size.
+  const result = await addon.extractAsync({ source, outputDirectory, concurrency: 4, chunkSize: 4099 });
+
+  assert.equal(result.error, undefined);
+  assert.equal(result.throughput.chunkSize, 4099);
+  assert.equal(result.throughput.bytes, whole.throughput.bytes);
+
+  for (const file of result.files) {
+    const relative = path.relative(outputDirectory, file);
+
+    assert.deepEqual(fs.readFileSync(file), fs.readFileSync(path.join(wholeDirectory, relative)));
+  }
+});
+
+test('extractAsync reports progress before it resolves', async () => {
+  const outputDirectory = temporaryDirectory();
+  const updates = [];
+  const result = await addon.extractAsync({
+    source: fixturePaths['test.xci'],
+    outputDirectory,
+    concurrency: 2,
+    onProgress: (progress) => updates.push(progress),
+  });
+  const last = updates.at(-1);
+
+  assert.equal(result.error, undefined);
+  assert.ok(updates.length > 0);
+  assert.equal(last.bytesDone, result.throughput.bytes);
+  assert.equal(last.bytesTotal, result.throughput.bytes);
+  assert.equal(last.filesDone, result.throughput.fileCount);
+  assert.equal(last.fileCount, result.throughput.fileCount);
+  assert.equal(typeof last.currentFile, 'string');
+});
+
+test('synchronous extract returns an error shape when asked for progress', () => {
+  const outputDirectory = temporaryDirectory();
+
+  assert.deepEqual(addon.extract({ source: fixturePaths['test.nsp'], outputDirectory, onProgress: () => {} }), {
     error: true,
-    errorMessage: 'Provide a source file using the "source" option.',
+    errorMessage: 'Progress is only reported by extractAsync().',
+  });
+});
+
+test('aborting extractAsync stops the engine and removes partial output', async () => {
+  const outputDirectory = temporaryDirectory();
+  const controller = new AbortController();
+  const pending = addon.extractAsync({ source: fixturePaths['test.xci'], outputDirectory, signal: controller.signal });
+
+  controller.abort();
+
+  assert.deepEqual(await pending, { error: true, errorMessage: 'The operation was aborted.' });
+  assert.deepEqual(fs.readdirSync(outputDirectory), []);
+});
+
+test('extract selects files by path list and by glob in one pass', () => {
+  const source = fixturePaths['test.nsp'];
+  const pkg = addon.open({ source });
+  const allDirectory = temporaryDirectory();
+  const all = pkg.extract({ outputDirectory: allDirectory }).files
+    .map((file) => `/${path.relative(allDirectory, file).split(path.sep).join('/')}`);
+
+  const listed = temporaryDirectory();
+  const byList = pkg.extract({ outputDirectory: listed, files: [all[0]] });
+
+  assert.equal(byList.error, undefined);
+  assert.deepEqual(byList.files, [path.join(listed, ...all[0].split('/').filter(Boolean))]);
+
+  const globbed = temporaryDirectory();
+  const byGlob = addon.extract({ source, outputDirectory: globbed, include: ['/**/*.nca'] });
+
+  assert.equal(byGlob.error, undefined);
+  assert.equal(byGlob.files.length, all.filter((file) => file.endsWith('.nca')).length);
+
+  const missing = pkg.extract({ outputDirectory: listed, files: ['/does-not-exist.nca'] });
+
+  assert.equal(missing.error, true);
+  pkg.close();
+});
+
+test('extract selects the RomFS of the program content archive with a romfs:/ pattern', () => {
+  const source = fixturePaths['test.nsp'];
+  const innerPaths = (outputDirectory, files) => files
+    .map((file) => `/${path.relative(outputDirectory, file).split(path.sep).join('/')}`)
+    .sort();
+
+  const romFsDirectory = temporaryDirectory();
+  const romFs = innerPaths(romFsDirectory, addon.extract({
+    source,
+    outputDirectory: romFsDirectory,
+    include: ['romfs:/'],
+  }).files);
+
+  assert.ok(romFs.length > 0);
+
+  // Every file lies in a numbered section of a content archive, and the whole of those sections is selected.
+  const sections = [...new Set(romFs.map((innerPath) => /^\/[^/]+\.nca\/\d+\//.exec(innerPath)[0]))];
+  const sectionDirectory = temporaryDirectory();
+  const bySection = addon.extract({
+    source,
+    outputDirectory: sectionDirectory,
+    include: sections.map((section) => `${section}**`),
+  });
+
+  assert.deepEqual(innerPaths(sectionDirectory, bySection.files), romFs);
+
+  const fileDirectory = temporaryDirectory();
+  const byFile = addon.extract({
+    source,
+    outputDirectory: fileDirectory,
+    include: [`romfs:/${romFs[0].slice(sections[0].length)}`],
+  });
+
+  assert.deepEqual(innerPaths(fileDirectory, byFile.files), [romFs[0]]);
+});
+
+test('extract refuses entries whose names would leave the output directory', () => {
+  // A partition filesystem holding one file named ../escaped.bin.
+  const name = Buffer.from('../escaped.bin\0');
+  const contents = Buffer.from('escaped');
+  const header = Buffer.alloc(0x10 + 0x18);
+
+  header.write('PFS0', 0, 'ascii');
+  header.writeUInt32LE(1, 4);
+  header.writeUInt32LE(name.length, 8);
+  header.writeBigUInt64LE(0n, 0x10);
+  header.writeBigUInt64LE(BigInt(contents.length), 0x18);
+  header.writeUInt32LE(0, 0x20);
+
+  const directory = temporaryDirectory();
+  const source = path.join(directory, 'unsafe.nsp');
+  const outputDirectory = path.join(directory, 'output');
+
+  fs.writeFileSync(source, Buffer.concat([header, name, contents]));
+  fs.mkdirSync(outputDirectory);
+
+  const pkg = addon.open({ source });
+
+  assert.equal(pkg.error, undefined);
+
+  const result = pkg.extract({ outputDirectory });
+
+  assert.equal(result.error, true);
+  assert.match(result.errorMessage, /cannot be extracted safely/);
+  assert.equal(fs.existsSync(path.join(directory, 'escaped.bin')), false);
+  assert.deepEqual(fs.readdirSync(outputDirectory), []);
+  pkg.close();
+});
+
+test('extract returns an error shape for an invalid concurrency', () => {
+  const outputDirectory = temporaryDirectory();
+
+  assert.deepEqual(addon.extract({ source: fixturePaths['test.nsp'], outputDirectory, concurrency: 0 }), {
+    error: true,
+    errorMessage: 'The "concurrency" option must be a positive integer.',
+  });
+});
+
+test('extract returns an error shape for an invalid chunk size', () => {
+  const outputDirectory = temporaryDirectory();
+
+  assert.deepEqual(addon.extract({ source: fixturePaths['test.nsp'], outputDirectory, chunkSize: -1 }), {
+    error: true,
+    errorMessage: 'The "chunkSize" option must be a non-negative integer.',
   });
 });
 
@@ -98,3 +926,174 @@ test('wrapper returns an error shape when outputDirectory is missing', () => {
     errorMessage: 'Provide a full path to an output directory using the "outputDirectory " option.',
   });
 });
+
+// Crypto backends.
+
+test('cryptoBackend reports the AES implementation and CPU features', () => {
+  const backend = addon.cryptoBackend();
+
+  assert.ok(['aes-ni', 'armv8', 'software'].includes(backend.aes));
+  assert.equal(typeof backend.cpu.aes, 'boolean');
+  assert.equal(typeof backend.cpu.carrylessMultiply, 'boolean');
+
+  if (!backend.cpu.aes) {
+    assert.equal(backend.aes, 'software');
+  }
+
+  assert.ok(['sha-ni', 'armv8', 'software'].includes(backend.sha256));
+  assert.equal(backend.sha256 !== 'software', backend.cpu.sha2);
+});
+
+test('every SHA-256 backend hashes like node:crypto', async () => {
+  const { createHash } = await import('node:crypto');
+  const native = require('node-gyp-build')(path.resolve('.'));
+  const backends = [...new Set(['software', addon.cryptoBackend().sha256])];
+
+  // Lengths around the 64 byte block and the 56 byte padding boundary.
+  for (const bytes of [0, 55, 56, 64, 119, 0x4000 + 3]) {
+    const expected = createHash('sha256').update(Buffer.alloc(bytes)).digest('hex');
+
+    for (const backend of backends) {
+      assert.equal(native.hashBenchmark(bytes, 2, backend).digest, expected, `${backend} over ${bytes} bytes`);
+    }
+  }
+});
+
+// verify().
+
+test('verify checks every hashed region and reports each section', async () => {
+  for (const name of fixtureNames) {
+    const result = await addon.verify(fixturePaths[name], { concurrency: 4 });
+
+    assert.equal(result.error, undefined);
+    assert.equal(result.ok, true, `${name} should verify`);
+    assert.ok(result.sections.length > 0);
+    assert.ok(result.throughput.bytes > 0);
+
+    for (const section of result.sections) {
+      assert.ok(['hfs0', 'nca'].includes(section.kind));
+      assert.equal(section.coverage, section.kind === 'hfs0' ? 'full' : 'files');
+      assert.equal(section.ok, true);
+      assert.equal(section.firstBad, null);
+    }
+  }
+
+  const xci = await addon.verify(fixturePaths['test.xci']);
+
+  assert.ok(xci.sections.some((section) => section.kind === 'hfs0' && section.section === '/'));
+});
+
+test('verify reports the first bad offset of a corrupted region', async () => {
+  const directory = temporaryDirectory();
+  const corrupted = path.join(directory, 'corrupted.xci');
+  const data = fs.readFileSync(fixturePaths['test.xci']);
+  const rootOffset = Number(data.readBigUInt64LE(0x130));
+
+  // The reserved word of the root partition filesystem header is covered by its hash but read by nothing else.
+  data[rootOffset + 0x0c] ^= 0xff;
+  fs.writeFileSync(corrupted, data);
+
+  const result = await addon.verify(corrupted, { concurrency: 2 });
+  const root = result.sections.find((section) => section.section === '/');
+
+  assert.equal(result.ok, false);
+  assert.equal(root.ok, false);
+  assert.deepEqual(root.firstBad, { path: '/', offset: rootOffset });
+  assert.ok(result.sections.filter((section) => section !== root).every((section) => section.ok));
+});
+
+test('verify reports the file and offset of corrupted content archive data', { skip: missingKeys }, async () => {
+  const { createDecipheriv } = await import('node:crypto');
+  const keys = fs.readFileSync(prodKeysPath, 'utf8');
+  const headerKey = Buffer.from(/^\s*header_key\s*=\s*([0-9a-f]{64})/im.exec(keys)[1], 'hex');
+  const data = fs.readFileSync(fixturePaths['test.nsp']);
+
+  // Content archive headers are AES-XTS with 0x200 byte sectors, tweaked by the big-endian sector number.
+  const decryptHeader = (offset) => Buffer.concat(Array.from({ length: 6 }, (_, sector) => {
+    const tweak = Buffer.alloc(16);
+    tweak.writeBigUInt64BE(BigInt(sector), 8);
+
+    const decipher = createDecipheriv('aes-128-xts', headerKey, tweak);
+    const start = offset + sector * 0x200;
+
+    return Buffer.concat([decipher.update(data.subarray(start, start + 0x200)), decipher.final()]);
+  }));
+
+  // The entries of the package's own partition filesystem header.
+  const count = data.readUInt32LE(4);
+  const names = 0x10 + count * 0x18;
+  const dataStart = names + data.readUInt32LE(8);
+  let target;
+
+  for (let entry = 0; entry < count && !target; entry += 1) {
+    const entryOffset = 0x10 + entry * 0x18;
+    const nameStart = names + data.readUInt32LE(entryOffset + 0x10);
+    const name = data.toString('utf8', nameStart, data.indexOf(0, nameStart));
+
+    if (!name.endsWith('.nca')) {
+      continue;
+    }
+
+    const start = dataStart + Number(data.readBigUInt64LE(entryOffset));
+    const header = decryptHeader(start);
+
+    for (let section = 0; section < 4 && !target; section += 1) {
+      const fsHeader = header.subarray(0x400 + section * 0x200);
+
+      // A partition filesystem section behind a single SHA-256 hash table, such as the ExeFS.
+      if (header.readUInt32LE(0x240 + section * 0x10) !== 0 && fsHeader[2] === 1 && fsHeader[3] === 2) {
+        target = {
+          section: `/${name}/${section}`,
+          blockSize: fsHeader.readUInt32LE(0x28),
+          dataOffset: start + header.readUInt32LE(0x240 + section * 0x10) * 0x200 +
+            Number(fsHeader.readBigUInt64LE(0x40)),
+          dataSize: Number(fsHeader.readBigUInt64LE(0x48)),
+        };
+      }
+    }
+  }
+
+  assert.ok(target, 'test.nsp should hold a partition filesystem section');
+
+  // The section ends with the data of its last file. Flipping a byte of AES-CTR ciphertext flips the same byte of
+  // the decrypted data, so only the last hash block stops matching.
+  const directory = temporaryDirectory();
+  const corrupted = path.join(directory, 'corrupted.nsp');
+
+  data[target.dataOffset + target.dataSize - 1] ^= 0xff;
+  fs.writeFileSync(corrupted, data);
+
+  const result = await addon.verify(corrupted, { concurrency: 2 });
+  const failed = result.sections.filter((section) => !section.ok);
+
+  assert.equal(result.ok, false);
+  assert.equal(failed.length, 1);
+  assert.equal(failed[0].section, target.section);
+  assert.equal(failed[0].kind, 'nca');
+  assert.ok(failed[0].firstBad.path.startsWith(`${target.section}/`));
+
+  // Offsets within the file, narrowed to the 0x4000 byte blocks verify probes with.
+  const pkg = addon.open({ source: fixturePaths['test.nsp'] });
+  const fileStart = target.dataSize - pkg.read(failed[0].firstBad.path).length;
+  const badBlock = Math.floor((target.dataSize - 1) / target.blockSize) * target.blockSize;
+
+  pkg.close();
+  assert.equal(failed[0].firstBad.offset, Math.floor(Math.max(badBlock - fileStart, 0) / 0x4000) * 0x4000);
+
+  // A trusted package skips the hash layers, so the corrupted file reads, corrupted byte and all.
+  const checked = addon.open({ source: corrupted });
+  const trusted = addon.open({ source: corrupted, trusted: true });
+  const read = trusted.read(failed[0].firstBad.path);
+
+  assert.equal(checked.read(failed[0].firstBad.path).error, true);
+  assert.equal(read.length, target.dataSize - fileStart);
+  checked.close();
+  trusted.close();
+});
+
+test('verify returns an error shape for a missing source', async () => {
+  assert.deepEqual(await addon.verify(undefined), {
+    error: true,
+    errorMessage: 'Provide a source file using the "source" option.',
+  });
+});
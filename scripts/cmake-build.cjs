@@ -21,7 +21,21 @@ const libPath = path.join(repoRoot, libDir);
 const configureFlags = process.platform === 'win32' ? ' -- -DCMAKE_CXX_FLAGS=/utf-8' : '';
 const copyCmd = `node "${path.join(__dirname, 'copy-library.cjs')}" ${libName}`;
 
+// mbedtls reads additions to its configuration from MBEDTLS_USER_CONFIG_FILE; ours enables the hardware AES paths.
+// CMake takes its initial C flags from CFLAGS, which avoids quoting the flags through cmake-js on every shell.
+function configureEnvironment() {
+  if (libName !== 'libmbedtls') {
+    return process.env;
+  }
+
+  const userConfig = `-I"${__dirname}" -DMBEDTLS_USER_CONFIG_FILE="<mbedtls-config.h>"`;
+
+  return { ...process.env, CFLAGS: [process.env.CFLAGS, userConfig].filter(Boolean).join(' ') };
+}
+
+const env = configureEnvironment();
+
 execSync('cmake-js clean', { cwd: libPath, stdio: 'inherit' });
-execSync(`cmake-js configure${configureFlags}`, { cwd: libPath, stdio: 'inherit' });
-execSync('cmake-js build', { cwd: libPath, stdio: 'inherit' });
+execSync(`cmake-js configure${configureFlags}`, { cwd: libPath, stdio: 'inherit', env });
+execSync('cmake-js build', { cwd: libPath, stdio: 'inherit', env });
 execSync(copyCmd, { cwd: libPath, stdio: 'inherit' });
@@ -0,0 +1,32 @@
+/*
+ * Additions to the mbedtls configuration used for the addon, included at the end of mbedtls' own config header
+ * through MBEDTLS_USER_CONFIG_FILE (see cmake-build.cjs).
+ *
+ * NCA headers are AES-XTS and sections AES-CTR, so AES is most of the CPU time of an extraction. These enable the
+ * AES-NI (x86-64) and ARMv8 Crypto Extension (AArch64) code paths. mbedtls checks the CPU the first time a key is
+ * used and falls back to its table implementation when the instructions are missing, so one build runs everywhere.
+ */
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MBEDTLS_HAVE_ASM
+#define MBEDTLS_AESNI_C
+#endif
+
+/* Only known to mbedtls 3.5 and later; older versions ignore it and use the table implementation on ARM. */
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define MBEDTLS_AESCE_C
+#endif
+
+/*
+ * SHA-256 blocks are compressed by the addon (mbedtls_internal_sha256_process in src/sha256.cpp), which picks SHA-NI,
+ * the ARMv8 SHA2 instructions or software once per process. mbedtls has no SHA-NI path of its own, and this routes the
+ * hash layers of NCA sections, which libpietendo checks through mbedtls, onto the same backend as the addon's hashing.
+ * It replaces MBEDTLS_SHA256_USE_A64_CRYPTO_IF_PRESENT, which would define the same function.
+ */
+#define MBEDTLS_SHA256_PROCESS_ALT
+
+#define MBEDTLS_CIPHER_MODE_CTR
+#define MBEDTLS_CIPHER_MODE_XTS
+
+/* Keep the software fallback and the runtime check. */
+#undef MBEDTLS_AES_USE_HARDWARE_ONLY
@@ -0,0 +1,195 @@
+#include "batch.h"
+
+#include "json-value.h"
+#include "node-nstool.h"
+#include "parallel.h"
+#include "string-list.h"
+#include <exception>
+
+namespace
+{
+
+std::vector<std::vector<std::string>> invocationList(const Napi::Value &value)
+{
+    std::vector<std::vector<std::string>> invocations;
+
+    if (!value.IsArray())
+    {
+        return invocations;
+    }
+
+    const auto array = value.As<Napi::Array>();
+    invocations.reserve(array.Length());
+
+    for (uint32_t i = 0; i < array.Length(); ++i)
+    {
+        invocations.push_back(StringList(array.Get(i)));
+    }
+
+    return invocations;
+}
+
+Napi::Value resultToJavaScript(Napi::Env env, const BatchResult &result)
+{
+    if (result.document)
+    {
+        return ToJavaScript(env, *result.document);
+    }
+
+    auto object = Napi::Object::New(env);
+    object.Set("error", true);
+    object.Set("errorMessage", result.error);
+
+    return object;
+}
+
+// One finished invocation on its way to JavaScript.
+struct BatchDelivery
+{
+    size_t index;
+    BatchResult result;
+};
+
+void deliver(Napi::Env env, Napi::Function callback, BatchDelivery *delivery)
+{
+    // Without an environment the function is being torn down and the result is only released.
+    if (env != nullptr && callback != nullptr)
+    {
+        callback.Call(
+            {Napi::Number::New(env, static_cast<double>(delivery->index)),
+             resultToJavaScript(env, delivery->result)});
+    }
+
+    delete delivery;
+}
+
+// Shared by the worker and the finalizer of its thread-safe function, which settles the promise once every result
+// has been delivered.
+struct BatchSettlement
+{
+    explicit BatchSettlement(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    void Settle(Napi::Env env)
+    {
+        if (error.empty())
+        {
+            deferred.Resolve(env.Undefined());
+            return;
+        }
+
+        deferred.Reject(Napi::Error::New(env, error).Value());
+    }
+
+    Napi::Promise::Deferred deferred;
+    std::string error;
+};
+
+// Runs the whole batch on threads of its own so that a long scan takes a single slot of the libuv threadpool. Each
+// result is converted on the main thread as soon as it is done, so the conversions are spread over the run instead
+// of blocking the event loop at its end.
+class BatchWorker : public Napi::AsyncWorker
+{
+public:
+    BatchWorker(
+        Napi::Env env,
+        std::vector<std::vector<std::string>> invocations,
+        unsigned concurrency,
+        Napi::Function onResult,
+        std::shared_ptr<CancellationToken> cancellation)
+        : Napi::AsyncWorker(env), invocations(std::move(invocations)), concurrency(concurrency),
+          cancellation(std::move(cancellation)), settlement(std::make_shared<BatchSettlement>(env))
+    {
+        // A bounded queue makes the threads wait while JavaScript falls behind, so finished documents do not pile up.
+        this->onResult = Napi::ThreadSafeFunction::New(
+            env, onResult, "nstool information batch", 64, 1,
+            [settlement = settlement](Napi::Env env) { settlement->Settle(env); });
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return settlement->deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            RunBatch(invocations, concurrency, cancellation,
+                [this](size_t index, BatchResult &&result)
+                { onResult.BlockingCall(new BatchDelivery{index, std::move(result)}, deliver); });
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        onResult.Release();
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        settlement->error = error.Message();
+        onResult.Release();
+    }
+
+private:
+    std::vector<std::vector<std::string>> invocations;
+    unsigned concurrency;
+    std::shared_ptr<CancellationToken> cancellation;
+    std::shared_ptr<BatchSettlement> settlement;
+    Napi::ThreadSafeFunction onResult;
+};
+
+} // namespace
+
+void RunBatch(
+    const std::vector<std::vector<std::string>> &invocations,
+    unsigned concurrency,
+    const std::shared_ptr<CancellationToken> &cancellation,
+    const std::function<void(size_t index, BatchResult &&result)> &emit)
+{
+    ParallelFor(invocations.size(), concurrency,
+        [&](size_t index)
+        {
+            cancellation->ThrowIfCancelled();
+
+            BatchResult result;
+
+            try
+            {
+                result.document = parse(invoke(invocations[index], cancellation));
+            }
+            catch (const OperationCancelled &)
+            {
+                throw;
+            }
+            catch (const std::exception &error)
+            {
+                result.error = error.what();
+            }
+
+            emit(index, std::move(result));
+        });
+}
+
+Napi::Value InformationBatch(const Napi::CallbackInfo &info)
+{
+    const auto concurrency = info[1].IsUndefined() ? 1 : info[1].ToNumber().Uint32Value();
+    auto *worker = new BatchWorker(
+        info.Env(),
+        invocationList(info[0]),
+        concurrency,
+        info[2].As<Napi::Function>(),
+        Cancellation::TokenFrom(info[3]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
@@ -0,0 +1,340 @@
+#include "block-cache.h"
+#include "file-type.h"
+#include "package-fs.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+namespace
+{
+const std::string moduleName = "CachedStream";
+
+thread_local BlockSource *currentSource = nullptr;
+
+void combine(size_t &seed, size_t value)
+{
+    seed ^= value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2);
+}
+} // namespace
+
+size_t BlockKeyHash::operator()(const BlockKey &key) const
+{
+    size_t seed = std::hash<std::string>()(key.section);
+
+    combine(seed, std::hash<uint64_t>()(key.source.size));
+    combine(seed, std::hash<int64_t>()(key.source.modified));
+    combine(seed, std::hash<uint64_t>()(key.source.inode));
+    combine(seed, std::hash<uint64_t>()(key.source.device));
+    combine(seed, std::hash<uint64_t>()(key.keys));
+    combine(seed, std::hash<uint64_t>()(key.block));
+
+    return seed;
+}
+
+BlockCache &BlockCache::Instance()
+{
+    static BlockCache cache;
+
+    return cache;
+}
+
+void BlockCache::Resize(uint64_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    this->capacity = capacity;
+    statistics.capacity = capacity;
+    evict();
+}
+
+bool BlockCache::Enabled() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return capacity != 0;
+}
+
+std::shared_ptr<const BlockCache::Block> BlockCache::Find(const BlockKey &key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (capacity == 0)
+    {
+        return nullptr;
+    }
+
+    const auto found = index.find(key);
+
+    if (found == index.end())
+    {
+        ++statistics.misses;
+        return nullptr;
+    }
+
+    entries.splice(entries.begin(), entries, found->second);
+    ++statistics.hits;
+
+    return found->second->block;
+}
+
+void BlockCache::Insert(const BlockKey &key, std::shared_ptr<const Block> block)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Two threads that missed the same block both decrypt it; the first copy stays.
+    if (block->size() > capacity || index.count(key) != 0)
+    {
+        return;
+    }
+
+    statistics.bytes += block->size();
+    ++statistics.blocks;
+    entries.push_front({key, std::move(block)});
+    index.emplace(key, entries.begin());
+    evict();
+}
+
+void BlockCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    entries.clear();
+    index.clear();
+    statistics = {};
+    statistics.capacity = capacity;
+}
+
+BlockCacheStatistics BlockCache::Statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return statistics;
+}
+
+void BlockCache::evict()
+{
+    while (statistics.bytes > capacity)
+    {
+        const auto &oldest = entries.back();
+
+        statistics.bytes -= oldest.block->size();
+        --statistics.blocks;
+        ++statistics.evictions;
+        index.erase(oldest.key);
+        entries.pop_back();
+    }
+}
+
+CachedStream::CachedStream(std::shared_ptr<tc::io::IStream> inner, BlockKey key)
+    : inner(std::move(inner)), key(std::move(key)), size(this->inner->length())
+{
+}
+
+bool CachedStream::canRead() const
+{
+    return inner != nullptr;
+}
+
+bool CachedStream::canWrite() const
+{
+    return false;
+}
+
+bool CachedStream::canSeek() const
+{
+    return inner != nullptr;
+}
+
+int64_t CachedStream::length()
+{
+    if (!inner)
+    {
+        throw tc::ObjectDisposedException(moduleName, "The stream has been disposed.");
+    }
+
+    return size;
+}
+
+int64_t CachedStream::position()
+{
+    return offset;
+}
+
+size_t CachedStream::read(byte_t *ptr, size_t count)
+{
+    const auto available = std::max<int64_t>(length() - offset, 0);
+    const auto wanted = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(count), available));
+    size_t total = 0;
+
+    while (total < wanted)
+    {
+        const auto position = static_cast<uint64_t>(offset) + total;
+        const auto data = block(position / BlockCache::BlockSize);
+        const auto within = static_cast<size_t>(position % BlockCache::BlockSize);
+
+        if (within >= data->size())
+        {
+            break;
+        }
+
+        const auto size = std::min(wanted - total, data->size() - within);
+
+        std::memcpy(ptr + total, data->data() + within, size);
+        total += size;
+    }
+
+    offset += static_cast<int64_t>(total);
+
+    return total;
+}
+
+size_t CachedStream::write(const byte_t *, size_t)
+{
+    throw tc::NotSupportedException(moduleName, "The stream is read-only.");
+}
+
+int64_t CachedStream::seek(int64_t offset, tc::io::SeekOrigin origin)
+{
+    const auto base = origin == tc::io::SeekOrigin::Begin     ? 0
+                      : origin == tc::io::SeekOrigin::Current ? this->offset
+                                                              : length();
+
+    if (base + offset < 0)
+    {
+        throw tc::ArgumentOutOfRangeException(moduleName, "The seek would move before the start of the stream.");
+    }
+
+    this->offset = base + offset;
+
+    return this->offset;
+}
+
+void CachedStream::setLength(int64_t)
+{
+    throw tc::NotSupportedException(moduleName, "The stream is read-only.");
+}
+
+void CachedStream::flush()
+{
+}
+
+void CachedStream::dispose()
+{
+    if (inner)
+    {
+        inner->dispose();
+        inner.reset();
+    }
+}
+
+std::shared_ptr<const BlockCache::Block> CachedStream::block(uint64_t index)
+{
+    auto &cache = BlockCache::Instance();
+
+    key.block = index;
+
+    if (auto cached = cache.Find(key))
+    {
+        return cached;
+    }
+
+    const auto start = index * BlockCache::BlockSize;
+    const auto wanted = static_cast<size_t>(std::min<uint64_t>(BlockCache::BlockSize, size - start));
+    auto data = std::make_shared<BlockCache::Block>(wanted);
+
+    data->resize(ReadAt(*inner, static_cast<int64_t>(start), data->data(), wanted));
+    cache.Insert(key, data);
+
+    return data;
+}
+
+ScopedBlockSource::ScopedBlockSource(BlockSource *source) : previous(currentSource)
+{
+    currentSource = source;
+}
+
+ScopedBlockSource::~ScopedBlockSource()
+{
+    currentSource = previous;
+}
+
+void MountingSection(tc::io::IStream &archive, int64_t offset)
+{
+    if (currentSource == nullptr)
+    {
+        return;
+    }
+
+    if (currentSource->sections.empty() && currentSource->keyBag != nullptr)
+    {
+        if (const auto layout = ReadContentArchiveLayout(archive, *currentSource->keyBag))
+        {
+            currentSource->sections = layout->sections;
+        }
+    }
+
+    currentSource->mounting = offset;
+}
+
+std::shared_ptr<tc::io::IStream> CacheSection(const std::shared_ptr<tc::io::IStream> &section)
+{
+    if (currentSource == nullptr || !BlockCache::Instance().Enabled())
+    {
+        return section;
+    }
+
+    const auto &sections = currentSource->sections;
+    const auto mounting = std::exchange(currentSource->mounting, -1);
+    const auto found = std::find(sections.begin(), sections.end(), mounting);
+
+    if (mounting <= 0 || found == sections.end())
+    {
+        return section;
+    }
+
+    const auto number = std::distance(sections.begin(), found);
+
+    return std::make_shared<CachedStream>(
+        section,
+        BlockKey{currentSource->source, currentSource->keys, currentSource->path + "#" + std::to_string(number), 0});
+}
+
+Napi::Value ConfigureBlockCache(const Napi::CallbackInfo &info)
+{
+    const auto megabytes = info[0].ToNumber().DoubleValue();
+
+    if (!std::isfinite(megabytes) || megabytes < 0)
+    {
+        Napi::RangeError::New(info.Env(), "The block cache size must be a non-negative number of megabytes.")
+            .ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    BlockCache::Instance().Resize(static_cast<uint64_t>(megabytes * 1024 * 1024));
+
+    return info.Env().Undefined();
+}
+
+Napi::Value ClearBlockCache(const Napi::CallbackInfo &info)
+{
+    BlockCache::Instance().Clear();
+
+    return info.Env().Undefined();
+}
+
+Napi::Value BlockCacheStats(const Napi::CallbackInfo &info)
+{
+    const auto statistics = BlockCache::Instance().Statistics();
+
+    auto result = Napi::Object::New(info.Env());
+    result.Set("capacity", Napi::Number::New(info.Env(), static_cast<double>(statistics.capacity)));
+    result.Set("bytes", Napi::Number::New(info.Env(), static_cast<double>(statistics.bytes)));
+    result.Set("blocks", Napi::Number::New(info.Env(), static_cast<double>(statistics.blocks)));
+    result.Set("hits", Napi::Number::New(info.Env(), static_cast<double>(statistics.hits)));
+    result.Set("misses", Napi::Number::New(info.Env(), static_cast<double>(statistics.misses)));
+    result.Set("evictions", Napi::Number::New(info.Env(), static_cast<double>(statistics.evictions)));
+
+    return result;
+}
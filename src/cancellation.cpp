@@ -0,0 +1,54 @@
+#include "cancellation.h"
+
+#include "addon-data.h"
+
+void CancellationToken::Cancel()
+{
+    cancelled = true;
+}
+
+bool CancellationToken::IsCancelled() const
+{
+    return cancelled;
+}
+
+void CancellationToken::ThrowIfCancelled() const
+{
+    if (cancelled)
+    {
+        throw OperationCancelled();
+    }
+}
+
+Napi::Function Cancellation::Define(Napi::Env env)
+{
+    auto function = DefineClass(env, "Cancellation", {InstanceMethod("cancel", &Cancellation::Cancel)});
+
+    env.GetInstanceData<AddonData>()->cancellation = Napi::Persistent(function);
+
+    return function;
+}
+
+Cancellation::Cancellation(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<Cancellation>(info), token(std::make_shared<CancellationToken>())
+{
+}
+
+std::shared_ptr<CancellationToken> Cancellation::TokenFrom(const Napi::Value &value)
+{
+    const auto &constructor = value.Env().GetInstanceData<AddonData>()->cancellation;
+
+    if (value.IsObject() && value.As<Napi::Object>().InstanceOf(constructor.Value()))
+    {
+        return Unwrap(value.As<Napi::Object>())->token;
+    }
+
+    return std::make_shared<CancellationToken>();
+}
+
+Napi::Value Cancellation::Cancel(const Napi::CallbackInfo &info)
+{
+    token->Cancel();
+
+    return info.Env().Undefined();
+}
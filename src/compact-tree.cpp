@@ -0,0 +1,63 @@
+#include "compact-tree.h"
+
+#include <deque>
+#include <utility>
+
+namespace
+{
+
+int32_t addEntry(
+    CompactTree &tree, int32_t parent, const std::string &name, double size, double dataOffset, uint8_t flags)
+{
+    tree.parent.push_back(parent);
+    tree.nameOffset.push_back(static_cast<uint32_t>(tree.names.size()));
+    tree.nameLength.push_back(static_cast<uint32_t>(name.size()));
+    tree.size.push_back(size);
+    tree.dataOffset.push_back(dataOffset);
+    tree.flags.push_back(flags);
+    tree.names += name;
+
+    return static_cast<int32_t>(tree.parent.size() - 1);
+}
+
+} // namespace
+
+CompactTree BuildCompactTree(PackageFileSystem &fileSystem, bool nested)
+{
+    CompactTree tree;
+    std::deque<std::pair<int32_t, std::string>> pending;
+
+    pending.emplace_back(addEntry(tree, -1, "", 0, -1, CompactTree::directoryFlag), "/");
+
+    while (!pending.empty())
+    {
+        const auto [index, path] = std::move(pending.front());
+        pending.pop_front();
+
+        tc::io::sDirectoryListing listing;
+        fileSystem.ListDirectory(path, listing);
+
+        const auto base = path.back() == '/' ? path : path + "/";
+
+        for (const auto &name : listing.dir_list)
+        {
+            pending.emplace_back(addEntry(tree, index, name, 0, -1, CompactTree::directoryFlag), base + name);
+        }
+
+        for (const auto &name : listing.file_list)
+        {
+            const auto isContainer = Container::IsContainerName(name);
+            const auto dataOffset = fileSystem.DataOffset(base + name);
+            const auto child = addEntry(
+                tree, index, name, static_cast<double>(fileSystem.OpenFile(base + name)->length()),
+                dataOffset ? static_cast<double>(*dataOffset) : -1, isContainer ? CompactTree::containerFlag : 0);
+
+            if (nested && isContainer)
+            {
+                pending.emplace_back(child, base + name);
+            }
+        }
+    }
+
+    return tree;
+}
@@ -0,0 +1,239 @@
+#include "container.h"
+
+#include "GameCardProcess.h"
+#include "NcaProcess.h"
+#include "PfsProcess.h"
+#include "RomfsProcess.h"
+#include "file-type.h"
+#include "key-cache.h"
+#include "nstool-session.h"
+#include "offset-probe.h"
+#include "output-sink.h"
+#include "split-source.h"
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+thread_local const Container *mountingContainer = nullptr;
+
+// Binds the container being mounted to the calling thread for the lifetime of the scope.
+class ScopedMount
+{
+public:
+    explicit ScopedMount(const Container *container) : previous(std::exchange(mountingContainer, container))
+    {
+    }
+
+    ~ScopedMount()
+    {
+        mountingContainer = previous;
+    }
+
+    ScopedMount(const ScopedMount &) = delete;
+    ScopedMount &operator=(const ScopedMount &) = delete;
+
+private:
+    const Container *previous;
+};
+
+template <typename Process>
+std::shared_ptr<tc::io::IFileSystem> mountWith(
+    const std::shared_ptr<tc::io::IStream> &stream, const nstool::Settings &settings)
+{
+    Process process;
+
+    process.setInputFile(stream);
+    process.setKeyCfg(settings.opt.keybag);
+    process.setCliOutputMode(nstool::CliOutputMode());
+    process.setVerifyMode(settings.opt.verify);
+    process.process();
+
+    return process.getFileSystem();
+}
+
+bool hasOption(const std::vector<std::string> &args, const char *shortName, const char *longName)
+{
+    return std::find_if(
+               args.begin(), args.end(),
+               [&](const std::string &arg) { return arg == shortName || arg == longName; }) != args.end();
+}
+
+} // namespace
+
+Container::Container(
+    nstool::Settings settings, uint64_t keyFingerprint, std::string sourcePath, std::vector<std::string> parts,
+    std::vector<std::shared_ptr<const FileMapping>> mappings)
+    : settings(std::move(settings)), keyFingerprint(keyFingerprint), sourcePath(std::move(sourcePath)),
+      parts(std::move(parts)), mappings(std::move(mappings))
+{
+}
+
+std::shared_ptr<Container> Container::Open(const std::vector<std::string> &args, const ContainerOptions &options)
+{
+    if (args.size() < 2)
+    {
+        throw std::runtime_error("No source file was given.");
+    }
+
+    // The source is always the last argument, as built by the JavaScript wrapper. It may name a part of a split dump,
+    // or a directory of parts, unless the parts are given.
+    auto parts = options.parts.empty() ? FindSplitParts(args.back()) : options.parts;
+
+    nstool::Settings settings;
+    settings.infile.path = tc::io::Path(parts.front());
+    settings.infile.filetype = nstool::Settings::FILE_TYPE_ERROR;
+    settings.opt.is_dev = hasOption(args, "-d", "--dev");
+    settings.opt.verify = !options.trusted && hasOption(args, "-y", "--verify");
+
+    for (size_t i = 0; i + 1 < args.size(); ++i)
+    {
+        if (args[i] == "-t" || args[i] == "--type")
+        {
+            settings.infile.filetype = FileTypeFromName(args[i + 1]);
+        }
+    }
+
+    std::vector<std::shared_ptr<const FileMapping>> mappings;
+
+    if (options.input == InputBackend::Mapped)
+    {
+        for (const auto &part : parts)
+        {
+            mappings.push_back(std::make_shared<const FileMapping>(part, options.access));
+        }
+    }
+
+    // The key cache hands the arguments to nstool, which needs an input file rather than a directory of parts.
+    auto keyArgs = args;
+    keyArgs.back() = parts.front();
+    settings.opt.keybag = KeyCache::Instance().Get(keyArgs);
+
+    const auto keyFingerprint = KeyCache::Instance().Fingerprint(keyArgs);
+    std::shared_ptr<Container> container(
+        new Container(std::move(settings), keyFingerprint, args.back(), std::move(parts), std::move(mappings)));
+    container->trusted = options.trusted;
+
+    if (container->settings.infile.filetype == nstool::Settings::FILE_TYPE_ERROR)
+    {
+        container->settings.infile.filetype = SniffFileType(*container->OpenSource(), container->settings.opt.keybag);
+    }
+
+    return container;
+}
+
+std::shared_ptr<tc::io::IFileSystem> Container::Mount() const
+{
+    return mountStream(OpenSource(), settings.infile.filetype);
+}
+
+std::shared_ptr<tc::io::IFileSystem> Container::MountNested(
+    const std::shared_ptr<tc::io::IStream> &stream, const std::string &name) const
+{
+    return mountStream(stream, FileTypeFromExtension(name));
+}
+
+bool Container::IsContainerName(const std::string &name)
+{
+    return FileTypeFromExtension(name) != nstool::Settings::FILE_TYPE_ERROR;
+}
+
+const tc::io::Path &Container::Source() const
+{
+    return settings.infile.path.get();
+}
+
+nstool::Settings::FileType Container::Type() const
+{
+    return settings.infile.filetype;
+}
+
+std::shared_ptr<tc::io::IStream> Container::OpenSource() const
+{
+    std::vector<std::shared_ptr<tc::io::IStream>> streams;
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        if (!mappings.empty())
+        {
+            streams.push_back(std::make_shared<MappedFileStream>(mappings[i]));
+            continue;
+        }
+
+        streams.push_back(std::make_shared<tc::io::FileStream>(
+            tc::io::Path(parts[i]), tc::io::FileMode::Open, tc::io::FileAccess::Read));
+    }
+
+    if (streams.size() == 1)
+    {
+        return streams.front();
+    }
+
+    return std::make_shared<ConcatenatedStream>(streams);
+}
+
+const std::vector<std::string> &Container::Parts() const
+{
+    return parts;
+}
+
+bool Container::Split() const
+{
+    return parts.size() > 1 || parts.front() != sourcePath;
+}
+
+uint64_t Container::KeyFingerprint() const
+{
+    return keyFingerprint;
+}
+
+const nstool::KeyBag &Container::Keys() const
+{
+    return settings.opt.keybag;
+}
+
+bool Container::Trusted() const
+{
+    return trusted;
+}
+
+std::shared_ptr<tc::io::IFileSystem> Container::mountStream(
+    const std::shared_ptr<tc::io::IStream> &stream, nstool::Settings::FileType type) const
+{
+    // The processes are told not to print anything, but keep whatever they still write away from stdout.
+    OutputSink discarded;
+    ScopedOutputSink scope(discarded);
+    ScopedMount mounting(this);
+
+    // Files of the container are windows into the stream, so a probe over it finds where they start.
+    const auto probed = std::make_shared<OffsetProbeStream>(stream);
+
+    switch (type)
+    {
+    case nstool::Settings::FILE_TYPE_GAMECARD:
+        return mountWith<nstool::GameCardProcess>(probed, settings);
+    case nstool::Settings::FILE_TYPE_NSP:
+    case nstool::Settings::FILE_TYPE_PARTITIONFS:
+        return mountWith<nstool::PfsProcess>(probed, settings);
+    case nstool::Settings::FILE_TYPE_NCA:
+        return mountWith<nstool::NcaProcess>(probed, settings);
+    case nstool::Settings::FILE_TYPE_ROMFS:
+        return mountWith<nstool::RomfsProcess>(probed, settings);
+    default:
+        throw std::runtime_error("The source is not a package with a filesystem.");
+    }
+}
+
+bool MountingTrusted()
+{
+    if (mountingContainer != nullptr)
+    {
+        return mountingContainer->Trusted();
+    }
+
+    const auto *session = CurrentNstoolSession();
+
+    return session != nullptr && session->container != nullptr && session->container->Trusted();
+}
@@ -0,0 +1,90 @@
+#include "cpu-features.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NSTOOL_CPU_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NSTOOL_CPU_ARM64
+#if defined(__linux__)
+#include <sys/auxv.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+#endif
+
+namespace
+{
+
+#if defined(NSTOOL_CPU_X86)
+void cpuid(unsigned leaf, unsigned registers[4])
+{
+#if defined(_MSC_VER)
+    int values[4];
+    __cpuidex(values, static_cast<int>(leaf), 0);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        registers[i] = static_cast<unsigned>(values[i]);
+    }
+#else
+    __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+#endif
+
+CpuFeatures detect()
+{
+    CpuFeatures features;
+
+#if defined(NSTOOL_CPU_X86)
+    unsigned registers[4] = {};
+    cpuid(1, registers);
+
+    features.aes = (registers[2] & (1u << 25)) != 0;
+    features.carrylessMultiply = (registers[2] & (1u << 1)) != 0;
+
+    const auto sse41 = (registers[2] & (1u << 19)) != 0;
+    const auto ssse3 = (registers[2] & (1u << 9)) != 0;
+
+    cpuid(0, registers);
+
+    if (registers[0] >= 7)
+    {
+        cpuid(7, registers);
+        features.sha2 = sse41 && ssse3 && (registers[1] & (1u << 29)) != 0;
+    }
+#elif defined(NSTOOL_CPU_ARM64)
+#if defined(__linux__)
+    // HWCAP_AES, HWCAP_PMULL and HWCAP_SHA2 from <asm/hwcap.h>, spelled out for older kernel headers.
+    const auto hwcap = getauxval(AT_HWCAP);
+
+    features.aes = (hwcap & (1ul << 3)) != 0;
+    features.carrylessMultiply = (hwcap & (1ul << 4)) != 0;
+    features.sha2 = (hwcap & (1ul << 6)) != 0;
+#elif defined(__APPLE__)
+    // Every Apple Silicon CPU implements the Crypto Extension.
+    features.aes = true;
+    features.carrylessMultiply = true;
+    features.sha2 = true;
+#elif defined(_WIN32)
+    features.aes = IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE) != 0;
+    features.carrylessMultiply = features.aes;
+    features.sha2 = features.aes;
+#endif
+#endif
+
+    return features;
+}
+
+} // namespace
+
+const CpuFeatures &DetectCpuFeatures()
+{
+    static const CpuFeatures features = detect();
+
+    return features;
+}
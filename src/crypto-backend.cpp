@@ -0,0 +1,267 @@
+#include "crypto-backend.h"
+
+#include "cpu-features.h"
+#include "parallel.h"
+#include "sha256.h"
+#include <mbedtls/aes.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+// NCA headers are encrypted in 0x200 byte XTS sectors.
+constexpr size_t xtsSectorSize = 0x200;
+
+} // namespace
+
+// mbedtls' own checks for its hardware AES paths. They exist in the linked library only when it was built with those
+// paths, whatever configuration the addon itself was compiled with, so they are declared weak (or, with MSVC, given a
+// fallback) and resolve to nothing otherwise. mbedtls 3.6 renamed the ARMv8 check.
+extern "C"
+{
+#if defined(_MSC_VER)
+    int mbedtls_aesni_has_support(unsigned int what);
+    int mbedtls_aesce_has_support(void);
+    int mbedtls_aesce_has_support_impl(void);
+
+    int nodeNstoolAesUnavailable(unsigned int)
+    {
+        return 0;
+    }
+
+    int nodeNstoolAesceUnavailable(void)
+    {
+        return 0;
+    }
+#if defined(_M_IX86)
+#pragma comment(linker, "/alternatename:_mbedtls_aesni_has_support=_nodeNstoolAesUnavailable")
+#else
+#pragma comment(linker, "/alternatename:mbedtls_aesni_has_support=nodeNstoolAesUnavailable")
+#pragma comment(linker, "/alternatename:mbedtls_aesce_has_support=nodeNstoolAesceUnavailable")
+#pragma comment(linker, "/alternatename:mbedtls_aesce_has_support_impl=nodeNstoolAesceUnavailable")
+#endif
+#else
+    int mbedtls_aesni_has_support(unsigned int what) __attribute__((weak));
+    int mbedtls_aesce_has_support(void) __attribute__((weak));
+    int mbedtls_aesce_has_support_impl(void) __attribute__((weak));
+#endif
+}
+
+namespace
+{
+
+// The AES capability bit of mbedtls_aesni_has_support, the same in every mbedtls version.
+constexpr unsigned int aesniAes = 0x02000000u;
+
+// Whether the linked mbedtls decrypts with the AES instructions on this machine. A library built without its hardware
+// paths never references the checks, so the linker leaves them out and the table implementation is the one in use.
+bool linkedHardwareAes()
+{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#if defined(_MSC_VER)
+    return mbedtls_aesni_has_support(aesniAes) != 0;
+#else
+    return mbedtls_aesni_has_support != nullptr && mbedtls_aesni_has_support(aesniAes) != 0;
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#if defined(_MSC_VER)
+    return (mbedtls_aesce_has_support_impl() != 0 || mbedtls_aesce_has_support() != 0) && DetectCpuFeatures().aes;
+#else
+    const auto check = mbedtls_aesce_has_support_impl != nullptr ? mbedtls_aesce_has_support_impl
+                                                                 : mbedtls_aesce_has_support;
+
+    return check != nullptr && check() != 0 && DetectCpuFeatures().aes;
+#endif
+#else
+    return false;
+#endif
+}
+
+std::string aesImplementation()
+{
+    if (!linkedHardwareAes())
+    {
+        return "software";
+    }
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return "armv8";
+#else
+    return "aes-ni";
+#endif
+}
+
+void decryptCtr(std::vector<unsigned char> &buffer)
+{
+    const std::array<unsigned char, 16> key = {};
+    std::array<unsigned char, 16> counter = {};
+    std::array<unsigned char, 16> streamBlock = {};
+    size_t offset = 0;
+    mbedtls_aes_context context;
+
+    mbedtls_aes_init(&context);
+    mbedtls_aes_setkey_enc(&context, key.data(), 128);
+    mbedtls_aes_crypt_ctr(
+        &context, buffer.size(), &offset, counter.data(), streamBlock.data(), buffer.data(), buffer.data());
+    mbedtls_aes_free(&context);
+}
+
+void decryptXts(std::vector<unsigned char> &buffer)
+{
+#if defined(MBEDTLS_CIPHER_MODE_XTS)
+    const std::array<unsigned char, 32> key = {};
+    mbedtls_aes_xts_context context;
+
+    mbedtls_aes_xts_init(&context);
+    mbedtls_aes_xts_setkey_dec(&context, key.data(), 256);
+
+    for (size_t sector = 0; sector * xtsSectorSize < buffer.size(); ++sector)
+    {
+        // Nintendo stores the sector number big-endian in the tweak.
+        std::array<unsigned char, 16> tweak = {};
+
+        for (size_t i = 0; i < sizeof(sector); ++i)
+        {
+            tweak[15 - i] = static_cast<unsigned char>(sector >> (8 * i));
+        }
+
+        auto *data = buffer.data() + sector * xtsSectorSize;
+        mbedtls_aes_crypt_xts(&context, MBEDTLS_AES_DECRYPT, xtsSectorSize, tweak.data(), data, data);
+    }
+
+    mbedtls_aes_xts_free(&context);
+#else
+    static_cast<void>(buffer);
+    throw std::runtime_error("mbedtls was built without AES-XTS.");
+#endif
+}
+
+} // namespace
+
+Napi::Value CryptoBackend(const Napi::CallbackInfo &info)
+{
+    const auto &features = DetectCpuFeatures();
+    auto cpu = Napi::Object::New(info.Env());
+    cpu.Set("aes", features.aes);
+    cpu.Set("carrylessMultiply", features.carrylessMultiply);
+    cpu.Set("sha2", features.sha2);
+
+    auto result = Napi::Object::New(info.Env());
+    result.Set("aes", aesImplementation());
+    result.Set("sha256", Sha256BackendName(ActiveSha256Backend()));
+    result.Set("cpu", cpu);
+
+    return result;
+}
+
+Napi::Value CipherBenchmark(const Napi::CallbackInfo &info)
+{
+    const auto mode = info[0].ToString().Utf8Value();
+    const auto bytes = static_cast<size_t>(info[1].ToNumber().Int64Value());
+    const auto threads = std::max<uint32_t>(1, info[2].ToNumber().Uint32Value());
+
+    if (mode != "ctr" && mode != "xts")
+    {
+        Napi::Error::New(info.Env(), "The cipher mode must be either \"ctr\" or \"xts\".").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    // Whole sectors, so XTS never sees a partial one.
+    const auto length = std::max(xtsSectorSize, bytes / xtsSectorSize * xtsSectorSize);
+    std::vector<std::vector<unsigned char>> buffers(threads, std::vector<unsigned char>(length));
+
+    const auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        ParallelFor(
+            threads, threads,
+            [&](size_t index)
+            {
+                if (mode == "ctr")
+                {
+                    decryptCtr(buffers[index]);
+                    return;
+                }
+
+                decryptXts(buffers[index]);
+            });
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto result = Napi::Object::New(info.Env());
+    result.Set("mode", mode);
+    result.Set("threads", threads);
+    result.Set("bytes", static_cast<double>(length) * threads);
+    result.Set("seconds", elapsed.count());
+
+    return result;
+}
+
+Napi::Value HashBenchmark(const Napi::CallbackInfo &info)
+{
+    const auto bytes = static_cast<size_t>(info[0].ToNumber().Int64Value());
+    const auto threads = std::max<uint32_t>(1, info[1].ToNumber().Uint32Value());
+    const auto name = info[2].IsUndefined() ? Sha256BackendName(ActiveSha256Backend()) : info[2].ToString().Utf8Value();
+    auto backend = Sha256Backend::Software;
+
+    for (const auto candidate : {Sha256Backend::Software, Sha256Backend::ShaNi, Sha256Backend::Armv8})
+    {
+        if (Sha256BackendName(candidate) == name)
+        {
+            backend = candidate;
+        }
+    }
+
+    if (Sha256BackendName(backend) != name || !IsSha256BackendAvailable(backend))
+    {
+        Napi::Error::New(info.Env(), "The SHA-256 backend is not available: " + name).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    const std::vector<uint8_t> buffer(bytes);
+    std::vector<Sha256Hash> digests(threads);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    ParallelFor(
+        threads, threads,
+        [&](size_t index)
+        {
+            Sha256 hash(backend);
+            hash.Update(buffer.data(), buffer.size());
+            digests[index] = hash.Finalize();
+        });
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::string digest;
+
+    for (const auto byte : digests.front())
+    {
+        char hex[3];
+        std::snprintf(hex, sizeof(hex), "%02x", byte);
+        digest += hex;
+    }
+
+    auto result = Napi::Object::New(info.Env());
+    result.Set("backend", name);
+    result.Set("threads", threads);
+    result.Set("bytes", static_cast<double>(bytes) * threads);
+    result.Set("seconds", elapsed.count());
+    result.Set("digest", digest);
+
+    return result;
+}
@@ -0,0 +1,512 @@
+#include "event-stream.h"
+
+#include "cancellation.h"
+#include "json-value.h"
+#include "node-nstool.h"
+#include "string-list.h"
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+using Json = nlohmann::ordered_json;
+
+// Builds a document from SAX events the way Json::parse does: later duplicate keys replace earlier ones, and a parse
+// error is thrown.
+class DomBuilder : public nlohmann::json_sax<Json>
+{
+public:
+    explicit DomBuilder(Json &root) : root(root)
+    {
+    }
+
+    bool null() override
+    {
+        return add(nullptr);
+    }
+
+    bool boolean(bool val) override
+    {
+        return add(val);
+    }
+
+    bool number_integer(number_integer_t val) override
+    {
+        return add(val);
+    }
+
+    bool number_unsigned(number_unsigned_t val) override
+    {
+        return add(val);
+    }
+
+    bool number_float(number_float_t val, const string_t &) override
+    {
+        return add(val);
+    }
+
+    bool string(string_t &val) override
+    {
+        return add(std::move(val));
+    }
+
+    bool binary(binary_t &val) override
+    {
+        return add(Json::binary(std::move(val)));
+    }
+
+    bool start_object(std::size_t) override
+    {
+        return open(Json::object());
+    }
+
+    bool key(string_t &val) override
+    {
+        pendingKey = std::move(val);
+
+        return true;
+    }
+
+    bool end_object() override
+    {
+        containers.pop_back();
+
+        return true;
+    }
+
+    bool start_array(std::size_t) override
+    {
+        return open(Json::array());
+    }
+
+    bool end_array() override
+    {
+        containers.pop_back();
+
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const Json::exception &error) override
+    {
+        throw std::runtime_error(error.what());
+    }
+
+private:
+    // Only the innermost open container grows, so the pointers to the ones around it stay valid.
+    Json *place(Json &&value)
+    {
+        if (containers.empty())
+        {
+            root = std::move(value);
+            return &root;
+        }
+
+        auto &parent = *containers.back();
+
+        if (parent.is_array())
+        {
+            parent.push_back(std::move(value));
+            return &parent.back();
+        }
+
+        auto &element = parent[pendingKey];
+        element = std::move(value);
+
+        return &element;
+    }
+
+    bool add(Json &&value)
+    {
+        place(std::move(value));
+
+        return true;
+    }
+
+    bool open(Json &&container)
+    {
+        containers.push_back(place(std::move(container)));
+
+        return true;
+    }
+
+    Json &root;
+    std::vector<Json *> containers;
+    string_t pendingKey;
+};
+
+// Builds the document with a DomBuilder, except for the elements of the top-level "events" array. Each of those is
+// built on its own and handed over once complete.
+class EventSplitter : public nlohmann::json_sax<Json>
+{
+public:
+    EventSplitter(Json &document, const std::function<void(Json &&event)> &onEvent)
+        : documentBuilder(document), onEvent(onEvent)
+    {
+    }
+
+    bool null() override
+    {
+        return value([](DomBuilder &builder) { return builder.null(); });
+    }
+
+    bool boolean(bool val) override
+    {
+        return value([&](DomBuilder &builder) { return builder.boolean(val); });
+    }
+
+    bool number_integer(number_integer_t val) override
+    {
+        return value([&](DomBuilder &builder) { return builder.number_integer(val); });
+    }
+
+    bool number_unsigned(number_unsigned_t val) override
+    {
+        return value([&](DomBuilder &builder) { return builder.number_unsigned(val); });
+    }
+
+    bool number_float(number_float_t val, const string_t &text) override
+    {
+        return value([&](DomBuilder &builder) { return builder.number_float(val, text); });
+    }
+
+    bool string(string_t &val) override
+    {
+        return value([&](DomBuilder &builder) { return builder.string(val); });
+    }
+
+    bool binary(binary_t &val) override
+    {
+        return value([&](DomBuilder &builder) { return builder.binary(val); });
+    }
+
+    bool start_object(std::size_t length) override
+    {
+        return open(false, [&](DomBuilder &builder) { return builder.start_object(length); });
+    }
+
+    bool key(string_t &val) override
+    {
+        if (depth == 1)
+        {
+            lastKey = val;
+        }
+
+        return current().key(val);
+    }
+
+    bool end_object() override
+    {
+        return close([](DomBuilder &builder) { return builder.end_object(); });
+    }
+
+    bool start_array(std::size_t length) override
+    {
+        return open(true, [&](DomBuilder &builder) { return builder.start_array(length); });
+    }
+
+    bool end_array() override
+    {
+        return close([](DomBuilder &builder) { return builder.end_array(); });
+    }
+
+    bool parse_error(std::size_t position, const std::string &token, const Json::exception &error) override
+    {
+        return documentBuilder.parse_error(position, token, error);
+    }
+
+private:
+    // Whether the next value is an element of the events array.
+    bool atEvent() const
+    {
+        return inEvents && depth == 2 && !eventBuilder;
+    }
+
+    DomBuilder &current()
+    {
+        return eventBuilder ? *eventBuilder : documentBuilder;
+    }
+
+    template <typename Call> bool value(Call call)
+    {
+        if (atEvent())
+        {
+            Json event;
+            DomBuilder builder(event);
+            call(builder);
+            onEvent(std::move(event));
+
+            return true;
+        }
+
+        return call(current());
+    }
+
+    template <typename Call> bool open(bool isArray, Call call)
+    {
+        if (atEvent())
+        {
+            event = Json();
+            eventBuilder = std::make_unique<DomBuilder>(event);
+        }
+        else if (!eventBuilder && depth == 1 && isArray && lastKey == "events")
+        {
+            inEvents = true;
+        }
+
+        ++depth;
+
+        return call(current());
+    }
+
+    template <typename Call> bool close(Call call)
+    {
+        --depth;
+
+        const auto result = call(current());
+
+        if (eventBuilder && depth == 2)
+        {
+            eventBuilder.reset();
+            onEvent(std::move(event));
+        }
+        else if (inEvents && depth == 1)
+        {
+            inEvents = false;
+        }
+
+        return result;
+    }
+
+    DomBuilder documentBuilder;
+    const std::function<void(Json &&event)> &onEvent;
+    Json event;
+    std::unique_ptr<DomBuilder> eventBuilder;
+    size_t depth = 0;
+    bool inEvents = false;
+    std::string lastKey;
+};
+
+EventPolicy eventPolicy(const Napi::Value &value)
+{
+    const auto name = value.IsString() ? value.ToString().Utf8Value() : "";
+
+    return name == "drop" ? EventPolicy::Drop : name == "coalesce" ? EventPolicy::Coalesce : EventPolicy::Block;
+}
+
+// The outcome of a streaming run, settled from the finalizer of the event function once every queued event has been
+// delivered.
+struct StreamSettlement
+{
+    explicit StreamSettlement(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    void Settle(Napi::Env env)
+    {
+        if (!document)
+        {
+            deferred.Reject(Napi::Error::New(env, error).Value());
+            return;
+        }
+
+        const auto counts = queue->Counts();
+        auto result = ToJavaScript(env, *document).As<Napi::Object>();
+        auto eventCounts = Napi::Object::New(env);
+
+        eventCounts.Set("delivered", Napi::Number::New(env, static_cast<double>(counts.delivered)));
+        eventCounts.Set("dropped", Napi::Number::New(env, static_cast<double>(counts.dropped)));
+        eventCounts.Set("coalesced", Napi::Number::New(env, static_cast<double>(counts.coalesced)));
+        result.Set("eventCounts", eventCounts);
+
+        deferred.Resolve(result);
+    }
+
+    Napi::Promise::Deferred deferred;
+    std::shared_ptr<EventQueue> queue;
+    std::optional<Json> document;
+    std::string error;
+};
+
+// Once the token is cancelled no further event reaches JavaScript: the queue is closed, which drops what it holds and
+// anything pushed later, and the run stops at its next read of the source. The event function is released when the
+// run has stopped, which settles the promise.
+class StreamWorker : public Napi::AsyncWorker
+{
+public:
+    StreamWorker(
+        Napi::Env env,
+        std::vector<std::string> args,
+        const Napi::Function &onEvent,
+        size_t queueSize,
+        EventPolicy policy,
+        std::shared_ptr<CancellationToken> cancellation)
+        : Napi::AsyncWorker(env), args(std::move(args)), queue(std::make_shared<EventQueue>(queueSize, policy)),
+          cancellation(std::move(cancellation)), settlement(std::make_shared<StreamSettlement>(env))
+    {
+        settlement->queue = queue;
+        // The queue wakes JavaScript at most once per drain, so the function needs no bound of its own.
+        events = Napi::ThreadSafeFunction::New(
+            env, onEvent, "nstool events", 0, 1, [settlement = settlement](Napi::Env env) { settlement->Settle(env); });
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return settlement->deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        const auto push = [this](Json &&event)
+        {
+            if (cancellation->IsCancelled())
+            {
+                queue->Close();
+            }
+
+            if (queue->Push(std::move(event)))
+            {
+                events.NonBlockingCall(
+                    [queue = queue, cancellation = cancellation](Napi::Env env, Napi::Function callback)
+                    {
+                        // Without an environment JavaScript is gone, and after an abort it no longer wants events;
+                        // either way stop producers from waiting for it.
+                        if (env == nullptr || callback == nullptr || cancellation->IsCancelled())
+                        {
+                            queue->Close();
+                            return;
+                        }
+
+                        for (auto &event : queue->Drain())
+                        {
+                            callback.Call({ToJavaScript(env, event)});
+                        }
+                    });
+            }
+        };
+
+        try
+        {
+            settlement->document = invokeStreaming(args, push, cancellation);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        events.Release();
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        settlement->error = error.Message();
+        events.Release();
+    }
+
+private:
+    std::vector<std::string> args;
+    std::shared_ptr<EventQueue> queue;
+    std::shared_ptr<CancellationToken> cancellation;
+    std::shared_ptr<StreamSettlement> settlement;
+    Napi::ThreadSafeFunction events;
+};
+
+} // namespace
+
+EventQueue::EventQueue(size_t capacity, EventPolicy policy) : capacity(std::max<size_t>(capacity, 1)), policy(policy)
+{
+}
+
+bool EventQueue::Push(nlohmann::ordered_json &&event)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (policy == EventPolicy::Block)
+    {
+        drained.wait(lock, [this]() { return closed || events.size() < capacity; });
+    }
+
+    if (closed || (policy == EventPolicy::Drop && events.size() >= capacity))
+    {
+        ++counts.dropped;
+        return false;
+    }
+
+    if (policy == EventPolicy::Coalesce && events.size() >= capacity)
+    {
+        events.back() = std::move(event);
+        ++counts.coalesced;
+        return false;
+    }
+
+    events.push_back(std::move(event));
+
+    const auto wake = !wakePending;
+    wakePending = true;
+
+    return wake;
+}
+
+std::deque<nlohmann::ordered_json> EventQueue::Drain()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto taken = std::move(events);
+
+    events.clear();
+    counts.delivered += taken.size();
+    wakePending = false;
+    drained.notify_all();
+
+    return taken;
+}
+
+void EventQueue::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    closed = true;
+    counts.dropped += events.size();
+    events.clear();
+    drained.notify_all();
+}
+
+EventCounts EventQueue::Counts()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return counts;
+}
+
+nlohmann::ordered_json ParseWithEventStream(
+    std::istream &input, const std::function<void(nlohmann::ordered_json &&event)> &onEvent)
+{
+    Json document;
+    EventSplitter splitter(document, onEvent);
+
+    Json::sax_parse(input, &splitter);
+
+    return document;
+}
+
+Napi::Value RunStreamingAsync(const Napi::CallbackInfo &info)
+{
+    auto args = StringList(info[0]);
+    const auto queueSize = info[2].IsUndefined() ? 1024 : static_cast<size_t>(info[2].ToNumber().Int64Value());
+    auto *worker = new StreamWorker(
+        info.Env(),
+        std::move(args),
+        info[1].As<Napi::Function>(),
+        queueSize,
+        eventPolicy(info[3]),
+        Cancellation::TokenFrom(info[4]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
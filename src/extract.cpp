@@ -0,0 +1,555 @@
+#include "extract.h"
+
+#include "file-type.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+
+constexpr size_t copyBufferSize = 1024 * 1024;
+const std::string romFsPrefix = "romfs:/";
+
+// Converts the name of a file or directory in the package into a single path component below the output directory.
+// Names come from the package, so one that is empty, climbs out with "." or "..", or carries a separator or root of
+// its own is refused instead of being written wherever it points.
+std::filesystem::path outputName(const std::string &name)
+{
+    const auto host = ToHostPath(name);
+
+    if (name.empty() || name == "." || name == ".." || name.find_first_of("/\\") != std::string::npos ||
+        name.find('\0') != std::string::npos || host.has_root_path() ||
+        std::distance(host.begin(), host.end()) != 1)
+    {
+        throw std::runtime_error("The package contains an entry that cannot be extracted safely: " + name);
+    }
+
+    return host;
+}
+
+void planDirectory(
+    PackageFileSystem &fileSystem,
+    const std::string &path,
+    const std::filesystem::path &outputDirectory,
+    std::vector<ExtractionJob> &jobs)
+{
+    tc::io::sDirectoryListing listing;
+    fileSystem.ListDirectory(path, listing);
+
+    const auto base = path.empty() || path.back() == '/' ? path : path + "/";
+
+    for (const auto &name : listing.file_list)
+    {
+        const auto virtualPath = base + name;
+
+        jobs.push_back(
+            {virtualPath, outputDirectory / outputName(name), fileSystem.OpenFile(virtualPath)->length(),
+             fileSystem.DataOffset(virtualPath)});
+    }
+
+    for (const auto &name : listing.dir_list)
+    {
+        planDirectory(fileSystem, base + name, outputDirectory / outputName(name), jobs);
+    }
+}
+
+void planSelected(
+    PackageFileSystem &fileSystem,
+    const Selection &selection,
+    std::vector<std::string> &segments,
+    const std::filesystem::path &outputDirectory,
+    std::vector<ExtractionJob> &jobs,
+    std::set<std::string> &found)
+{
+    if (selection.IsRequested(segments))
+    {
+        found.insert(JoinVirtualPath(segments));
+    }
+
+    tc::io::sDirectoryListing listing;
+    fileSystem.ListDirectory(JoinVirtualPath(segments), listing);
+
+    for (const auto &name : listing.file_list)
+    {
+        segments.push_back(name);
+
+        if (selection.Matches(segments))
+        {
+            const auto virtualPath = JoinVirtualPath(segments);
+
+            jobs.push_back(
+                {virtualPath, outputDirectory / outputName(name), fileSystem.OpenFile(virtualPath)->length(),
+                 fileSystem.DataOffset(virtualPath)});
+            found.insert(virtualPath);
+        }
+        else if (Container::IsContainerName(name) && selection.MayContain(segments))
+        {
+            planSelected(fileSystem, selection, segments, outputDirectory / outputName(name), jobs, found);
+        }
+
+        segments.pop_back();
+    }
+
+    for (const auto &name : listing.dir_list)
+    {
+        segments.push_back(name);
+
+        if (selection.MayContain(segments))
+        {
+            planSelected(fileSystem, selection, segments, outputDirectory / outputName(name), jobs, found);
+        }
+
+        segments.pop_back();
+    }
+}
+
+// Orders jobs by where their data starts in the source. Jobs whose offset is unknown keep their order after the rest.
+void sortByOffset(std::vector<ExtractionJob> &jobs)
+{
+    std::stable_sort(
+        jobs.begin(), jobs.end(),
+        [](const ExtractionJob &a, const ExtractionJob &b)
+        { return a.offset && (!b.offset || *a.offset < *b.offset); });
+}
+
+// Adds the virtual paths of the RomFS sections of a content archive at path, "" for the source itself, when it holds
+// a program.
+void addProgramRomFs(
+    const std::optional<ContentArchiveLayout> &layout, const std::string &path, std::vector<std::string> &roots)
+{
+    if (!layout || layout->contentType != ContentArchiveProgram)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < layout->romFs.size(); ++i)
+    {
+        if (layout->romFs[i])
+        {
+            roots.push_back(path + "/" + std::to_string(i));
+        }
+    }
+}
+
+// Adds the RomFS sections of the program content archives found in a directory of the package, and in the
+// directories below it, without descending into the archives themselves.
+void findProgramRomFs(
+    PackageFileSystem &fileSystem, const std::string &path, const nstool::KeyBag &keys, std::vector<std::string> &roots)
+{
+    tc::io::sDirectoryListing listing;
+    fileSystem.ListDirectory(path, listing);
+
+    const auto base = path.back() == '/' ? path : path + "/";
+
+    for (const auto &name : listing.file_list)
+    {
+        if (FileTypeFromExtension(name) != nstool::Settings::FILE_TYPE_NCA)
+        {
+            continue;
+        }
+
+        addProgramRomFs(ReadContentArchiveLayout(*fileSystem.OpenFile(base + name), keys), base + name, roots);
+    }
+
+    for (const auto &name : listing.dir_list)
+    {
+        findProgramRomFs(fileSystem, base + name, keys, roots);
+    }
+}
+
+uint64_t writeStreamToFile(
+    tc::io::IStream &stream, const std::filesystem::path &destination, std::vector<byte_t> &buffer,
+    ProgressMeter &meter, const CancellationToken &cancellation)
+{
+    std::ofstream output(destination, std::ios::binary | std::ios::trunc);
+
+    if (!output)
+    {
+        throw std::runtime_error("Unable to create " + destination.string());
+    }
+
+    uint64_t total = 0;
+
+    for (;;)
+    {
+        cancellation.ThrowIfCancelled();
+
+        const auto count = stream.read(buffer.data(), buffer.size());
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        output.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(count));
+        total += count;
+        meter.Advance(count);
+    }
+
+    if (!output)
+    {
+        throw std::runtime_error("Unable to write " + destination.string());
+    }
+
+    return total;
+}
+
+// Copies one chunk of a file into its place in a destination that was already created at its full size. Seeking the
+// decrypted stream only recomputes the AES-CTR counter, so chunks of one file can be decrypted on separate threads.
+uint64_t writeChunkToFile(
+    tc::io::IStream &stream, const std::filesystem::path &destination, uint64_t offset, uint64_t length,
+    std::vector<byte_t> &buffer, ProgressMeter &meter, const CancellationToken &cancellation)
+{
+    std::fstream output(destination, std::ios::binary | std::ios::in | std::ios::out);
+
+    if (!output)
+    {
+        throw std::runtime_error("Unable to open " + destination.string());
+    }
+
+    output.seekp(static_cast<std::streamoff>(offset));
+
+    uint64_t total = 0;
+
+    while (total < length)
+    {
+        cancellation.ThrowIfCancelled();
+
+        const auto wanted = static_cast<size_t>(std::min<uint64_t>(buffer.size(), length - total));
+        const auto count = ReadAt(stream, static_cast<int64_t>(offset + total), buffer.data(), wanted);
+
+        // The chunk was planned from the length of the file, so a short read would leave zeros in the destination.
+        if (count != wanted)
+        {
+            throw std::runtime_error("Unexpected end of data while writing " + destination.string());
+        }
+
+        output.write(reinterpret_cast<const char *>(buffer.data()), static_cast<std::streamsize>(count));
+        total += count;
+        meter.Advance(count);
+    }
+
+    if (!output)
+    {
+        throw std::runtime_error("Unable to write " + destination.string());
+    }
+
+    return total;
+}
+
+// A whole file, or one chunk of a file larger than the chunk size.
+struct ExtractionUnit
+{
+    size_t job;
+    uint64_t offset;
+    uint64_t length;
+    bool chunked;
+};
+
+// Units keep the order of the jobs, and the chunks of a file are consecutive and in file order.
+std::vector<ExtractionUnit> planUnits(const std::vector<ExtractionJob> &jobs, uint64_t chunkSize)
+{
+    std::vector<ExtractionUnit> units;
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const auto size = static_cast<uint64_t>(std::max<int64_t>(jobs[i].size, 0));
+
+        if (chunkSize == 0 || size <= chunkSize)
+        {
+            units.push_back({i, 0, size, false});
+            continue;
+        }
+
+        for (uint64_t offset = 0; offset < size; offset += chunkSize)
+        {
+            units.push_back({i, offset, std::min(chunkSize, size - offset), true});
+        }
+    }
+
+    return units;
+}
+
+// Removes what a failed or cancelled extraction left behind: every file it started and the directories it created,
+// deepest first, as far as they are empty.
+void removePartialOutput(
+    const std::set<std::filesystem::path> &files, const std::set<std::filesystem::path> &createdDirectories)
+{
+    std::error_code error;
+
+    for (const auto &file : files)
+    {
+        std::filesystem::remove(file, error);
+    }
+
+    for (auto directory = createdDirectories.rbegin(); directory != createdDirectories.rend(); ++directory)
+    {
+        std::filesystem::remove(*directory, error);
+    }
+}
+
+} // namespace
+
+std::vector<ExtractionJob> PlanExtraction(
+    PackageFileSystem &fileSystem, const std::string &path, const std::filesystem::path &outputDirectory)
+{
+    std::vector<ExtractionJob> jobs;
+    std::shared_ptr<tc::io::IStream> stream;
+    const auto parts = SplitVirtualPath(path);
+
+    // The root has no name to write a file under, and is always a directory.
+    if (!parts.empty())
+    {
+        try
+        {
+            stream = fileSystem.OpenFile(path);
+        }
+        catch (const tc::io::IOException &)
+        {
+            // Not a file, so plan it as a directory below.
+        }
+    }
+
+    if (stream)
+    {
+        jobs.push_back(
+            {path, outputDirectory / outputName(parts.back()), stream->length(), fileSystem.DataOffset(path)});
+
+        return jobs;
+    }
+
+    planDirectory(fileSystem, path, outputDirectory, jobs);
+    sortByOffset(jobs);
+
+    return jobs;
+}
+
+std::vector<ExtractionJob> PlanSelection(
+    PackageFileSystem &fileSystem, const Selection &selection, const std::filesystem::path &outputDirectory)
+{
+    std::vector<ExtractionJob> jobs;
+    std::vector<std::string> segments;
+    std::set<std::string> found;
+
+    planSelected(fileSystem, selection, segments, outputDirectory, jobs, found);
+
+    for (const auto &path : selection.Requested())
+    {
+        if (found.count(path) == 0)
+        {
+            throw std::runtime_error("The package does not contain " + path);
+        }
+    }
+
+    sortByOffset(jobs);
+
+    return jobs;
+}
+
+std::vector<std::string> ExpandRomFsPatterns(PackageFileSystem &fileSystem, const std::vector<std::string> &patterns)
+{
+    std::vector<std::string> expanded;
+    std::optional<std::vector<std::string>> roots;
+
+    for (const auto &pattern : patterns)
+    {
+        if (pattern.compare(0, romFsPrefix.size(), romFsPrefix) != 0)
+        {
+            expanded.push_back(pattern);
+            continue;
+        }
+
+        if (!roots)
+        {
+            const auto &container = *fileSystem.GetContainer();
+            roots.emplace();
+
+            // A content archive opened on its own has its sections at the root.
+            if (container.Type() == nstool::Settings::FILE_TYPE_NCA)
+            {
+                addProgramRomFs(ReadContentArchiveLayout(*container.OpenSource(), container.Keys()), "", *roots);
+            }
+            else
+            {
+                findProgramRomFs(fileSystem, "/", container.Keys(), *roots);
+            }
+        }
+
+        const auto rest = pattern.substr(romFsPrefix.size());
+
+        for (const auto &root : *roots)
+        {
+            expanded.push_back(root + "/" + (rest.empty() ? "**" : rest));
+        }
+    }
+
+    return expanded;
+}
+
+ExtractionReport RunExtraction(
+    const std::shared_ptr<const Container> &container,
+    std::vector<ExtractionJob> jobs,
+    unsigned concurrency,
+    uint64_t chunkSize,
+    const ExtractionControl &control)
+{
+    const auto started = std::chrono::steady_clock::now();
+
+    // With several threads, starting with the largest files keeps one big file from finishing alone at the end.
+    if (concurrency > 1)
+    {
+        std::stable_sort(
+            jobs.begin(), jobs.end(), [](const ExtractionJob &a, const ExtractionJob &b) { return a.size > b.size; });
+    }
+
+    // Chunks only help when there are threads to spread a file across.
+    const auto units = planUnits(jobs, concurrency > 1 ? chunkSize : 0);
+
+    ExtractionReport report;
+    report.concurrency = std::clamp<unsigned>(concurrency, 1, std::max<unsigned>(1, units.size()));
+    report.chunkSize = concurrency > 1 ? chunkSize : 0;
+    report.trusted = container->Trusted();
+
+    std::set<std::filesystem::path> directories;
+
+    for (const auto &job : jobs)
+    {
+        directories.insert(job.destination.parent_path());
+    }
+
+    std::set<std::filesystem::path> createdDirectories;
+
+    for (const auto &directory : directories)
+    {
+        for (auto missing = directory; !missing.empty() && !std::filesystem::exists(missing);
+             missing = missing.parent_path())
+        {
+            createdDirectories.insert(missing);
+        }
+
+        std::filesystem::create_directories(directory);
+    }
+
+    uint64_t bytesTotal = 0;
+    // The number of units still to finish per file, to tell when a file is done.
+    std::vector<std::atomic<size_t>> remaining(jobs.size());
+    std::set<std::filesystem::path> preallocated;
+
+    for (const auto &unit : units)
+    {
+        ++remaining[unit.job];
+    }
+
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        const auto size = static_cast<uint64_t>(std::max<int64_t>(jobs[i].size, 0));
+        bytesTotal += size;
+
+        // Chunked files are created at their full size up front, so every chunk can be written in place.
+        if (remaining[i] > 1)
+        {
+            std::ofstream(jobs[i].destination, std::ios::binary | std::ios::trunc);
+            preallocated.insert(jobs[i].destination);
+            std::filesystem::resize_file(jobs[i].destination, size);
+        }
+    }
+
+    ProgressMeter meter(bytesTotal, jobs.size(), control.onProgress);
+    const auto cancellation = control.cancellation ? control.cancellation : std::make_shared<CancellationToken>();
+
+    std::atomic<size_t> next = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::atomic<bool> failed = false;
+
+    try
+    {
+        // One task per thread, each mounting its own filesystem and pulling units until none are left.
+        ParallelFor(
+            report.concurrency, report.concurrency,
+            [&](size_t)
+            {
+                PackageFileSystem fileSystem(container);
+                std::vector<byte_t> buffer(copyBufferSize);
+
+                try
+                {
+                    for (auto index = next++; !failed && index < units.size(); index = next++)
+                    {
+                        const auto &unit = units[index];
+                        const auto &job = jobs[unit.job];
+
+                        if (unit.offset == 0)
+                        {
+                            meter.FileStarted(job.virtualPath);
+                        }
+
+                        const auto stream = fileSystem.OpenFile(job.virtualPath);
+
+                        if (unit.chunked)
+                        {
+                            bytes += writeChunkToFile(
+                                *stream, job.destination, unit.offset, unit.length, buffer, meter, *cancellation);
+                        }
+                        else
+                        {
+                            bytes += writeStreamToFile(*stream, job.destination, buffer, meter, *cancellation);
+                        }
+
+                        if (--remaining[unit.job] == 0)
+                        {
+                            meter.FileDone();
+                        }
+                    }
+                }
+                catch (...)
+                {
+                    // Stops the other threads at their next unit.
+                    failed = true;
+                    throw;
+                }
+            });
+    }
+    catch (...)
+    {
+        auto partial = preallocated;
+
+        for (size_t i = 0; i < std::min<size_t>(next, units.size()); ++i)
+        {
+            partial.insert(jobs[units[i].job].destination);
+        }
+
+        removePartialOutput(partial, createdDirectories);
+
+        throw;
+    }
+
+    meter.Finish();
+
+    for (const auto &job : jobs)
+    {
+        report.written.push_back(job.destination);
+    }
+
+    report.bytes = bytes;
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    return report;
+}
+
+std::filesystem::path ToHostPath(const std::string &utf8)
+{
+    return std::filesystem::path(std::u8string(utf8.begin(), utf8.end()));
+}
+
+std::string FromHostPath(const std::filesystem::path &path)
+{
+    const auto utf8 = path.u8string();
+
+    return std::string(utf8.begin(), utf8.end());
+}
@@ -0,0 +1,282 @@
+#include "file-type.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <mbedtls/aes.h>
+
+namespace
+{
+
+constexpr size_t sniffSize = 0x1200;
+constexpr size_t ncaHeaderSize = 0xC00;
+// NCA headers are encrypted in 0x200 byte XTS sectors; the magic opens the second one.
+constexpr size_t ncaSectorSize = 0x200;
+constexpr size_t gameCardHeaderOffset = 0x100;
+constexpr size_t gameCardKeyAreaSize = 0x1000;
+constexpr uint64_t romFsHeaderSize = 0x50;
+// The section table follows the magic and the fixed fields in the second sector: one 0x10 byte entry per section,
+// starting with its first and end media blocks of 0x200 bytes.
+constexpr size_t ncaSectionTableOffset = 0x40;
+constexpr size_t ncaSectionEntrySize = 0x10;
+constexpr size_t ncaMediaBlockSize = 0x200;
+// The content type byte follows the magic and the distribution type.
+constexpr size_t ncaContentTypeOffset = 0x5;
+// Each section header, in the sector after the main one for the section before, starts with a version and the format
+// of the section.
+constexpr size_t ncaFormatTypeOffset = 0x2;
+constexpr byte_t ncaFormatTypeRomFs = 0;
+
+std::string lowercase(std::string value)
+{
+    std::transform(
+        value.begin(), value.end(), value.begin(),
+        [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+
+    return value;
+}
+
+bool hasMagic(const std::array<byte_t, sniffSize> &header, size_t size, size_t offset, const char *magic)
+{
+    return size >= offset + 4 && std::memcmp(header.data() + offset, magic, 4) == 0;
+}
+
+// Decrypts one 0x200 byte sector of an NCA header with the header key. Returns false when the header is too short or
+// the key is missing.
+bool decryptHeaderSector(
+    const byte_t *header, size_t size, size_t index, const nstool::KeyBag &keys,
+    std::array<byte_t, ncaSectorSize> &sector)
+{
+#if defined(MBEDTLS_CIPHER_MODE_XTS)
+    if (size < (index + 1) * ncaSectorSize || keys.nca_header_key.isNull())
+    {
+        return false;
+    }
+
+    const auto &headerKey = keys.nca_header_key.get();
+    std::array<unsigned char, 32> key = {};
+    static_assert(sizeof(headerKey) == key.size(), "The NCA header key is a pair of AES-128 keys.");
+    std::memcpy(key.data(), &headerKey, key.size());
+
+    // Nintendo stores the sector number big-endian in the tweak.
+    std::array<unsigned char, 16> tweak = {};
+    tweak[15] = static_cast<unsigned char>(index);
+
+    mbedtls_aes_xts_context context;
+
+    mbedtls_aes_xts_init(&context);
+    mbedtls_aes_xts_setkey_dec(&context, key.data(), 256);
+    mbedtls_aes_crypt_xts(
+        &context, MBEDTLS_AES_DECRYPT, sector.size(), tweak.data(), header + index * ncaSectorSize, sector.data());
+    mbedtls_aes_xts_free(&context);
+
+    return true;
+#else
+    static_cast<void>(header);
+    static_cast<void>(size);
+    static_cast<void>(index);
+    static_cast<void>(keys);
+    static_cast<void>(sector);
+
+    return false;
+#endif
+}
+
+// Decrypts the sector of an NCA header that holds the magic, the content type and the section table, and checks for
+// NCA3 or NCA2.
+bool decryptMainSector(
+    const byte_t *header, size_t size, const nstool::KeyBag &keys, std::array<byte_t, ncaSectorSize> &sector)
+{
+    return decryptHeaderSector(header, size, 1, keys, sector) &&
+           (std::memcmp(sector.data(), "NCA3", 4) == 0 || std::memcmp(sector.data(), "NCA2", 4) == 0);
+}
+
+bool isContentArchive(const std::array<byte_t, sniffSize> &header, size_t size, const nstool::KeyBag &keys)
+{
+    std::array<byte_t, ncaSectorSize> sector = {};
+
+    return size >= ncaHeaderSize && decryptMainSector(header.data(), size, keys, sector);
+}
+
+uint32_t readLittleEndian32(const byte_t *data)
+{
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+           static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+} // namespace
+
+nstool::Settings::FileType FileTypeFromName(const std::string &type)
+{
+    const auto name = lowercase(type);
+
+    if (name == "gc" || name == "gamecard" || name == "xci")
+    {
+        return nstool::Settings::FILE_TYPE_GAMECARD;
+    }
+
+    if (name == "nsp")
+    {
+        return nstool::Settings::FILE_TYPE_NSP;
+    }
+
+    if (name == "partitionfs" || name == "hashedpartitionfs" || name == "pfs" || name == "pfs0" || name == "hfs" ||
+        name == "hfs0")
+    {
+        return nstool::Settings::FILE_TYPE_PARTITIONFS;
+    }
+
+    if (name == "romfs")
+    {
+        return nstool::Settings::FILE_TYPE_ROMFS;
+    }
+
+    if (name == "nca" || name == "contentarchive")
+    {
+        return nstool::Settings::FILE_TYPE_NCA;
+    }
+
+    return nstool::Settings::FILE_TYPE_ERROR;
+}
+
+std::string FileTypeName(nstool::Settings::FileType type)
+{
+    switch (type)
+    {
+    case nstool::Settings::FILE_TYPE_GAMECARD:
+        return "gc";
+    case nstool::Settings::FILE_TYPE_NSP:
+        return "nsp";
+    case nstool::Settings::FILE_TYPE_PARTITIONFS:
+        return "pfs";
+    case nstool::Settings::FILE_TYPE_ROMFS:
+        return "romfs";
+    case nstool::Settings::FILE_TYPE_NCA:
+        return "nca";
+    default:
+        return "";
+    }
+}
+
+nstool::Settings::FileType FileTypeFromExtension(const std::string &name)
+{
+    const auto dot = name.find_last_of('.');
+
+    if (dot == std::string::npos)
+    {
+        return nstool::Settings::FILE_TYPE_ERROR;
+    }
+
+    const auto extension = lowercase(name.substr(dot + 1));
+
+    if (extension == "nca")
+    {
+        return nstool::Settings::FILE_TYPE_NCA;
+    }
+
+    if (extension == "nsp" || extension == "pfs0")
+    {
+        return nstool::Settings::FILE_TYPE_PARTITIONFS;
+    }
+
+    if (extension == "xci")
+    {
+        return nstool::Settings::FILE_TYPE_GAMECARD;
+    }
+
+    if (extension == "romfs")
+    {
+        return nstool::Settings::FILE_TYPE_ROMFS;
+    }
+
+    return nstool::Settings::FILE_TYPE_ERROR;
+}
+
+nstool::Settings::FileType SniffFileType(tc::io::IStream &stream, const nstool::KeyBag &keys)
+{
+    std::array<byte_t, sniffSize> header = {};
+
+    stream.seek(0, tc::io::SeekOrigin::Begin);
+    const auto size = stream.read(header.data(), header.size());
+    stream.seek(0, tc::io::SeekOrigin::Begin);
+
+    if (hasMagic(header, size, 0, "PFS0") || hasMagic(header, size, 0, "HFS0"))
+    {
+        return nstool::Settings::FILE_TYPE_PARTITIONFS;
+    }
+
+    // Game card images may or may not start with the key area.
+    if (hasMagic(header, size, gameCardHeaderOffset, "HEAD") ||
+        hasMagic(header, size, gameCardKeyAreaSize + gameCardHeaderOffset, "HEAD"))
+    {
+        return nstool::Settings::FILE_TYPE_GAMECARD;
+    }
+
+    uint64_t romFsSize = 0;
+
+    if (size >= sizeof(romFsSize))
+    {
+        std::memcpy(&romFsSize, header.data(), sizeof(romFsSize));
+    }
+
+    if (romFsSize == romFsHeaderSize)
+    {
+        return nstool::Settings::FILE_TYPE_ROMFS;
+    }
+
+    if (isContentArchive(header, size, keys))
+    {
+        return nstool::Settings::FILE_TYPE_NCA;
+    }
+
+    return nstool::Settings::FILE_TYPE_ERROR;
+}
+
+std::optional<ContentArchiveLayout> ReadContentArchiveLayout(tc::io::IStream &stream, const nstool::KeyBag &keys)
+{
+    std::array<byte_t, ncaHeaderSize> header = {};
+    const auto position = stream.position();
+
+    stream.seek(0, tc::io::SeekOrigin::Begin);
+    const auto size = stream.read(header.data(), header.size());
+    stream.seek(position, tc::io::SeekOrigin::Begin);
+
+    std::array<byte_t, ncaSectorSize> sector = {};
+
+    if (!decryptMainSector(header.data(), size, keys, sector))
+    {
+        return std::nullopt;
+    }
+
+    ContentArchiveLayout layout;
+    layout.contentType = sector[ncaContentTypeOffset];
+    layout.sections.assign(ContentArchiveSectionCount, 0);
+    layout.romFs.assign(ContentArchiveSectionCount, false);
+
+    // NCA2 encrypts the section headers differently; their sections are only located.
+    const auto sectionHeaders = std::memcmp(sector.data(), "NCA3", 4) == 0;
+
+    for (size_t i = 0; i < ContentArchiveSectionCount; ++i)
+    {
+        const auto *entry = sector.data() + ncaSectionTableOffset + i * ncaSectionEntrySize;
+        const auto start = readLittleEndian32(entry);
+        const auto end = readLittleEndian32(entry + 4);
+
+        if (end <= start)
+        {
+            continue;
+        }
+
+        layout.sections[i] = static_cast<int64_t>(start) * ncaMediaBlockSize;
+
+        std::array<byte_t, ncaSectorSize> sectionHeader = {};
+
+        if (sectionHeaders && decryptHeaderSector(header.data(), size, 2 + i, keys, sectionHeader))
+        {
+            layout.romFs[i] = sectionHeader[ncaFormatTypeOffset] == ncaFormatTypeRomFs;
+        }
+    }
+
+    return layout;
+}
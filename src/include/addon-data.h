@@ -0,0 +1,13 @@
+#pragma once
+
+#include <napi.h>
+
+// State the addon keeps for each environment that loads it, the main thread and every worker thread alike. Stored
+// with Napi::Env::SetInstanceData and freed with the environment, so references never cross environments.
+struct AddonData
+{
+    // The Cancellation class, to recognise its instances.
+    Napi::FunctionReference cancellation;
+    // The Package class, to construct the packages openAsync() resolves with.
+    Napi::FunctionReference package;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "cancellation.h"
+#include <functional>
+#include <memory>
+#include <napi.h>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+// The outcome of one nstool invocation in a batch: either its parsed document or the message it failed with.
+struct BatchResult
+{
+    std::optional<nlohmann::ordered_json> document;
+    std::string error;
+};
+
+// Runs every invocation on up to `concurrency` threads and hands each result to `emit`, with the index of its
+// invocation, from the thread that produced it as soon as it is done. A failing invocation is recorded in its own
+// result and never stops the others. Cancelling the token stops the batch with OperationCancelled, including the
+// invocations in progress at their next read.
+void RunBatch(
+    const std::vector<std::vector<std::string>> &invocations,
+    unsigned concurrency,
+    const std::shared_ptr<CancellationToken> &cancellation,
+    const std::function<void(size_t index, BatchResult &&result)> &emit);
+
+// informationBatch(invocations, concurrency, onResult, cancellation): takes an array of argument arrays, as passed to
+// run(), and calls onResult(index, result) as each invocation completes, where result is either { data, events } or
+// { error: true, errorMessage }. Returns a promise that resolves once every result has been delivered.
+Napi::Value InformationBatch(const Napi::CallbackInfo &info);
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "KeyBag.h"
+#include "metadata-index.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <string>
+#include <tc/io.h>
+#include <unordered_map>
+#include <vector>
+
+// Where a block came from: the identity of the source file, the fingerprint of the keys it was decrypted with, the
+// section it belongs to, and the index of the block within that section. A section is named by the virtual path of
+// its content archive inside the package and its number, as in "/secure/0123.nca#1".
+struct BlockKey
+{
+    FileIdentity source;
+    uint64_t keys = 0;
+    std::string section;
+    uint64_t block = 0;
+
+    bool operator==(const BlockKey &) const = default;
+};
+
+struct BlockKeyHash
+{
+    size_t operator()(const BlockKey &key) const;
+};
+
+struct BlockCacheStatistics
+{
+    uint64_t capacity = 0;
+    uint64_t bytes = 0;
+    uint64_t blocks = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
+// Decrypted section blocks shared by every package the addon opens, so reading the same title again, from the same or
+// another package, skips the decryption. Bounded by a capacity in bytes and evicted least recently used first. Keys
+// carry the identity of the source and the fingerprint of the keys, so a source that changes on disk, or is opened
+// with other keys, is never served stale blocks. Disabled, and empty, until a capacity is set.
+class BlockCache
+{
+public:
+    static constexpr size_t BlockSize = 64 * 1024;
+
+    using Block = std::vector<byte_t>;
+
+    static BlockCache &Instance();
+
+    // Sets the capacity in bytes, evicting blocks until the cache fits. Zero disables the cache and drops every block.
+    void Resize(uint64_t capacity);
+
+    bool Enabled() const;
+
+    // Returns the block, or nullptr after counting a miss. Returns nullptr without counting anything while the cache
+    // is disabled.
+    std::shared_ptr<const Block> Find(const BlockKey &key);
+
+    void Insert(const BlockKey &key, std::shared_ptr<const Block> block);
+
+    // Drops every block and resets the counters.
+    void Clear();
+
+    BlockCacheStatistics Statistics() const;
+
+private:
+    struct Entry
+    {
+        BlockKey key;
+        std::shared_ptr<const Block> block;
+    };
+
+    void evict();
+
+    mutable std::mutex mutex;
+    uint64_t capacity = 0;
+    BlockCacheStatistics statistics;
+    // Most recently used first.
+    std::list<Entry> entries;
+    std::unordered_map<BlockKey, std::list<Entry>::iterator, BlockKeyHash> index;
+};
+
+// A read-only stream over a decrypted section that reads whole blocks through the block cache, keyed by key with its
+// block index filled in. Blocks missing from the cache are read from the inner stream and inserted.
+class CachedStream : public tc::io::IStream
+{
+public:
+    CachedStream(std::shared_ptr<tc::io::IStream> inner, BlockKey key);
+
+    bool canRead() const override;
+    bool canWrite() const override;
+    bool canSeek() const override;
+    int64_t length() override;
+    int64_t position() override;
+    size_t read(byte_t *ptr, size_t count) override;
+    size_t write(const byte_t *ptr, size_t count) override;
+    int64_t seek(int64_t offset, tc::io::SeekOrigin origin) override;
+    void setLength(int64_t length) override;
+    void flush() override;
+    void dispose() override;
+
+private:
+    std::shared_ptr<const BlockCache::Block> block(uint64_t index);
+
+    std::shared_ptr<tc::io::IStream> inner;
+    BlockKey key;
+    int64_t size = 0;
+    int64_t offset = 0;
+};
+
+// The content archive whose sections are mounted on the calling thread: the identity of the source, the fingerprint
+// of the keys and the virtual path of the archive inside the package, "/" for the source itself. Sections are named by
+// their number in the header of the archive, so a section keeps its blocks however many of the others mount. The
+// section table is read from the header, with keyBag, when the first section is mounted.
+struct BlockSource
+{
+    FileIdentity source;
+    uint64_t keys = 0;
+    std::string path;
+    const nstool::KeyBag *keyBag = nullptr;
+    // The offset of each section within the archive, indexed by its number; see ContentArchiveLayout.
+    std::vector<int64_t> sections;
+    // The offset of the section being mounted, or -1.
+    int64_t mounting = -1;
+};
+
+// Binds a block source, or none, to the calling thread for the lifetime of the scope. PackageFileSystem binds one
+// around every mount of a cached filesystem; nstool's NcaProcess.cpp is compiled through src/nstool-nca-process.cpp,
+// which reads the sections it mounts through CacheSection(), so the tables, hash levels and files of a RomFS or
+// partition filesystem are all read through the cache.
+class ScopedBlockSource
+{
+public:
+    explicit ScopedBlockSource(BlockSource *source);
+    ~ScopedBlockSource();
+
+    ScopedBlockSource(const ScopedBlockSource &) = delete;
+    ScopedBlockSource &operator=(const ScopedBlockSource &) = delete;
+
+private:
+    BlockSource *previous;
+};
+
+// Tells the block source bound to the calling thread, if any, that the section at offset of the archive is being
+// mounted. nstool's NcaProcess.cpp calls it through src/nstool-nca-process.cpp as it opens each section of the
+// archive, before decrypting it.
+void MountingSection(tc::io::IStream &archive, int64_t offset);
+
+// Reads a decrypted section through the block cache, as the section of the block source bound to the calling thread
+// that is being mounted. Returns the section itself when no source is bound, the cache is disabled or the section is
+// not one the header of the archive lists.
+std::shared_ptr<tc::io::IStream> CacheSection(const std::shared_ptr<tc::io::IStream> &section);
+
+// configureBlockCache(megabytes): sets the capacity of the block cache. Zero disables it.
+Napi::Value ConfigureBlockCache(const Napi::CallbackInfo &info);
+
+// clearBlockCache(): drops every cached block and resets the counters.
+Napi::Value ClearBlockCache(const Napi::CallbackInfo &info);
+
+// blockCacheStats(): returns { capacity, bytes, blocks, hits, misses, evictions }.
+Napi::Value BlockCacheStats(const Napi::CallbackInfo &info);
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <napi.h>
+#include <stdexcept>
+
+// Thrown from a loop that noticed its token was cancelled.
+class OperationCancelled : public std::runtime_error
+{
+public:
+    OperationCancelled() : std::runtime_error("The operation was aborted.")
+    {
+    }
+};
+
+// A flag that JavaScript sets and worker threads poll between units of work: a chunk copied, a file parsed.
+class CancellationToken
+{
+public:
+    void Cancel();
+    bool IsCancelled() const;
+
+    // Throws OperationCancelled once the token has been cancelled.
+    void ThrowIfCancelled() const;
+
+private:
+    std::atomic<bool> cancelled = false;
+};
+
+// The JavaScript handle of a token. The wrapper connects it to an AbortSignal and passes it to the calls it should
+// be able to stop. Define() keeps the class in the AddonData of the environment.
+class Cancellation : public Napi::ObjectWrap<Cancellation>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    explicit Cancellation(const Napi::CallbackInfo &info);
+
+    // Returns the token of a Cancellation object, or a token that is never cancelled for any other value.
+    static std::shared_ptr<CancellationToken> TokenFrom(const Napi::Value &value);
+
+private:
+    Napi::Value Cancel(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<CancellationToken> token;
+};
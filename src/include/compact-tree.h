@@ -0,0 +1,30 @@
+#pragma once
+
+#include "package-fs.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A package tree flattened into parallel arrays. Entries are in breadth-first order with the root at index 0, so the
+// children of every entry are contiguous and come after it. Names are stored back to back in one UTF-8 string table.
+struct CompactTree
+{
+    // Set in flags for entries that are directories.
+    static constexpr uint8_t directoryFlag = 1;
+    // Set in flags for files holding a nested container.
+    static constexpr uint8_t containerFlag = 2;
+
+    std::vector<int32_t> parent;
+    std::vector<uint32_t> nameOffset;
+    std::vector<uint32_t> nameLength;
+    std::vector<double> size;
+    // Where the data of each file starts in the source, see PackageFileSystem::DataOffset(). -1 for directories and
+    // for files whose offset is unknown, such as empty ones.
+    std::vector<double> dataOffset;
+    std::vector<uint8_t> flags;
+    std::string names;
+};
+
+// Flattens the tree below the root of the package. With `nested`, the contents of nested containers are listed below
+// their container file as well.
+CompactTree BuildCompactTree(PackageFileSystem &fileSystem, bool nested);
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Settings.h"
+#include "mapped-file-stream.h"
+#include <memory>
+#include <string>
+#include <tc/io.h>
+#include <vector>
+
+// Where a container reads its source from.
+enum class InputBackend
+{
+    // Buffered reads through tc::io::FileStream.
+    Stream,
+    // A shared read-only memory mapping of the whole file.
+    Mapped,
+};
+
+// Addon options for a container that are not nstool arguments.
+struct ContainerOptions
+{
+    InputBackend input = InputBackend::Stream;
+    AccessPattern access = AccessPattern::Normal;
+    // The parts of a split dump, in order. When empty the source is taken from the arguments, together with its
+    // sibling parts when it names one part of a split dump.
+    std::vector<std::string> parts;
+    // The source is known to be intact, for example because verify() checked it before. The sections of its content
+    // archives are read straight from their data layer, without the hierarchical SHA-256 or IVFC hash layers, and
+    // nstool is never asked to verify while mounting, even when the arguments include --verify.
+    bool trusted = false;
+};
+
+// A package that nstool can present as a virtual filesystem. The settings (input type and key material) are
+// resolved once when the container is opened; every mount then builds its own stream stack over the source, so
+// separate mounts can be read from different threads at the same time.
+class Container
+{
+public:
+    // Accepts the same arguments as umain. The input type comes from --type or the magic bytes of the source and the
+    // keys from the process-wide key cache. Throws when the source cannot be opened.
+    static std::shared_ptr<Container> Open(const std::vector<std::string> &args, const ContainerOptions &options = {});
+
+    // Parses the container headers and returns its filesystem. Throws when the source has no filesystem.
+    std::shared_ptr<tc::io::IFileSystem> Mount() const;
+
+    // Mounts a file found inside another container, such as an NCA inside an NSP. The type is taken from the
+    // file name. Throws when the name does not describe a container.
+    std::shared_ptr<tc::io::IFileSystem> MountNested(
+        const std::shared_ptr<tc::io::IStream> &stream, const std::string &name) const;
+
+    // Whether MountNested can mount a file with this name.
+    static bool IsContainerName(const std::string &name);
+
+    const tc::io::Path &Source() const;
+
+    // The input type, from --type or the magic bytes of the source.
+    nstool::Settings::FileType Type() const;
+
+    // Opens a new stream over the raw source through the selected input backend. The parts of a split dump are read
+    // as one stream.
+    std::shared_ptr<tc::io::IStream> OpenSource() const;
+
+    // The files the source is read from: the source itself, or the parts of a split dump.
+    const std::vector<std::string> &Parts() const;
+
+    // Whether the source is split into parts, which nstool cannot open on its own.
+    bool Split() const;
+
+    // Tells the keys the container was opened with apart from other keys, see KeyCache::Fingerprint.
+    uint64_t KeyFingerprint() const;
+
+    // The key material the container was opened with.
+    const nstool::KeyBag &Keys() const;
+
+    // Whether the container was opened with ContainerOptions::trusted.
+    bool Trusted() const;
+
+private:
+    Container(
+        nstool::Settings settings, uint64_t keyFingerprint, std::string sourcePath, std::vector<std::string> parts,
+        std::vector<std::shared_ptr<const FileMapping>> mappings);
+
+    std::shared_ptr<tc::io::IFileSystem> mountStream(
+        const std::shared_ptr<tc::io::IStream> &stream, nstool::Settings::FileType type) const;
+
+    nstool::Settings settings;
+    uint64_t keyFingerprint;
+    std::string sourcePath;
+    std::vector<std::string> parts;
+    // One mapping per part with the mapped input backend.
+    std::vector<std::shared_ptr<const FileMapping>> mappings;
+    bool trusted = false;
+};
+
+// Whether the content archive sections mounted on the calling thread belong to a trusted container: one Container is
+// mounting, or the nstool run bound to the thread reads through one. nstool's NcaProcess.cpp is compiled through
+// src/nstool-nca-process.cpp, which then opens each section on its data layer instead of through its hash layers.
+bool MountingTrusted();
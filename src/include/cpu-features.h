@@ -0,0 +1,14 @@
+#pragma once
+
+// Instruction set extensions of the CPU the addon is running on, detected once at runtime.
+struct CpuFeatures
+{
+    // AES-NI on x86, the AES instructions of the ARMv8 Crypto Extension on AArch64.
+    bool aes = false;
+    // PCLMULQDQ on x86, PMULL on AArch64.
+    bool carrylessMultiply = false;
+    // The SHA extensions on x86 (together with the SSE4.1 they are used with), the SHA2 instructions on AArch64.
+    bool sha2 = false;
+};
+
+const CpuFeatures &DetectCpuFeatures();
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <napi.h>
+
+// cryptoBackend() returns { aes, sha256, cpu: { aes, carrylessMultiply, sha2 } }. aes names the implementation the
+// linked mbedtls uses for NCA decryption on this machine, as mbedtls itself reports it: 'aes-ni', 'armv8' or
+// 'software'. sha256 names the block function the addon hashes with: 'sha-ni', 'armv8' or 'software'.
+Napi::Value CryptoBackend(const Napi::CallbackInfo &info);
+
+// cipherBenchmark(mode, bytes, threads) decrypts `bytes` of zeroes with AES-128-CTR ('ctr') or AES-128-XTS in NCA
+// sized sectors ('xts') on each of `threads` threads and returns { mode, threads, bytes, seconds }. It blocks the
+// calling thread and is only meant for bench/crypto.js.
+Napi::Value CipherBenchmark(const Napi::CallbackInfo &info);
+
+// hashBenchmark(bytes, threads, backend) hashes `bytes` of zeroes with SHA-256 on each of `threads` threads and returns
+// { backend, threads, bytes, seconds, digest }. backend is 'software' or, by default, the fastest one available.
+// Like cipherBenchmark() it blocks the calling thread.
+Napi::Value HashBenchmark(const Napi::CallbackInfo &info);
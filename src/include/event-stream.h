@@ -0,0 +1,68 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <mutex>
+#include <napi.h>
+#include <nlohmann/json.hpp>
+
+// What a full event queue does with a new event.
+enum class EventPolicy
+{
+    // Wait for room, which in turn holds up nstool.
+    Block,
+    // Discard the new event.
+    Drop,
+    // Replace the newest queued event, so the consumer always sees the latest one.
+    Coalesce,
+};
+
+struct EventCounts
+{
+    uint64_t delivered = 0;
+    uint64_t dropped = 0;
+    uint64_t coalesced = 0;
+};
+
+// A bounded queue of events between the thread parsing nstool's output and JavaScript.
+class EventQueue
+{
+public:
+    EventQueue(size_t capacity, EventPolicy policy);
+
+    // Queues an event according to the policy. Returns true when the consumer has to be woken up to drain the queue,
+    // which is the case for the first event queued after a drain.
+    bool Push(nlohmann::ordered_json &&event);
+
+    // Takes every queued event and lets blocked producers continue.
+    std::deque<nlohmann::ordered_json> Drain();
+
+    // Stops waiting for a consumer that will not come back. Queued and further events are dropped.
+    void Close();
+
+    EventCounts Counts();
+
+private:
+    const size_t capacity;
+    const EventPolicy policy;
+    std::mutex mutex;
+    std::condition_variable drained;
+    std::deque<nlohmann::ordered_json> events;
+    EventCounts counts;
+    bool wakePending = false;
+    bool closed = false;
+};
+
+// Parses nstool's JSON output and hands every element of its top-level "events" array to `onEvent` as soon as it has
+// been read. The returned document keeps an empty "events" array, so its size does not grow with the event log.
+nlohmann::ordered_json ParseWithEventStream(
+    std::istream &input, const std::function<void(nlohmann::ordered_json &&event)> &onEvent);
+
+// runStreamingAsync(args, onEvent, queueSize, policy, cancellation) runs nstool on the libuv threadpool like
+// runObjectAsync(), but calls onEvent with each event while nstool is still running. The promise resolves with
+// { data, events: [], eventCounts: { delivered, dropped, coalesced } } after the last event has been delivered, and
+// rejects with OperationCancelled's message once a cancelled run has stopped.
+Napi::Value RunStreamingAsync(const Napi::CallbackInfo &info);
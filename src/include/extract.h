@@ -0,0 +1,84 @@
+#pragma once
+
+#include "cancellation.h"
+#include "container.h"
+#include "package-fs.h"
+#include "progress.h"
+#include "selection.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tc/io.h>
+#include <vector>
+
+// Files larger than this are split across threads unless the caller picks another chunk size.
+constexpr uint64_t DefaultExtractionChunkSize = 64 * 1024 * 1024;
+
+// One file to copy out of a package.
+struct ExtractionJob
+{
+    std::string virtualPath;
+    std::filesystem::path destination;
+    int64_t size;
+    // Where the data of the file starts in the source, see PackageFileSystem::DataOffset().
+    std::optional<int64_t> offset;
+};
+
+struct ExtractionReport
+{
+    std::vector<std::filesystem::path> written;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    unsigned concurrency = 1;
+    uint64_t chunkSize = 0;
+    // Copied from the container, so results show whether the hash layers were read.
+    bool trusted = false;
+};
+
+// Optional hooks into a running extraction.
+struct ExtractionControl
+{
+    ProgressCallback onProgress;
+    std::shared_ptr<CancellationToken> cancellation;
+};
+
+// Resolves a file, or a directory and everything below it, into extraction jobs. A file is written under its own
+// name; the contents of a directory are written directly into the output directory. Jobs are ordered by where their
+// data starts in the source, so a single thread reads it front to back; files whose offset is unknown, such as empty
+// ones, come last in listing order.
+std::vector<ExtractionJob> PlanExtraction(
+    PackageFileSystem &fileSystem, const std::string &path, const std::filesystem::path &outputDirectory);
+
+// Resolves every selected file into extraction jobs in a single walk, descending only into directories and nested
+// containers that can hold a selected file. Files keep their virtual path below the output directory. Jobs are
+// ordered by where their data starts in the source, like those of PlanExtraction(). Throws when an exactly requested
+// path does not exist.
+std::vector<ExtractionJob> PlanSelection(
+    PackageFileSystem &fileSystem, const Selection &selection, const std::filesystem::path &outputDirectory);
+
+// Rewrites include patterns of the form "romfs:/<pattern>" into one pattern for each RomFS section of the program
+// content archives in the package, as "/<archive>/<section>/<pattern>". "romfs:/" alone selects the whole RomFS.
+// The content type and section formats are read from the archive headers. Other patterns are kept as they are.
+std::vector<std::string> ExpandRomFsPatterns(PackageFileSystem &fileSystem, const std::vector<std::string> &patterns);
+
+// Runs the jobs on up to `concurrency` threads. A single thread keeps the planned order for sequential reads; more
+// threads take the largest files first and split files larger than `chunkSize` bytes into chunks that are decrypted
+// and written concurrently, so one large file keeps every thread busy. A chunk size of 0 copies every file whole.
+// Every thread mounts the container itself, so each file is read and decrypted through an independent stream stack
+// over the shared source. Progress, when wanted, is reported from the copying threads at most every 100 ms and once
+// more when every file has been written. The cancellation token is checked before every chunk. An extraction that
+// fails or is cancelled removes the files and directories it created and rethrows, OperationCancelled when cancelled.
+ExtractionReport RunExtraction(
+    const std::shared_ptr<const Container> &container,
+    std::vector<ExtractionJob> jobs,
+    unsigned concurrency,
+    uint64_t chunkSize,
+    const ExtractionControl &control = {});
+
+// Converts a UTF-8 virtual path component into a path for the host filesystem.
+std::filesystem::path ToHostPath(const std::string &utf8);
+
+// Converts a host filesystem path into UTF-8 for JavaScript.
+std::string FromHostPath(const std::filesystem::path &path);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Settings.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tc/io.h>
+#include <vector>
+
+// Maps a --type value to the nstool file type it selects. Returns FILE_TYPE_ERROR for unknown values.
+nstool::Settings::FileType FileTypeFromName(const std::string &type);
+
+// Returns the --type value that selects a file type, or an empty string for types that have none.
+std::string FileTypeName(nstool::Settings::FileType type);
+
+// Guesses the type of a file from its extension. Returns FILE_TYPE_ERROR when the extension is not a container.
+nstool::Settings::FileType FileTypeFromExtension(const std::string &name);
+
+// Identifies a container from its magic bytes. Content archives have an encrypted header, so their magic is only
+// checked after decrypting it with the header key from `keys`; without that key they are not recognised. Returns
+// FILE_TYPE_ERROR for anything else.
+nstool::Settings::FileType SniffFileType(tc::io::IStream &stream, const nstool::KeyBag &keys);
+
+// The number of entries in the section table of an NCA header.
+constexpr size_t ContentArchiveSectionCount = 4;
+
+// The content type of an NCA that holds a program.
+constexpr uint8_t ContentArchiveProgram = 0;
+
+// What the addon reads from the header of an NCA itself.
+struct ContentArchiveLayout
+{
+    // 0 for a program, 1 meta, 2 control, 3 manual, 4 data and 5 public data.
+    uint8_t contentType = 0;
+    // The offset of each section within the archive, indexed by its number in the header, or zero for an unused
+    // entry, as no section can start inside the header.
+    std::vector<int64_t> sections;
+    // Whether each section holds a RomFS rather than a partition filesystem. Always false for NCA2.
+    std::vector<bool> romFs;
+};
+
+// Reads the layout of an NCA from its header, decrypted with the header key from `keys`. Returns nothing when the
+// header cannot be decrypted. The position of the stream is kept.
+std::optional<ContentArchiveLayout> ReadContentArchiveLayout(tc::io::IStream &stream, const nstool::KeyBag &keys);
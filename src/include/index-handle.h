@@ -0,0 +1,28 @@
+#pragma once
+
+#include "metadata-index.h"
+#include <memory>
+#include <napi.h>
+
+// The JavaScript side of a metadata index. Constructed with the path of the index file.
+class IndexHandle : public Napi::ObjectWrap<IndexHandle>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    explicit IndexHandle(const Napi::CallbackInfo &info);
+
+private:
+    Napi::Value Information(const Napi::CallbackInfo &info);
+    Napi::Value InformationAsync(const Napi::CallbackInfo &info);
+    Napi::Value Verify(const Napi::CallbackInfo &info);
+    Napi::Value VerifyAsync(const Napi::CallbackInfo &info);
+    Napi::Value Compact(const Napi::CallbackInfo &info);
+    Napi::Value Statistics(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+
+    // Returns the open index, or throws a JavaScript error and returns nullptr once closed.
+    std::shared_ptr<MetadataIndex> acquire(Napi::Env env) const;
+
+    std::shared_ptr<MetadataIndex> index;
+};
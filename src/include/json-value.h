@@ -0,0 +1,12 @@
+#pragma once
+
+#include <napi.h>
+#include <nlohmann/json.hpp>
+#include <string>
+
+// Builds the same JavaScript value that JSON.parse would produce for the document, without an intermediate string.
+Napi::Value ToJavaScript(Napi::Env env, const nlohmann::ordered_json &document);
+
+// Parses JSON text straight into JavaScript values, one SAX event at a time, so no document is built in between.
+// Throws std::runtime_error when the text is not valid JSON.
+Napi::Value ParseToJavaScript(Napi::Env env, const std::string &text);
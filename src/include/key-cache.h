@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Settings.h"
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Key material shared by every container the addon mounts. nstool parses the key files and derives the key bag while
+// it initialises its settings, so the result is kept for the life of the process and only rebuilt when one of the
+// key files changes or Clear() is called.
+class KeyCache
+{
+public:
+    static KeyCache &Instance();
+
+    // Returns the key bag for the key options in args (--dev, --keyset, --tik, --cert), loading it through nstool
+    // when nothing usable is cached. args must name a readable input file, as nstool requires one.
+    nstool::KeyBag Get(const std::vector<std::string> &args);
+
+    // Tells the keys Get() returns for args apart from those of other key options or other key file contents: a hash
+    // of the key options and of the size and modification time of every key file nstool reads for them.
+    uint64_t Fingerprint(const std::vector<std::string> &args) const;
+
+    void Clear();
+
+private:
+    struct FileStamp
+    {
+        std::filesystem::path path;
+        bool exists;
+        std::filesystem::file_time_type modified;
+        uintmax_t size;
+
+        bool operator==(const FileStamp &other) const = default;
+    };
+
+    struct Entry
+    {
+        std::vector<FileStamp> stamps;
+        nstool::KeyBag keys;
+    };
+
+    static std::vector<FileStamp> stampFiles(const std::vector<std::filesystem::path> &files);
+
+    std::mutex mutex;
+    std::map<std::string, Entry> entries;
+};
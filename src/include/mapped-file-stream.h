@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tc/io.h>
+
+// How a mapped source is expected to be read, passed to the kernel as a paging hint.
+enum class AccessPattern
+{
+    Normal,
+    Sequential,
+    Random,
+};
+
+// A read-only mapping of a whole file. One mapping is shared by every stream over the same source.
+class FileMapping
+{
+public:
+    // Throws tc::io::IOException when the file cannot be opened or mapped.
+    FileMapping(const std::string &path, AccessPattern pattern);
+    ~FileMapping();
+
+    FileMapping(const FileMapping &) = delete;
+    FileMapping &operator=(const FileMapping &) = delete;
+
+    const byte_t *Data() const;
+    int64_t Size() const;
+
+private:
+    const byte_t *data = nullptr;
+    int64_t size = 0;
+#ifdef _WIN32
+    void *file = nullptr;
+    void *mapping = nullptr;
+#endif
+};
+
+// A stream over a file mapping. Reads copy straight out of the mapping without a system call; each stream keeps its
+// own position, so every mount can have one.
+class MappedFileStream : public tc::io::IStream
+{
+public:
+    explicit MappedFileStream(std::shared_ptr<const FileMapping> mapping);
+
+    bool canRead() const override;
+    bool canWrite() const override;
+    bool canSeek() const override;
+    int64_t length() override;
+    int64_t position() override;
+    size_t read(byte_t *ptr, size_t count) override;
+    size_t write(const byte_t *ptr, size_t count) override;
+    int64_t seek(int64_t offset, tc::io::SeekOrigin origin) override;
+    void setLength(int64_t length) override;
+    void flush() override;
+    void dispose() override;
+
+private:
+    std::shared_ptr<const FileMapping> mapping;
+    int64_t offset = 0;
+};
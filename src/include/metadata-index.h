@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+// What tells an unchanged file apart from a replaced or modified one: its size, modification time, inode (the file
+// index on Windows) and the device holding it (the volume serial number on Windows), as inodes are only unique
+// within one volume.
+struct FileIdentity
+{
+    uint64_t size = 0;
+    int64_t modified = 0;
+    uint64_t inode = 0;
+    uint64_t device = 0;
+
+    bool operator==(const FileIdentity &) const = default;
+};
+
+// Returns the identity of a file, or nothing when it cannot be examined.
+std::optional<FileIdentity> IdentifyFile(const std::string &path);
+
+struct IndexStatistics
+{
+    size_t entries = 0;
+    uint64_t bytes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+struct IndexVerification
+{
+    size_t checked = 0;
+    size_t unchanged = 0;
+    // The source is gone or no longer has the identity it was parsed with. The entry is dropped.
+    size_t stale = 0;
+    // The source is unchanged but nstool now produces a different document. The entry is replaced.
+    size_t mismatched = 0;
+};
+
+struct IndexCompaction
+{
+    size_t entries = 0;
+    uint64_t bytesBefore = 0;
+    uint64_t bytesAfter = 0;
+};
+
+// A persistent store of nstool information documents. Entries are keyed by the nstool arguments, which end with the
+// source, and a document is only answered while its source keeps the identity it had when it was parsed. The file is
+// an append-only log: a new record for the same arguments supersedes the old one until the index is compacted, a
+// record without a document removes the entry, and a record cut short by a crash is discarded when the index is
+// opened. Only the record positions are kept in memory.
+class MetadataIndex
+{
+public:
+    // Opens the index file, creating it when it does not exist. Throws std::runtime_error when the file is not an
+    // index or cannot be opened.
+    explicit MetadataIndex(std::filesystem::path file);
+
+    // Answers from the index while the source is unchanged, and otherwise runs nstool and records its document.
+    nlohmann::ordered_json Information(const std::vector<std::string> &args);
+
+    // Checks up to `sample` randomly chosen entries, or all of them when `sample` is 0, against their sources by
+    // parsing them again.
+    IndexVerification Verify(size_t sample);
+
+    // Rewrites the file with only the entries that are still current.
+    IndexCompaction Compact();
+
+    IndexStatistics Statistics();
+
+private:
+    struct Entry
+    {
+        FileIdentity identity;
+        uint64_t documentOffset;
+        uint32_t documentSize;
+    };
+
+    void load();
+    void reopen();
+    std::optional<nlohmann::ordered_json> find(const std::string &key, const FileIdentity &identity);
+    void store(const std::string &key, const FileIdentity &identity, const nlohmann::ordered_json &document);
+    // Drops the entry and appends a record without a document, so that it stays dropped when the index is reopened.
+    void remove(const std::string &key);
+    std::vector<uint8_t> readDocument(const Entry &entry);
+    Entry append(const std::string &key, const FileIdentity &identity, const std::vector<uint8_t> &document);
+
+    std::filesystem::path file;
+    std::fstream log;
+    uint64_t logSize = 0;
+    std::map<std::string, Entry> entries;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    std::mutex mutex;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "cancellation.h"
+#include "nstool-session.h"
+#include <functional>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <vector>
+
+// Runs nstool and returns everything it printed. Throws std::runtime_error when nstool fails so that callers on
+// either thread can decide how to surface the error, and OperationCancelled once the optional token has stopped the
+// run. A split dump is read from all of its parts, see SessionFor().
+std::string invoke(
+    const std::vector<std::string> &args, const std::shared_ptr<const CancellationToken> &cancellation = nullptr);
+
+// Runs nstool like invoke() with the session bound to the calling thread for the run.
+std::string invoke(NstoolSession &session);
+
+// Parses the output of nstool and releases the text as soon as the document has been built.
+nlohmann::ordered_json parse(std::string &&output);
+
+// Runs nstool while its output is parsed on a second thread, handing each event to `onEvent` as soon as it has been
+// read. Only a bounded amount of output is held at any time. Throws like invoke().
+nlohmann::ordered_json invokeStreaming(
+    const std::vector<std::string> &args,
+    const std::function<void(nlohmann::ordered_json &&event)> &onEvent,
+    const std::shared_ptr<const CancellationToken> &cancellation = nullptr);
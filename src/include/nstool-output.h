@@ -0,0 +1,17 @@
+#pragma once
+
+// Force-included into every translation unit of the addon, see binding.gyp. nstool writes its results to std::cout,
+// which is a single object whose format state (width, fill, flags) would be shared by concurrent runs. Renaming it
+// here gives each run the std::ostream of the sink bound to its thread instead, see ScopedOutputSink.
+#ifdef __cplusplus
+
+#include <functional>
+#include <iostream>
+
+// The stream of the sink bound to the calling thread, or the real standard output when none is bound.
+std::ostream &NstoolOutput();
+
+// std::cout becomes std::ref(NstoolOutput()).get(), which stays valid after the std:: qualifier.
+#define cout ref(NstoolOutput()).get()
+
+#endif
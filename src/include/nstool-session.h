@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <tc/io.h>
+#include <vector>
+
+class CancellationToken;
+class Container;
+
+// What the addon hands to one run of nstool's umain on the calling thread. nstool's Settings.cpp and main.cpp are
+// compiled through src/nstool-settings.cpp and src/nstool-main.cpp, which consult the session bound to the thread:
+// the key bag comes from the KeyCache for `args` instead of being parsed and derived again on every run, the input
+// is read through `container` when one is set, every read of it checks `cancellation`, and the filesystem the run
+// mounted is kept in `fileSystem`.
+struct NstoolSession
+{
+    // The arguments umain runs with. The source, which comes last, names a file nstool can open on its own; for a
+    // split dump that is the first part.
+    std::vector<std::string> args;
+    // Read in place of the source named by the arguments, for split dumps and the addon's input backends. Optional.
+    std::shared_ptr<const Container> container;
+    // The filesystem of the input as the run mounted it, set once umain returns, so a package that needed the run
+    // for its information does not parse the headers again to read its files.
+    std::shared_ptr<tc::io::IFileSystem> fileSystem;
+    // Stops the run at its next read of the input once cancelled, by throwing OperationCancelled out of umain.
+    // Optional.
+    std::shared_ptr<const CancellationToken> cancellation;
+};
+
+// A session for running umain with the arguments of run(). A source that names a split dump, by one of its parts or
+// its directory, is read through a container over every part.
+NstoolSession SessionFor(
+    const std::vector<std::string> &args, std::shared_ptr<const CancellationToken> cancellation = nullptr);
+
+// Binds a session, or none, to the calling thread for the lifetime of the scope. Runs of umain on other threads keep
+// their own sessions.
+class ScopedNstoolSession
+{
+public:
+    explicit ScopedNstoolSession(NstoolSession *session);
+    ~ScopedNstoolSession();
+
+    ScopedNstoolSession(const ScopedNstoolSession &) = delete;
+    ScopedNstoolSession &operator=(const ScopedNstoolSession &) = delete;
+
+private:
+    NstoolSession *previous;
+};
+
+// The session bound to the calling thread, or nullptr.
+NstoolSession *CurrentNstoolSession();
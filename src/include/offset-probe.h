@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <tc/io.h>
+
+// Stands at the top of the stream stack of a container, or of a decrypted content archive section, so that the
+// offset of a file within the container can be found without reading, decrypting or hashing any of it. Reads pass
+// straight through unless a probe is active on the calling thread.
+class OffsetProbeStream : public tc::io::IStream
+{
+public:
+    // `base` is added to the position of the inner stream, for a section that starts past the start of its archive.
+    OffsetProbeStream(std::shared_ptr<tc::io::IStream> inner, int64_t base = 0);
+
+    bool canRead() const override;
+    bool canWrite() const override;
+    bool canSeek() const override;
+    int64_t length() override;
+    int64_t position() override;
+    size_t read(byte_t *ptr, size_t count) override;
+    size_t write(const byte_t *ptr, size_t count) override;
+    int64_t seek(int64_t offset, tc::io::SeekOrigin origin) override;
+    void setLength(int64_t length) override;
+    void flush() override;
+    void dispose() override;
+
+private:
+    std::shared_ptr<tc::io::IStream> inner;
+    int64_t base;
+};
+
+// Finds where a file of a container starts within it by reading its first byte while a probe is active: the first
+// OffsetProbeStream the read reaches records its position and ends the read there. Returns nothing for an empty file
+// or one no probe stands over.
+std::optional<int64_t> ProbeDataOffset(tc::io::IStream &file);
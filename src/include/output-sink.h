@@ -0,0 +1,101 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+// Collects everything a single nstool invocation writes to its output stream.
+class OutputSink
+{
+public:
+    virtual ~OutputSink() = default;
+
+    virtual void write(const char *data, size_t size);
+
+    // Moves the collected output out of the sink.
+    std::string take();
+
+private:
+    std::ostringstream buffer;
+};
+
+// A sink that hands output to a reader on another thread as it is written, holding at most `capacity` bytes. The
+// writer waits while the pipe is full; once the reader has gone, further output is discarded.
+class OutputPipe : public OutputSink
+{
+public:
+    explicit OutputPipe(size_t capacity = 1024 * 1024);
+
+    void write(const char *data, size_t size) override;
+
+    // Blocks until output is available and copies up to `size` bytes of it. Returns 0 once the writer has closed the
+    // pipe and everything has been read.
+    size_t Read(char *data, size_t size);
+
+    void CloseWriter();
+    void CloseReader();
+
+    // The first bytes written, kept for error messages after the output itself has been consumed.
+    std::string Head();
+
+private:
+    const size_t capacity;
+    std::mutex mutex;
+    std::condition_variable readable;
+    std::condition_variable writable;
+    std::string pending;
+    size_t readOffset = 0;
+    std::string head;
+    bool writerClosed = false;
+    bool readerClosed = false;
+};
+
+// Presents the contents of a pipe as a std::streambuf for std::istream based parsers.
+class PipeReader : public std::streambuf
+{
+public:
+    explicit PipeReader(OutputPipe &pipe);
+
+protected:
+    int_type underflow() override;
+
+private:
+    OutputPipe &pipe;
+    char buffer[64 * 1024];
+};
+
+// Hands everything written to a stream to a sink, unbuffered, so a pipe sees output as soon as it is written.
+class SinkBuffer : public std::streambuf
+{
+public:
+    explicit SinkBuffer(OutputSink &sink);
+
+protected:
+    int_type overflow(int_type character) override;
+    std::streamsize xsputn(const char *data, std::streamsize size) override;
+
+private:
+    OutputSink &sink;
+};
+
+// Binds a sink to the calling thread for the lifetime of the scope. The scope owns a std::ostream of its own, which
+// is what std::cout names on this thread (see nstool-output.h), so neither the output nor the format state of a run
+// is shared with runs on other threads.
+class ScopedOutputSink
+{
+public:
+    explicit ScopedOutputSink(OutputSink &sink);
+    ~ScopedOutputSink();
+
+    ScopedOutputSink(const ScopedOutputSink &) = delete;
+    ScopedOutputSink &operator=(const ScopedOutputSink &) = delete;
+
+private:
+    SinkBuffer buffer;
+    std::ostream stream;
+    std::ostream *previous;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "block-cache.h"
+#include "container.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <tc/io.h>
+#include <vector>
+
+// The filesystem of a mounted container together with the containers nested inside it. A virtual path may continue
+// past a nested container file, for example "/secure/0123.nca/1/control.nacp", and the nested container is mounted
+// the first time such a path is used. A cached filesystem reads the sections of the content archives it mounts through
+// the process-wide block cache while it is enabled; only small and repeated reads benefit, so bulk readers such as
+// extraction and verification leave it off. Not thread-safe; give each thread its own instance.
+class PackageFileSystem
+{
+public:
+    explicit PackageFileSystem(std::shared_ptr<const Container> container, bool cached = false);
+
+    // Takes over a filesystem already mounted over the container's source, such as the one an nstool run built.
+    PackageFileSystem(
+        std::shared_ptr<const Container> container, std::shared_ptr<tc::io::IFileSystem> root, bool cached = false);
+
+    std::shared_ptr<tc::io::IStream> OpenFile(const std::string &path);
+
+    // Lists a directory. A path that names a nested container file lists the root of that container.
+    void ListDirectory(const std::string &path, tc::io::sDirectoryListing &listing);
+
+    // Where the data of a file starts in the source: the offsets found by ProbeDataOffset() for the file and for
+    // each nested container on its path, added together. Nothing is read or decrypted beyond the headers a mount
+    // needs. Returns nothing for the root, an empty file, or a file whose offset cannot be probed.
+    std::optional<int64_t> DataOffset(const std::string &path);
+
+    const std::shared_ptr<const Container> &GetContainer() const;
+
+private:
+    struct Location
+    {
+        tc::io::IFileSystem *fileSystem;
+        tc::io::Path path;
+    };
+
+    Location resolve(const std::string &path, bool descendIntoLast);
+
+    std::shared_ptr<const Container> container;
+    std::shared_ptr<tc::io::IFileSystem> root;
+    bool cached;
+
+    // Nested container filesystems keyed by the virtual path of the container file.
+    std::map<std::string, std::shared_ptr<tc::io::IFileSystem>> nested;
+    // Where the nested container files start in the source, keyed like nested.
+    std::map<std::string, std::optional<int64_t>> nestedOffsets;
+};
+
+// The block source of the content archive at a virtual path of the container, "/" for the source itself. Nothing when
+// the block cache is disabled, the container is trusted, or a part of the source cannot be identified, as its blocks
+// could not be told apart from another's.
+std::optional<BlockSource> ArchiveBlockSource(const Container &container, const std::string &path);
+
+// Reads up to size bytes starting at offset, stopping early only at the end of the stream. Returns the count read.
+size_t ReadAt(tc::io::IStream &stream, int64_t offset, byte_t *destination, size_t size);
+
+// Splits a virtual path into its components, accepting both separators and ignoring empty components.
+std::vector<std::string> SplitVirtualPath(const std::string &path);
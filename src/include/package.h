@@ -0,0 +1,86 @@
+#pragma once
+
+#include "package-fs.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <napi.h>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Everything an open package keeps between calls. Guarded by its mutex because work on the threadpool may use it
+// while the JavaScript object is still reachable. Closing only sets `closed`, so it never waits for that work; the
+// state is released with its last reference.
+struct PackageState
+{
+    std::mutex mutex;
+    std::atomic<bool> closed = false;
+    std::vector<std::string> args;
+    std::shared_ptr<const Container> container;
+    // Mounted on first use, or taken over from the nstool run that produced the information.
+    std::unique_ptr<PackageFileSystem> fileSystem;
+    std::optional<nlohmann::ordered_json> information;
+};
+
+// One file of an open package read from start to end, as by a PackageReadStream. The file is opened once, on the
+// first read, through a mount of its own, so reads keep their position in the decrypted stream and never take the
+// package's mutex.
+struct PackageFile
+{
+    std::mutex mutex;
+    std::atomic<bool> closed = false;
+    std::shared_ptr<PackageState> package;
+    std::string path;
+    std::unique_ptr<PackageFileSystem> fileSystem;
+    std::shared_ptr<tc::io::IStream> stream;
+};
+
+// A package that stays parsed across calls. Constructed with the same arguments as run(), as an array; the container
+// headers are parsed once, on first use, and the nstool information document is produced on first use and then
+// cached. When the information comes first, the headers nstool parsed for it are the ones the package keeps.
+class Package : public Napi::ObjectWrap<Package>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    explicit Package(const Napi::CallbackInfo &info);
+
+    // Package.openAsync(args, options) opens a package like the constructor on the libuv threadpool and returns a
+    // promise of the Package.
+    static Napi::Value OpenAsync(const Napi::CallbackInfo &info);
+
+    // Returns the state of an open package, or throws a JavaScript error and returns nullptr once closed.
+    std::shared_ptr<PackageState> Acquire(Napi::Env env) const;
+
+private:
+    Napi::Value Info(const Napi::CallbackInfo &info);
+    Napi::Value InfoAsync(const Napi::CallbackInfo &info);
+    Napi::Value Tree(const Napi::CallbackInfo &info);
+    Napi::Value Children(const Napi::CallbackInfo &info);
+    Napi::Value ExportTree(const Napi::CallbackInfo &info);
+    Napi::Value ExportTreeAsync(const Napi::CallbackInfo &info);
+    Napi::Value Extract(const Napi::CallbackInfo &info);
+    Napi::Value ExtractAsync(const Napi::CallbackInfo &info);
+    Napi::Value Read(const Napi::CallbackInfo &info);
+    Napi::Value ReadAsync(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<PackageState> state;
+};
+
+// new PackageReader(package, path) reads one file of an open package in order; see PackageFile.
+class PackageReader : public Napi::ObjectWrap<PackageReader>
+{
+public:
+    static Napi::Function Define(Napi::Env env);
+
+    explicit PackageReader(const Napi::CallbackInfo &info);
+
+private:
+    Napi::Value ReadAsync(const Napi::CallbackInfo &info);
+    Napi::Value Close(const Napi::CallbackInfo &info);
+
+    std::shared_ptr<PackageFile> file;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Calls `work` once for every index below `count` on up to `concurrency` threads, the calling thread included.
+// Indices are handed out in ascending order as threads become free. The first exception stops further indices from
+// being handed out and is rethrown once every thread has finished.
+void ParallelFor(size_t count, unsigned concurrency, const std::function<void(size_t index)> &work);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+struct ExtractionProgress
+{
+    uint64_t bytesDone = 0;
+    uint64_t bytesTotal = 0;
+    // The file most recently started by any thread.
+    std::string currentFile;
+    size_t filesDone = 0;
+    size_t fileCount = 0;
+};
+
+using ProgressCallback = std::function<void(const ExtractionProgress &progress)>;
+
+// Collects progress from any number of threads and hands it to a callback at most once per interval. Between
+// reports an update costs a few atomic operations and a clock read; the thread that finds the interval elapsed makes
+// the report while the others carry on.
+class ProgressMeter
+{
+public:
+    ProgressMeter(
+        uint64_t bytesTotal,
+        size_t fileCount,
+        ProgressCallback report,
+        std::chrono::steady_clock::duration interval = std::chrono::milliseconds(100));
+
+    void FileStarted(const std::string &path);
+    void Advance(uint64_t bytes);
+    void FileDone();
+
+    // Reports the final state regardless of the interval.
+    void Finish();
+
+private:
+    void maybeReport();
+    ExtractionProgress snapshot();
+
+    const uint64_t bytesTotal;
+    const size_t fileCount;
+    const ProgressCallback report;
+    const int64_t interval;
+    std::atomic<uint64_t> bytesDone = 0;
+    std::atomic<size_t> filesDone = 0;
+    std::atomic<int64_t> lastReport;
+    std::mutex currentFileMutex;
+    std::string currentFile;
+};
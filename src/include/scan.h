@@ -0,0 +1,44 @@
+#pragma once
+
+#include "batch.h"
+#include "cancellation.h"
+#include <filesystem>
+#include <functional>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+struct ScanOptions
+{
+    std::filesystem::path root;
+    // Lowercase extensions without the dot. Empty to consider every file.
+    std::vector<std::string> extensions;
+    bool recursive = true;
+    unsigned concurrency = 1;
+    // The nstool arguments for each file, without --type and the source.
+    std::vector<std::string> args;
+    std::shared_ptr<CancellationToken> cancellation = std::make_shared<CancellationToken>();
+};
+
+// One file found by a scan. `type` is the --type value its magic bytes selected.
+struct ScanEntry
+{
+    std::string source;
+    std::string type;
+    BatchResult result;
+};
+
+// Lists the files below the root whose extension is selected. Directories that cannot be read are skipped.
+std::vector<std::filesystem::path> FindCandidates(const ScanOptions &options);
+
+// Finds the candidates, sniffs each one and parses those that are packages on up to `concurrency` threads. Every
+// parsed file is handed to `emit` from the thread that parsed it as soon as it is done. Files whose magic bytes do
+// not identify a package are left out; files that fail to open or parse are emitted with their error. Cancelling
+// the token stops the walk or the parsing with OperationCancelled.
+void RunScan(const ScanOptions &options, const std::function<void(ScanEntry &&entry)> &emit);
+
+// scan(root, extensions, recursive, concurrency, args, onEntry, cancellation): scans on a thread of its own and calls
+// onEntry with { source, type, result } for every package as it completes. When onEntry returns false the scanning
+// threads wait before handing over their next entry until resume() is called. Returns { done, resume }, where done
+// is a promise for the number of packages.
+Napi::Value Scan(const Napi::CallbackInfo &info);
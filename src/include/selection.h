@@ -0,0 +1,34 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+// Files chosen for extraction by exact virtual path (a file, or a directory and everything below it) and by glob
+// pattern. Patterns match whole virtual paths segment by segment: "*" and "?" stay within one segment and "**"
+// spans any number of segments, for example "/secure/*.nca/1/Data/**/*.arc".
+class Selection
+{
+public:
+    Selection(const std::vector<std::string> &paths, const std::vector<std::string> &patterns);
+
+    // Whether the file at this path is selected.
+    bool Matches(const std::vector<std::string> &path) const;
+
+    // Whether anything below this directory, or inside this container file, could be selected.
+    bool MayContain(const std::vector<std::string> &path) const;
+
+    // Whether this path was requested exactly.
+    bool IsRequested(const std::vector<std::string> &path) const;
+
+    // The exact paths that were requested, joined with "/".
+    const std::set<std::string> &Requested() const;
+
+private:
+    std::vector<std::vector<std::string>> paths;
+    std::vector<std::vector<std::string>> patterns;
+    std::set<std::string> requested;
+};
+
+// Joins virtual path components into an absolute virtual path.
+std::string JoinVirtualPath(const std::vector<std::string> &parts);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using Sha256Hash = std::array<uint8_t, 32>;
+
+// The SHA-256 block functions the addon can use. Hardware backends are only chosen when the CPU implements them.
+enum class Sha256Backend
+{
+    Software,
+    // The SHA extensions of x86 (SHA-NI).
+    ShaNi,
+    // The SHA2 instructions of the ARMv8 Crypto Extension.
+    Armv8,
+};
+
+// The fastest backend the CPU supports, detected once.
+Sha256Backend ActiveSha256Backend();
+
+// 'software', 'sha-ni' or 'armv8'.
+std::string Sha256BackendName(Sha256Backend backend);
+
+// Whether this build contains the block function for `backend` and the CPU can run it.
+bool IsSha256BackendAvailable(Sha256Backend backend);
+
+// Incremental SHA-256. Hashing the same data gives the same result on every backend.
+class Sha256
+{
+public:
+    explicit Sha256(Sha256Backend backend = ActiveSha256Backend());
+
+    void Update(const uint8_t *data, size_t size);
+    Sha256Hash Finalize();
+
+private:
+    using BlockFunction = void (*)(uint32_t state[8], const uint8_t *blocks, size_t count);
+
+    BlockFunction compress;
+    uint32_t state[8];
+    uint8_t buffer[64];
+    size_t buffered = 0;
+    uint64_t length = 0;
+};
+
+Sha256Hash Sha256Digest(const uint8_t *data, size_t size);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <tc/io.h>
+#include <vector>
+
+// The parts of a split dump, in order, for a path that names one of them: "game.xc0", "game.xc1", ... for a split
+// XCI, "game.ns0", ... for a split NSP, or "game.nsp.00", "game.xci.00", .... A directory named like a package and
+// holding "00", "01", ..., as written for the archive bit, names its parts, and so does any of those parts. Parts are
+// counted from the first one until a number is missing. Any other path is returned on its own.
+std::vector<std::string> FindSplitParts(const std::string &path);
+
+// One logical stream over the parts of a split dump, read back to back. Each part keeps its own stream; a read that
+// spans part boundaries reads every part straight into the caller's buffer.
+class ConcatenatedStream : public tc::io::IStream
+{
+public:
+    explicit ConcatenatedStream(const std::vector<std::shared_ptr<tc::io::IStream>> &parts);
+
+    bool canRead() const override;
+    bool canWrite() const override;
+    bool canSeek() const override;
+    int64_t length() override;
+    int64_t position() override;
+    size_t read(byte_t *ptr, size_t count) override;
+    size_t write(const byte_t *ptr, size_t count) override;
+    int64_t seek(int64_t offset, tc::io::SeekOrigin origin) override;
+    void setLength(int64_t length) override;
+    void flush() override;
+    void dispose() override;
+
+private:
+    struct Part
+    {
+        std::shared_ptr<tc::io::IStream> stream;
+        int64_t start;
+        int64_t length;
+    };
+
+    std::vector<Part> parts;
+    int64_t size = 0;
+    int64_t offset = 0;
+};
+
+// splitParts(path): returns the parts FindSplitParts finds for path.
+Napi::Value SplitParts(const Napi::CallbackInfo &info);
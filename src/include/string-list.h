@@ -0,0 +1,8 @@
+#pragma once
+
+#include <napi.h>
+#include <string>
+#include <vector>
+
+// Converts a JavaScript array into strings, one per element. Anything other than an array yields an empty list.
+std::vector<std::string> StringList(const Napi::Value &value);
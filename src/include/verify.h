@@ -0,0 +1,56 @@
+#pragma once
+
+#include "cancellation.h"
+#include "container.h"
+#include <cstdint>
+#include <memory>
+#include <napi.h>
+#include <string>
+#include <vector>
+
+// The outcome of checking one hashed part of a package: the header of a gamecard partition filesystem together with
+// the hashes of its entries, or one section of a content archive.
+struct SectionVerification
+{
+    // "/" for the root partition filesystem of a gamecard, "/secure" for one of its partitions and the virtual path
+    // of the section directory, such as "/secure/<id>.nca/0", for content archive sections.
+    std::string section;
+    // "hfs0" or "nca".
+    std::string kind;
+    // What was checked. "full" for partition filesystems, whose every hashed region is read. "files" for content
+    // archive sections, where only the hash blocks covering file data are checked: hash tables, padding, the parts of
+    // upper hash levels no file needs and sections nstool cannot mount are not read.
+    std::string coverage;
+    uint64_t bytes = 0;
+    // Hashed regions for partition filesystems, files for sections.
+    uint64_t regions = 0;
+    bool ok = true;
+    // The first region that failed: the virtual path of the entry or file and an offset, absolute in the source for
+    // partition filesystem hashes and within the file for sections. -1 while nothing failed.
+    std::string firstBadPath;
+    int64_t firstBadOffset = -1;
+    std::string error;
+};
+
+struct VerificationReport
+{
+    std::vector<SectionVerification> sections;
+    uint64_t bytes = 0;
+    double seconds = 0;
+    unsigned concurrency = 1;
+
+    bool Ok() const;
+};
+
+// Checks every hashed region of a package on up to `concurrency` threads. Gamecard partition filesystem hashes are
+// read from the raw source and hashed with the SHA-256 backend; the files of content archive sections are read
+// through their hash-verified stream stack in chunks, so every hash block that covers file data is checked, and only
+// those, see SectionVerification::coverage. A
+// failure is recorded in its section and never stops the other regions. Cancelling the token stops the check before
+// its next region with OperationCancelled.
+VerificationReport RunVerification(
+    const std::shared_ptr<const Container> &container, unsigned concurrency, const CancellationToken &cancellation);
+
+// verify(args, concurrency, cancellation, parts): opens the package described by the arguments, as passed to run(),
+// or split into the given parts, and returns a promise for { ok, sections, throughput }.
+Napi::Value Verify(const Napi::CallbackInfo &info);
@@ -0,0 +1,285 @@
+#include "index-handle.h"
+
+#include "extract.h"
+#include "json-value.h"
+#include "string-list.h"
+
+namespace
+{
+
+size_t sampleSize(const Napi::Value &value)
+{
+    return value.IsUndefined() ? 0 : static_cast<size_t>(value.ToNumber().Int64Value());
+}
+
+Napi::Object verificationToJavaScript(Napi::Env env, const IndexVerification &report)
+{
+    auto result = Napi::Object::New(env);
+    result.Set("checked", Napi::Number::New(env, static_cast<double>(report.checked)));
+    result.Set("unchanged", Napi::Number::New(env, static_cast<double>(report.unchanged)));
+    result.Set("stale", Napi::Number::New(env, static_cast<double>(report.stale)));
+    result.Set("mismatched", Napi::Number::New(env, static_cast<double>(report.mismatched)));
+
+    return result;
+}
+
+// Answers an information request on the libuv threadpool; nstool only runs when the index cannot answer.
+class InformationWorker : public Napi::AsyncWorker
+{
+public:
+    InformationWorker(Napi::Env env, std::shared_ptr<MetadataIndex> index, std::vector<std::string> args)
+        : Napi::AsyncWorker(env), index(std::move(index)), args(std::move(args)),
+          deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            document = index->Information(args);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(ToJavaScript(Env(), document));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::shared_ptr<MetadataIndex> index;
+    std::vector<std::string> args;
+    nlohmann::ordered_json document;
+    Napi::Promise::Deferred deferred;
+};
+
+// Verifies entries on the libuv threadpool, since every checked entry is parsed again.
+class VerifyWorker : public Napi::AsyncWorker
+{
+public:
+    VerifyWorker(Napi::Env env, std::shared_ptr<MetadataIndex> index, size_t sample)
+        : Napi::AsyncWorker(env), index(std::move(index)), sample(sample), deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            report = index->Verify(sample);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(verificationToJavaScript(Env(), report));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::shared_ptr<MetadataIndex> index;
+    size_t sample;
+    IndexVerification report;
+    Napi::Promise::Deferred deferred;
+};
+
+} // namespace
+
+Napi::Function IndexHandle::Define(Napi::Env env)
+{
+    return DefineClass(
+        env,
+        "MetadataIndex",
+        {
+            InstanceMethod("information", &IndexHandle::Information),
+            InstanceMethod("informationAsync", &IndexHandle::InformationAsync),
+            InstanceMethod("verify", &IndexHandle::Verify),
+            InstanceMethod("verifyAsync", &IndexHandle::VerifyAsync),
+            InstanceMethod("compact", &IndexHandle::Compact),
+            InstanceMethod("stats", &IndexHandle::Statistics),
+            InstanceMethod("close", &IndexHandle::Close),
+        });
+}
+
+IndexHandle::IndexHandle(const Napi::CallbackInfo &info) : Napi::ObjectWrap<IndexHandle>(info)
+{
+    try
+    {
+        index = std::make_shared<MetadataIndex>(ToHostPath(info[0].ToString().Utf8Value()));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+    }
+}
+
+// information(args) takes the same arguments as run(), as an array, and returns the information document.
+Napi::Value IndexHandle::Information(const Napi::CallbackInfo &info)
+{
+    const auto opened = acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        return ToJavaScript(info.Env(), opened->Information(StringList(info[0])));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+Napi::Value IndexHandle::InformationAsync(const Napi::CallbackInfo &info)
+{
+    const auto opened = acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    auto *worker = new InformationWorker(info.Env(), opened, StringList(info[0]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+// verify(sample) parses up to `sample` random entries again, or every entry without a sample, and reports
+// { checked, unchanged, stale, mismatched }.
+Napi::Value IndexHandle::Verify(const Napi::CallbackInfo &info)
+{
+    const auto opened = acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        return verificationToJavaScript(info.Env(), opened->Verify(sampleSize(info[0])));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+Napi::Value IndexHandle::VerifyAsync(const Napi::CallbackInfo &info)
+{
+    const auto opened = acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    auto *worker = new VerifyWorker(info.Env(), opened, sampleSize(info[0]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value IndexHandle::Compact(const Napi::CallbackInfo &info)
+{
+    const auto opened = acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        const auto report = opened->Compact();
+
+        auto result = Napi::Object::New(info.Env());
+        result.Set("entries", Napi::Number::New(info.Env(), static_cast<double>(report.entries)));
+        result.Set("bytesBefore", Napi::Number::New(info.Env(), static_cast<double>(report.bytesBefore)));
+        result.Set("bytesAfter", Napi::Number::New(info.Env(), static_cast<double>(report.bytesAfter)));
+
+        return result;
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+Napi::Value IndexHandle::Statistics(const Napi::CallbackInfo &info)
+{
+    const auto opened = acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    const auto statistics = opened->Statistics();
+
+    auto result = Napi::Object::New(info.Env());
+    result.Set("entries", Napi::Number::New(info.Env(), static_cast<double>(statistics.entries)));
+    result.Set("bytes", Napi::Number::New(info.Env(), static_cast<double>(statistics.bytes)));
+    result.Set("hits", Napi::Number::New(info.Env(), static_cast<double>(statistics.hits)));
+    result.Set("misses", Napi::Number::New(info.Env(), static_cast<double>(statistics.misses)));
+
+    return result;
+}
+
+Napi::Value IndexHandle::Close(const Napi::CallbackInfo &info)
+{
+    // Work that already holds the index finishes with it; the file is closed with the last reference.
+    index.reset();
+
+    return info.Env().Undefined();
+}
+
+std::shared_ptr<MetadataIndex> IndexHandle::acquire(Napi::Env env) const
+{
+    if (!index)
+    {
+        Napi::Error::New(env, "The metadata index has been closed.").ThrowAsJavaScriptException();
+    }
+
+    return index;
+}
@@ -0,0 +1,204 @@
+#include "json-value.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+// Receives the events of nlohmann::json::sax_parse and assembles the JavaScript value they describe.
+class JavaScriptBuilder
+{
+public:
+    using json = nlohmann::ordered_json;
+
+    explicit JavaScriptBuilder(Napi::Env env) : env(env)
+    {
+    }
+
+    bool null()
+    {
+        return add(env.Null());
+    }
+
+    bool boolean(bool value)
+    {
+        return add(Napi::Boolean::New(env, value));
+    }
+
+    // JSON.parse yields doubles for every number, so do the same.
+    bool number_integer(json::number_integer_t value)
+    {
+        return add(Napi::Number::New(env, static_cast<double>(value)));
+    }
+
+    bool number_unsigned(json::number_unsigned_t value)
+    {
+        return add(Napi::Number::New(env, static_cast<double>(value)));
+    }
+
+    bool number_float(json::number_float_t value, const json::string_t &)
+    {
+        return add(Napi::Number::New(env, value));
+    }
+
+    bool string(json::string_t &value)
+    {
+        return add(Napi::String::New(env, value));
+    }
+
+    bool binary(json::binary_t &)
+    {
+        return add(env.Null());
+    }
+
+    bool start_object(std::size_t)
+    {
+        auto object = Napi::Object::New(env);
+
+        add(object);
+        frames.push_back({object, false, 0, {}});
+
+        return true;
+    }
+
+    bool key(json::string_t &value)
+    {
+        frames.back().key = std::move(value);
+
+        return true;
+    }
+
+    bool end_object()
+    {
+        frames.pop_back();
+
+        return true;
+    }
+
+    bool start_array(std::size_t)
+    {
+        auto array = Napi::Array::New(env);
+
+        add(array);
+        frames.push_back({array, true, 0, {}});
+
+        return true;
+    }
+
+    bool end_array()
+    {
+        frames.pop_back();
+
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string &, const nlohmann::detail::exception &error)
+    {
+        message = error.what();
+
+        return false;
+    }
+
+    Napi::Value Result() const
+    {
+        return root;
+    }
+
+    const std::string &Error() const
+    {
+        return message;
+    }
+
+private:
+    // An object or array that is still being filled.
+    struct Frame
+    {
+        Napi::Object container;
+        bool array;
+        uint32_t index;
+        std::string key;
+    };
+
+    bool add(Napi::Value value)
+    {
+        if (frames.empty())
+        {
+            root = value;
+            return true;
+        }
+
+        auto &frame = frames.back();
+
+        if (frame.array)
+        {
+            frame.container.Set(frame.index++, value);
+        }
+        else
+        {
+            frame.container.Set(frame.key, value);
+        }
+
+        return true;
+    }
+
+    Napi::Env env;
+    Napi::Value root;
+    std::vector<Frame> frames;
+    std::string message;
+};
+
+} // namespace
+
+Napi::Value ToJavaScript(Napi::Env env, const nlohmann::ordered_json &document)
+{
+    switch (document.type())
+    {
+    case nlohmann::ordered_json::value_t::object:
+    {
+        auto object = Napi::Object::New(env);
+
+        for (const auto &[key, value] : document.items())
+        {
+            object.Set(key, ToJavaScript(env, value));
+        }
+
+        return object;
+    }
+    case nlohmann::ordered_json::value_t::array:
+    {
+        auto array = Napi::Array::New(env, document.size());
+        uint32_t index = 0;
+
+        for (const auto &value : document)
+        {
+            array.Set(index++, ToJavaScript(env, value));
+        }
+
+        return array;
+    }
+    case nlohmann::ordered_json::value_t::string:
+        return Napi::String::New(env, document.get_ref<const std::string &>());
+    case nlohmann::ordered_json::value_t::boolean:
+        return Napi::Boolean::New(env, document.get<bool>());
+    case nlohmann::ordered_json::value_t::number_integer:
+    case nlohmann::ordered_json::value_t::number_unsigned:
+    case nlohmann::ordered_json::value_t::number_float:
+        // JSON.parse yields doubles for every number, so do the same.
+        return Napi::Number::New(env, document.get<double>());
+    default:
+        return env.Null();
+    }
+}
+
+Napi::Value ParseToJavaScript(Napi::Env env, const std::string &text)
+{
+    JavaScriptBuilder builder(env);
+
+    if (!nlohmann::ordered_json::sax_parse(text, &builder))
+    {
+        throw std::runtime_error(builder.Error());
+    }
+
+    return builder.Result();
+}
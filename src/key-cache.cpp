@@ -0,0 +1,165 @@
+#include "key-cache.h"
+
+#include "nstool-session.h"
+#include "output-sink.h"
+#include <cstdlib>
+#include <functional>
+
+namespace
+{
+
+// Options that change which keys nstool loads, and whether each one takes a value.
+const std::vector<std::pair<std::string, bool>> keyOptions = {
+    {"-d", false},
+    {"--dev", false},
+    {"-k", true},
+    {"--keyset", true},
+    {"--tik", true},
+    {"--cert", true},
+    {"--titlekey", true},
+    {"--bodykey", true},
+};
+
+std::filesystem::path homeDirectory()
+{
+#ifdef _WIN32
+    const char *home = std::getenv("USERPROFILE");
+#else
+    const char *home = std::getenv("HOME");
+#endif
+
+    return home != nullptr ? std::filesystem::path(home) : std::filesystem::path();
+}
+
+// Collects the key options from args, both as a cache key and as the list of files nstool will read.
+std::string describeKeyOptions(const std::vector<std::string> &args, std::vector<std::filesystem::path> &files)
+{
+    std::string description;
+    bool isDev = false;
+    bool hasKeyset = false;
+
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        for (const auto &[option, takesValue] : keyOptions)
+        {
+            if (args[i] != option)
+            {
+                continue;
+            }
+
+            description += option + '\n';
+
+            if (option == "-d" || option == "--dev")
+            {
+                isDev = true;
+            }
+
+            if (takesValue && i + 1 < args.size())
+            {
+                description += args[++i] + '\n';
+
+                if (option == "-k" || option == "--keyset")
+                {
+                    hasKeyset = true;
+                    files.emplace_back(args[i]);
+                }
+                else if (option == "--tik" || option == "--cert")
+                {
+                    files.emplace_back(args[i]);
+                }
+            }
+
+            break;
+        }
+    }
+
+    const auto switchDirectory = homeDirectory() / ".switch";
+
+    if (!hasKeyset)
+    {
+        files.push_back(switchDirectory / (isDev ? "dev.keys" : "prod.keys"));
+    }
+
+    files.push_back(switchDirectory / "title.keys");
+
+    return description;
+}
+
+} // namespace
+
+KeyCache &KeyCache::Instance()
+{
+    static KeyCache cache;
+
+    return cache;
+}
+
+nstool::KeyBag KeyCache::Get(const std::vector<std::string> &args)
+{
+    std::vector<std::filesystem::path> files;
+    const auto description = describeKeyOptions(args, files);
+    auto stamps = stampFiles(files);
+
+    // Loading happens under the lock so that concurrent first uses derive the keys only once.
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto found = entries.find(description);
+
+    if (found != entries.end() && found->second.stamps == stamps)
+    {
+        return found->second.keys;
+    }
+
+    OutputSink discarded;
+    ScopedOutputSink scope(discarded);
+    // Without a session nstool derives the keys itself rather than asking this cache for them.
+    ScopedNstoolSession unbound(nullptr);
+
+    Entry entry = {std::move(stamps), nstool::SettingsInitializer(args).opt.keybag};
+
+    return entries.insert_or_assign(description, std::move(entry)).first->second.keys;
+}
+
+uint64_t KeyCache::Fingerprint(const std::vector<std::string> &args) const
+{
+    std::vector<std::filesystem::path> files;
+    auto fingerprint = static_cast<uint64_t>(std::hash<std::string>()(describeKeyOptions(args, files)));
+
+    for (const auto &file : stampFiles(files))
+    {
+        const auto combined = file.path.string() + '\n' + std::to_string(file.exists) + '\n' +
+                              std::to_string(file.modified.time_since_epoch().count()) + '\n' +
+                              std::to_string(file.size);
+
+        fingerprint = fingerprint * 31 + std::hash<std::string>()(combined);
+    }
+
+    return fingerprint;
+}
+
+void KeyCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    entries.clear();
+}
+
+std::vector<KeyCache::FileStamp> KeyCache::stampFiles(const std::vector<std::filesystem::path> &files)
+{
+    std::vector<FileStamp> stamps;
+
+    for (const auto &file : files)
+    {
+        std::error_code error;
+        FileStamp stamp = {file, std::filesystem::exists(file, error), {}, 0};
+
+        if (stamp.exists)
+        {
+            stamp.modified = std::filesystem::last_write_time(file, error);
+            stamp.size = std::filesystem::file_size(file, error);
+        }
+
+        stamps.push_back(stamp);
+    }
+
+    return stamps;
+}
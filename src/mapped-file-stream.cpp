@@ -0,0 +1,229 @@
+#include "mapped-file-stream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+const std::string moduleName = "MappedFileStream";
+
+} // namespace
+
+#ifdef _WIN32
+
+FileMapping::FileMapping(const std::string &path, AccessPattern pattern)
+{
+    const auto hostPath = std::filesystem::path(std::u8string(path.begin(), path.end()));
+    const DWORD flags = pattern == AccessPattern::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN
+                        : pattern == AccessPattern::Random   ? FILE_FLAG_RANDOM_ACCESS
+                                                             : FILE_ATTRIBUTE_NORMAL;
+
+    file = CreateFileW(hostPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        file = nullptr;
+        throw tc::io::IOException(moduleName, "Failed to open " + path);
+    }
+
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = fileSize.QuadPart;
+
+    if (size == 0)
+    {
+        return;
+    }
+
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    data = mapping != nullptr ? static_cast<const byte_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+    if (data == nullptr)
+    {
+        if (mapping != nullptr)
+        {
+            CloseHandle(mapping);
+        }
+
+        CloseHandle(file);
+        throw tc::io::IOException(moduleName, "Failed to map " + path);
+    }
+}
+
+FileMapping::~FileMapping()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+
+    if (file != nullptr)
+    {
+        CloseHandle(file);
+    }
+}
+
+#else
+
+FileMapping::FileMapping(const std::string &path, AccessPattern pattern)
+{
+    const int descriptor = open(path.c_str(), O_RDONLY);
+
+    if (descriptor < 0)
+    {
+        throw tc::io::IOException(moduleName, "Failed to open " + path);
+    }
+
+    struct stat status;
+
+    if (fstat(descriptor, &status) != 0)
+    {
+        close(descriptor);
+        throw tc::io::IOException(moduleName, "Failed to stat " + path);
+    }
+
+    size = status.st_size;
+
+    if (size == 0)
+    {
+        close(descriptor);
+        return;
+    }
+
+    void *mapped = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, descriptor, 0);
+
+    // The mapping keeps the file alive on its own.
+    close(descriptor);
+
+    if (mapped == MAP_FAILED)
+    {
+        throw tc::io::IOException(moduleName, "Failed to map " + path);
+    }
+
+    const int advice = pattern == AccessPattern::Sequential ? MADV_SEQUENTIAL
+                       : pattern == AccessPattern::Random   ? MADV_RANDOM
+                                                            : MADV_NORMAL;
+    madvise(mapped, static_cast<size_t>(size), advice);
+
+    data = static_cast<const byte_t *>(mapped);
+}
+
+FileMapping::~FileMapping()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<byte_t *>(data), static_cast<size_t>(size));
+    }
+}
+
+#endif
+
+const byte_t *FileMapping::Data() const
+{
+    return data;
+}
+
+int64_t FileMapping::Size() const
+{
+    return size;
+}
+
+MappedFileStream::MappedFileStream(std::shared_ptr<const FileMapping> mapping) : mapping(std::move(mapping))
+{
+}
+
+bool MappedFileStream::canRead() const
+{
+    return mapping != nullptr;
+}
+
+bool MappedFileStream::canWrite() const
+{
+    return false;
+}
+
+bool MappedFileStream::canSeek() const
+{
+    return mapping != nullptr;
+}
+
+int64_t MappedFileStream::length()
+{
+    if (!mapping)
+    {
+        throw tc::ObjectDisposedException(moduleName, "The stream has been disposed.");
+    }
+
+    return mapping->Size();
+}
+
+int64_t MappedFileStream::position()
+{
+    return offset;
+}
+
+size_t MappedFileStream::read(byte_t *ptr, size_t count)
+{
+    const auto available = std::max<int64_t>(length() - offset, 0);
+    const auto size = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(count), available));
+
+    if (size != 0)
+    {
+        std::memcpy(ptr, mapping->Data() + offset, size);
+        offset += static_cast<int64_t>(size);
+    }
+
+    return size;
+}
+
+size_t MappedFileStream::write(const byte_t *, size_t)
+{
+    throw tc::NotSupportedException(moduleName, "The stream is read-only.");
+}
+
+int64_t MappedFileStream::seek(int64_t offset, tc::io::SeekOrigin origin)
+{
+    const auto base = origin == tc::io::SeekOrigin::Begin     ? 0
+                      : origin == tc::io::SeekOrigin::Current ? this->offset
+                                                              : length();
+
+    if (base + offset < 0)
+    {
+        throw tc::ArgumentOutOfRangeException(moduleName, "The seek would move before the start of the stream.");
+    }
+
+    this->offset = base + offset;
+
+    return this->offset;
+}
+
+void MappedFileStream::setLength(int64_t)
+{
+    throw tc::NotSupportedException(moduleName, "The stream is read-only.");
+}
+
+void MappedFileStream::flush()
+{
+}
+
+void MappedFileStream::dispose()
+{
+    mapping.reset();
+}
@@ -0,0 +1,522 @@
+#include "metadata-index.h"
+
+#include "extract.h"
+#include "node-nstool.h"
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+
+constexpr char magic[4] = {'N', 'S', 'T', 'I'};
+constexpr uint32_t version = 2;
+// Version 1 records carry no device. Such an index is started again, as none of its entries could be matched.
+constexpr uint32_t deviceLessVersion = 1;
+constexpr uint64_t headerSize = sizeof(magic) + sizeof(version);
+// Key size, the four identity fields and the document size.
+constexpr uint64_t recordOverhead = 4 + 8 + 8 + 8 + 8 + 4;
+
+// Records are written little-endian so that an index can move between machines.
+template <typename T> void put(std::vector<uint8_t> &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+    }
+}
+
+template <typename T> bool get(std::istream &in, T &value)
+{
+    uint8_t bytes[sizeof(T)];
+
+    if (!in.read(reinterpret_cast<char *>(bytes), sizeof(T)))
+    {
+        return false;
+    }
+
+    uint64_t result = 0;
+
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        result |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+
+    value = static_cast<T>(result);
+
+    return true;
+}
+
+std::vector<uint8_t> encodeHeader()
+{
+    std::vector<uint8_t> header(magic, magic + sizeof(magic));
+    put(header, version);
+
+    return header;
+}
+
+std::vector<uint8_t> encodeRecord(
+    const std::string &key, const FileIdentity &identity, const std::vector<uint8_t> &document)
+{
+    std::vector<uint8_t> record;
+    record.reserve(recordOverhead + key.size() + document.size());
+
+    put(record, static_cast<uint32_t>(key.size()));
+    record.insert(record.end(), key.begin(), key.end());
+    put(record, identity.size);
+    put(record, identity.modified);
+    put(record, identity.inode);
+    put(record, identity.device);
+    put(record, static_cast<uint32_t>(document.size()));
+    record.insert(record.end(), document.begin(), document.end());
+
+    return record;
+}
+
+void write(std::ostream &out, const std::vector<uint8_t> &bytes)
+{
+    out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Arguments never contain NUL characters, so joining on them is reversible.
+std::string joinArguments(const std::vector<std::string> &args)
+{
+    std::string key;
+
+    for (const auto &arg : args)
+    {
+        if (!key.empty())
+        {
+            key.push_back('\0');
+        }
+
+        key += arg;
+    }
+
+    return key;
+}
+
+std::vector<std::string> splitArguments(const std::string &key)
+{
+    std::vector<std::string> args;
+    size_t start = 0;
+
+    while (true)
+    {
+        const auto end = key.find('\0', start);
+        args.push_back(key.substr(start, end - start));
+
+        if (end == std::string::npos)
+        {
+            return args;
+        }
+
+        start = end + 1;
+    }
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+std::optional<FileIdentity> IdentifyFile(const std::string &path)
+{
+    const auto hostPath = ToHostPath(path);
+    const auto file = CreateFileW(
+        hostPath.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return std::nullopt;
+    }
+
+    BY_HANDLE_FILE_INFORMATION information;
+    const auto examined = GetFileInformationByHandle(file, &information);
+    CloseHandle(file);
+
+    if (!examined)
+    {
+        return std::nullopt;
+    }
+
+    return FileIdentity{
+        (static_cast<uint64_t>(information.nFileSizeHigh) << 32) | information.nFileSizeLow,
+        static_cast<int64_t>(
+            (static_cast<uint64_t>(information.ftLastWriteTime.dwHighDateTime) << 32) |
+            information.ftLastWriteTime.dwLowDateTime),
+        (static_cast<uint64_t>(information.nFileIndexHigh) << 32) | information.nFileIndexLow,
+        information.dwVolumeSerialNumber,
+    };
+}
+
+#else
+
+std::optional<FileIdentity> IdentifyFile(const std::string &path)
+{
+    struct stat status;
+
+    if (stat(path.c_str(), &status) != 0)
+    {
+        return std::nullopt;
+    }
+
+#ifdef __APPLE__
+    const auto &modified = status.st_mtimespec;
+#else
+    const auto &modified = status.st_mtim;
+#endif
+
+    return FileIdentity{
+        static_cast<uint64_t>(status.st_size),
+        static_cast<int64_t>(modified.tv_sec) * 1000000000 + modified.tv_nsec,
+        static_cast<uint64_t>(status.st_ino),
+        static_cast<uint64_t>(status.st_dev),
+    };
+}
+
+#endif
+
+MetadataIndex::MetadataIndex(std::filesystem::path file) : file(std::move(file))
+{
+    load();
+}
+
+nlohmann::ordered_json MetadataIndex::Information(const std::vector<std::string> &args)
+{
+    const auto key = joinArguments(args);
+    const auto identity = IdentifyFile(args.back());
+
+    if (identity)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (auto document = find(key, *identity))
+        {
+            ++hits;
+            return std::move(*document);
+        }
+
+        ++misses;
+    }
+
+    // The identity was taken before parsing, so a source that changes meanwhile is parsed again next time.
+    auto document = parse(invoke(args));
+
+    if (identity)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        store(key, *identity, document);
+    }
+
+    return document;
+}
+
+IndexVerification MetadataIndex::Verify(size_t sample)
+{
+    std::vector<std::pair<std::string, FileIdentity>> chosen;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (const auto &[key, entry] : entries)
+        {
+            chosen.emplace_back(key, entry.identity);
+        }
+    }
+
+    if (sample > 0 && sample < chosen.size())
+    {
+        std::vector<std::pair<std::string, FileIdentity>> picked;
+        std::sample(
+            chosen.begin(), chosen.end(), std::back_inserter(picked), sample, std::mt19937(std::random_device()()));
+        chosen = std::move(picked);
+    }
+
+    IndexVerification report;
+
+    for (const auto &[key, identity] : chosen)
+    {
+        const auto args = splitArguments(key);
+        const auto current = IdentifyFile(args.back());
+        std::optional<nlohmann::ordered_json> document;
+
+        ++report.checked;
+
+        if (current && *current == identity)
+        {
+            try
+            {
+                document = parse(invoke(args));
+            }
+            catch (const std::exception &)
+            {
+                // An unchanged source that nstool no longer accepts, for example after a key change, counts as a
+                // mismatch and is dropped below.
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if (!current || !(*current == identity))
+        {
+            ++report.stale;
+            remove(key);
+            continue;
+        }
+
+        const auto stored = find(key, identity);
+
+        if (document && stored && *stored == *document)
+        {
+            ++report.unchanged;
+            continue;
+        }
+
+        ++report.mismatched;
+
+        if (document)
+        {
+            store(key, identity, *document);
+        }
+        else
+        {
+            remove(key);
+        }
+    }
+
+    return report;
+}
+
+IndexCompaction MetadataIndex::Compact()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    IndexCompaction report;
+    report.bytesBefore = logSize;
+
+    auto temporary = file;
+    temporary += ".compacting";
+
+    std::map<std::string, Entry> compacted;
+    uint64_t offset = headerSize;
+
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        write(out, encodeHeader());
+
+        for (const auto &[key, entry] : entries)
+        {
+            const auto record = encodeRecord(key, entry.identity, readDocument(entry));
+
+            write(out, record);
+            compacted.emplace(key, Entry{entry.identity, offset + recordOverhead + key.size(), entry.documentSize});
+            offset += record.size();
+        }
+
+        out.close();
+
+        if (!out)
+        {
+            std::filesystem::remove(temporary);
+            throw std::runtime_error("Failed to write the compacted metadata index.");
+        }
+    }
+
+    // The old log stays intact until the compacted one has been written completely, and stays open when it cannot
+    // be replaced.
+    log.close();
+
+    try
+    {
+        std::filesystem::rename(temporary, file);
+    }
+    catch (const std::exception &)
+    {
+        std::error_code ignored;
+        std::filesystem::remove(temporary, ignored);
+        reopen();
+        throw;
+    }
+
+    reopen();
+
+    entries = std::move(compacted);
+    logSize = offset;
+
+    report.entries = entries.size();
+    report.bytesAfter = logSize;
+
+    return report;
+}
+
+IndexStatistics MetadataIndex::Statistics()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return {entries.size(), logSize, hits, misses};
+}
+
+void MetadataIndex::load()
+{
+    if (!std::filesystem::exists(file))
+    {
+        std::ofstream out(file, std::ios::binary);
+        write(out, encodeHeader());
+    }
+
+    auto fileSize = std::filesystem::file_size(file);
+
+    {
+        std::ifstream in(file, std::ios::binary);
+        char header[sizeof(magic)];
+        uint32_t fileVersion = 0;
+
+        if (!in.read(header, sizeof(header)) || !std::equal(header, header + sizeof(header), magic) ||
+            !get(in, fileVersion) || (fileVersion != version && fileVersion != deviceLessVersion))
+        {
+            throw std::runtime_error("The file is not a metadata index: " + FromHostPath(file));
+        }
+
+        if (fileVersion == deviceLessVersion)
+        {
+            in.close();
+
+            std::ofstream out(file, std::ios::binary | std::ios::trunc);
+            write(out, encodeHeader());
+            fileSize = headerSize;
+        }
+
+        uint64_t offset = headerSize;
+
+        while (true)
+        {
+            uint32_t keySize = 0;
+            Entry entry;
+
+            // A size that runs past the end of the file belongs to a damaged record; nothing follows it.
+            if (!get(in, keySize) || offset + recordOverhead + keySize > fileSize)
+            {
+                break;
+            }
+
+            std::string key(keySize, '\0');
+
+            if (!in.read(key.data(), keySize) || !get(in, entry.identity.size) ||
+                !get(in, entry.identity.modified) || !get(in, entry.identity.inode) ||
+                !get(in, entry.identity.device) || !get(in, entry.documentSize))
+            {
+                break;
+            }
+
+            entry.documentOffset = offset + recordOverhead + keySize;
+
+            if (entry.documentOffset + entry.documentSize > fileSize)
+            {
+                break;
+            }
+
+            in.seekg(static_cast<std::streamoff>(entry.documentOffset + entry.documentSize));
+            offset = entry.documentOffset + entry.documentSize;
+
+            if (entry.documentSize == 0)
+            {
+                entries.erase(key);
+            }
+            else
+            {
+                entries.insert_or_assign(std::move(key), entry);
+            }
+        }
+
+        logSize = offset;
+    }
+
+    // Drop a record that was cut short, so that the next one is appended where it started.
+    if (logSize < fileSize)
+    {
+        std::filesystem::resize_file(file, logSize);
+    }
+
+    reopen();
+}
+
+void MetadataIndex::reopen()
+{
+    log.clear();
+    log.open(file, std::ios::in | std::ios::out | std::ios::binary);
+
+    if (!log)
+    {
+        throw std::runtime_error("Failed to open the metadata index: " + FromHostPath(file));
+    }
+}
+
+std::optional<nlohmann::ordered_json> MetadataIndex::find(const std::string &key, const FileIdentity &identity)
+{
+    const auto entry = entries.find(key);
+
+    if (entry == entries.end() || !(entry->second.identity == identity))
+    {
+        return std::nullopt;
+    }
+
+    return nlohmann::ordered_json::from_cbor(readDocument(entry->second));
+}
+
+void MetadataIndex::store(const std::string &key, const FileIdentity &identity, const nlohmann::ordered_json &document)
+{
+    entries.insert_or_assign(key, append(key, identity, nlohmann::ordered_json::to_cbor(document)));
+}
+
+void MetadataIndex::remove(const std::string &key)
+{
+    if (entries.erase(key) != 0)
+    {
+        append(key, {}, {});
+    }
+}
+
+std::vector<uint8_t> MetadataIndex::readDocument(const Entry &entry)
+{
+    std::vector<uint8_t> document(entry.documentSize);
+
+    log.clear();
+    log.seekg(static_cast<std::streamoff>(entry.documentOffset));
+
+    if (!log.read(reinterpret_cast<char *>(document.data()), static_cast<std::streamsize>(document.size())))
+    {
+        throw std::runtime_error("Failed to read from the metadata index.");
+    }
+
+    return document;
+}
+
+MetadataIndex::Entry MetadataIndex::append(
+    const std::string &key, const FileIdentity &identity, const std::vector<uint8_t> &document)
+{
+    const auto record = encodeRecord(key, identity, document);
+
+    log.clear();
+    log.seekp(static_cast<std::streamoff>(logSize));
+    write(log, record);
+    log.flush();
+
+    if (!log)
+    {
+        throw std::runtime_error("Failed to write to the metadata index.");
+    }
+
+    const Entry entry = {identity, logSize + recordOverhead + key.size(), static_cast<uint32_t>(document.size())};
+    logSize += record.size();
+
+    return entry;
+}
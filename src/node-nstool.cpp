@@ -1,7 +1,25 @@
-#include <iostream>
+#include "addon-data.h"
+#include "batch.h"
+#include "block-cache.h"
+#include "crypto-backend.h"
+#include "event-stream.h"
+#include "cancellation.h"
+#include "index-handle.h"
+#include "json-value.h"
+#include "key-cache.h"
+#include "node-nstool.h"
+#include "nstool-session.h"
+#include "output-sink.h"
+#include "package.h"
+#include "scan.h"
+#include "split-source.h"
+#include "verify.h"
 #include <napi.h>
-#include <sstream>
+#include <exception>
+#include <istream>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 #define FMT_HEADER_ONLY
 #include <fmt/core.h>
@@ -20,46 +38,296 @@ std::vector<std::string> BuildParameters(const Napi::CallbackInfo &info)
     return parameters;
 }
 
-std::string start(const std::vector<std::string> &args, Napi::Env env)
+std::string invoke(const std::vector<std::string> &args, const std::shared_ptr<const CancellationToken> &cancellation)
+{
+    auto session = SessionFor(args, cancellation);
+
+    return invoke(session);
+}
+
+std::string invoke(NstoolSession &session)
 {
     const std::vector<std::string> runtimeEnvironment = {"prod"};
-    std::ostringstream output;
-    auto *originalBuffer = std::cout.rdbuf(output.rdbuf());
+    OutputSink output;
+    int result = 0;
+
+    {
+        // Everything this thread writes to std::cout lands in this call's sink, so invocations on other threads
+        // can run at the same time without interleaving.
+        ScopedOutputSink scope(output);
+        ScopedNstoolSession bound(&session);
+
+        try
+        {
+            result = umain(session.args, runtimeEnvironment);
+        }
+        catch (const OperationCancelled &)
+        {
+            throw;
+        }
+        catch (const std::exception &error)
+        {
+            throw std::runtime_error(error.what());
+        }
+    }
+
+    // nstool may have reported the cancellation as an error of its own instead of letting it through.
+    if (session.cancellation)
+    {
+        session.cancellation->ThrowIfCancelled();
+    }
 
+    if (result != 0)
+    {
+        const auto message = output.take();
+        throw std::runtime_error(message.empty() ? "nstool exited with a non-zero status." : message);
+    }
+
+    return output.take();
+}
+
+nlohmann::ordered_json invokeStreaming(
+    const std::vector<std::string> &args,
+    const std::function<void(nlohmann::ordered_json &&event)> &onEvent,
+    const std::shared_ptr<const CancellationToken> &cancellation)
+{
+    const std::vector<std::string> runtimeEnvironment = {"prod"};
+    auto session = SessionFor(args, cancellation);
+    OutputPipe output;
+    nlohmann::ordered_json document;
+    std::exception_ptr parseError;
     int result = 0;
 
+    std::thread parser(
+        [&]()
+        {
+            try
+            {
+                PipeReader reader(output);
+                std::istream input(&reader);
+
+                document = ParseWithEventStream(input, onEvent);
+            }
+            catch (...)
+            {
+                parseError = std::current_exception();
+            }
+
+            // Lets nstool finish even when its output could not be parsed.
+            output.CloseReader();
+        });
+
     try
     {
-        result = umain(args, runtimeEnvironment);
+        ScopedOutputSink scope(output);
+        ScopedNstoolSession bound(&session);
+        result = umain(session.args, runtimeEnvironment);
+    }
+    catch (const OperationCancelled &)
+    {
+        output.CloseWriter();
+        parser.join();
+        throw;
     }
     catch (const std::exception &error)
     {
-        std::cout.rdbuf(originalBuffer);
-        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
-        return "";
+        output.CloseWriter();
+        parser.join();
+        throw std::runtime_error(error.what());
     }
 
-    std::cout.rdbuf(originalBuffer);
+    output.CloseWriter();
+    parser.join();
+
+    if (session.cancellation)
+    {
+        session.cancellation->ThrowIfCancelled();
+    }
 
     if (result != 0)
     {
-        const auto message = output.str();
-        Napi::Error::New(env, message.empty() ? "nstool exited with a non-zero status." : message)
-            .ThrowAsJavaScriptException();
+        const auto message = output.Head();
+        throw std::runtime_error(message.empty() ? "nstool exited with a non-zero status." : message);
+    }
+
+    if (parseError)
+    {
+        std::rethrow_exception(parseError);
+    }
+
+    return document;
+}
+
+std::string start(const std::vector<std::string> &args, Napi::Env env)
+{
+    try
+    {
+        return invoke(args);
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
         return "";
     }
+}
+
+nlohmann::ordered_json parse(std::string &&output)
+{
+    auto document = nlohmann::ordered_json::parse(output);
+    output = std::string();
+
+    return document;
+}
 
-    return output.str();
+Napi::Value startObject(const std::vector<std::string> &args, Napi::Env env)
+{
+    try
+    {
+        return ParseToJavaScript(env, invoke(args));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
 }
 
+// Executes nstool on the libuv threadpool and settles a promise with its output. When asked for an object the JSON
+// is parsed straight into JavaScript values on the main thread, without a document in between.
+class RunWorker : public Napi::AsyncWorker
+{
+public:
+    RunWorker(
+        Napi::Env env,
+        std::vector<std::string> args,
+        bool asObject,
+        std::shared_ptr<const CancellationToken> cancellation)
+        : Napi::AsyncWorker(env), args(std::move(args)), asObject(asObject), cancellation(std::move(cancellation)),
+          deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            output = invoke(args, cancellation);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        if (!asObject)
+        {
+            deferred.Resolve(Napi::String::New(Env(), output));
+            return;
+        }
+
+        try
+        {
+            deferred.Resolve(ParseToJavaScript(Env(), output));
+        }
+        catch (const std::exception &error)
+        {
+            deferred.Reject(Napi::Error::New(Env(), error.what()).Value());
+        }
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::vector<std::string> args;
+    bool asObject;
+    std::shared_ptr<const CancellationToken> cancellation;
+    std::string output;
+    Napi::Promise::Deferred deferred;
+};
+
 Napi::String Run(const Napi::CallbackInfo &info)
 {
     return Napi::String::New(info.Env(), start(BuildParameters(info), info.Env()));
 }
 
+Napi::Value RunObject(const Napi::CallbackInfo &info)
+{
+    return startObject(BuildParameters(info), info.Env());
+}
+
+// runAsync(...args, cancellation?) and runObjectAsync(...args, cancellation?): a Cancellation object after the
+// arguments stops the run at its next read of the source.
+Napi::Promise queueRun(const Napi::CallbackInfo &info, bool asObject)
+{
+    auto args = BuildParameters(info);
+    std::shared_ptr<const CancellationToken> cancellation;
+
+    if (info.Length() > 0 && info[info.Length() - 1].IsObject())
+    {
+        cancellation = Cancellation::TokenFrom(info[info.Length() - 1]);
+        args.pop_back();
+    }
+
+    auto *worker = new RunWorker(info.Env(), std::move(args), asObject, std::move(cancellation));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Promise RunAsync(const Napi::CallbackInfo &info)
+{
+    return queueRun(info, false);
+}
+
+Napi::Promise RunObjectAsync(const Napi::CallbackInfo &info)
+{
+    return queueRun(info, true);
+}
+
+Napi::Value ReloadKeys(const Napi::CallbackInfo &info)
+{
+    KeyCache::Instance().Clear();
+
+    return info.Env().Undefined();
+}
+
 Napi::Object InitAll(Napi::Env env, Napi::Object exports)
 {
+    env.SetInstanceData(new AddonData());
+
     exports.Set("run", Napi::Function::New(env, Run));
+    exports.Set("runAsync", Napi::Function::New(env, RunAsync));
+    exports.Set("runObject", Napi::Function::New(env, RunObject));
+    exports.Set("runObjectAsync", Napi::Function::New(env, RunObjectAsync));
+    exports.Set("runStreamingAsync", Napi::Function::New(env, RunStreamingAsync));
+    exports.Set("informationBatch", Napi::Function::New(env, InformationBatch));
+    exports.Set("scan", Napi::Function::New(env, Scan));
+    exports.Set("verify", Napi::Function::New(env, Verify));
+    exports.Set("splitParts", Napi::Function::New(env, SplitParts));
+    exports.Set("reloadKeys", Napi::Function::New(env, ReloadKeys));
+    exports.Set("cryptoBackend", Napi::Function::New(env, CryptoBackend));
+    exports.Set("cipherBenchmark", Napi::Function::New(env, CipherBenchmark));
+    exports.Set("hashBenchmark", Napi::Function::New(env, HashBenchmark));
+    exports.Set("configureBlockCache", Napi::Function::New(env, ConfigureBlockCache));
+    exports.Set("clearBlockCache", Napi::Function::New(env, ClearBlockCache));
+    exports.Set("blockCacheStats", Napi::Function::New(env, BlockCacheStats));
+    exports.Set("Package", Package::Define(env));
+    exports.Set("PackageReader", PackageReader::Define(env));
+    exports.Set("MetadataIndex", IndexHandle::Define(env));
+    exports.Set("Cancellation", Cancellation::Define(env));
 
     return exports;
 }
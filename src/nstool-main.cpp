@@ -0,0 +1,155 @@
+// nstool's main.cpp, compiled with its input opened through the session bound to the thread, which also keeps the
+// filesystem the run mounted. binding.cjs leaves the original out of the build so that it is only compiled here.
+#include "GameCardProcess.h"
+#include "NcaProcess.h"
+#include "PfsProcess.h"
+#include "RomfsProcess.h"
+#include "Settings.h"
+#include "cancellation.h"
+#include "container.h"
+#include "nstool-session.h"
+#include "offset-probe.h"
+#include <exception>
+#include <tc.h>
+
+namespace tc::io
+{
+
+// Stands in for FileStream inside main.cpp, where it only opens the input. With a session that has a container, the
+// input is the container's source, which joins the parts of a split dump and uses the selected input backend, below
+// an offset probe, as when the container mounts it itself. Otherwise the named file is opened as before. Every read
+// checks the session's cancellation token first, so an aborted run stops at its next read wherever nstool happens to
+// be.
+class SessionFileStream : public IStream
+{
+public:
+    SessionFileStream(const Path &path, FileMode mode, FileAccess access)
+    {
+        const auto *session = CurrentNstoolSession();
+
+        if (session != nullptr)
+        {
+            cancellation = session->cancellation;
+        }
+
+        if (session != nullptr && session->container)
+        {
+            inner = std::make_shared<OffsetProbeStream>(session->container->OpenSource());
+            return;
+        }
+
+        inner = std::make_shared<FileStream>(path, mode, access);
+    }
+
+    bool canRead() const override
+    {
+        return inner->canRead();
+    }
+
+    bool canWrite() const override
+    {
+        return inner->canWrite();
+    }
+
+    bool canSeek() const override
+    {
+        return inner->canSeek();
+    }
+
+    int64_t length() override
+    {
+        return inner->length();
+    }
+
+    int64_t position() override
+    {
+        return inner->position();
+    }
+
+    size_t read(byte_t *ptr, size_t count) override
+    {
+        if (cancellation)
+        {
+            cancellation->ThrowIfCancelled();
+        }
+
+        return inner->read(ptr, count);
+    }
+
+    size_t write(const byte_t *ptr, size_t count) override
+    {
+        return inner->write(ptr, count);
+    }
+
+    int64_t seek(int64_t offset, SeekOrigin origin) override
+    {
+        return inner->seek(offset, origin);
+    }
+
+    void setLength(int64_t length) override
+    {
+        inner->setLength(length);
+    }
+
+    void flush() override
+    {
+        inner->flush();
+    }
+
+    void dispose() override
+    {
+        inner->dispose();
+    }
+
+private:
+    std::shared_ptr<IStream> inner;
+    std::shared_ptr<const CancellationToken> cancellation;
+};
+
+} // namespace tc::io
+
+namespace nstool
+{
+
+// Stands in for a process inside main.cpp and hands the filesystem it mounted to the session once the run is done
+// with it. A process that failed keeps nothing.
+template <typename Process> class RetainedProcess : public Process
+{
+public:
+    ~RetainedProcess()
+    {
+        auto *session = CurrentNstoolSession();
+
+        if (session == nullptr || session->fileSystem || std::uncaught_exceptions() != 0)
+        {
+            return;
+        }
+
+        try
+        {
+            session->fileSystem = this->getFileSystem();
+        }
+        catch (...)
+        {
+        }
+    }
+};
+
+using RetainedGameCardProcess = RetainedProcess<GameCardProcess>;
+using RetainedNcaProcess = RetainedProcess<NcaProcess>;
+using RetainedPfsProcess = RetainedProcess<PfsProcess>;
+using RetainedRomfsProcess = RetainedProcess<RomfsProcess>;
+
+} // namespace nstool
+
+#define FileStream SessionFileStream
+#define GameCardProcess RetainedGameCardProcess
+#define NcaProcess RetainedNcaProcess
+#define PfsProcess RetainedPfsProcess
+#define RomfsProcess RetainedRomfsProcess
+#include "../deps/nstool/src/main.cpp"
+#undef RomfsProcess
+#undef PfsProcess
+#undef NcaProcess
+#undef GameCardProcess
+#undef FileStream
@@ -0,0 +1,166 @@
+// nstool's NcaProcess.cpp, compiled with the sections it mounts read through the block cache while a block source is
+// bound to the thread, read without their hash layers while a trusted container is mounting, and located by offset
+// probes. binding.cjs leaves the original out of the build so that it is only compiled here.
+#include "NcaProcess.h"
+#include "block-cache.h"
+#include "container.h"
+#include "offset-probe.h"
+#include <pietendo/hac/HierarchicalIntegrityStream.h>
+#include <pietendo/hac/HierarchicalSha256Stream.h>
+#include <pietendo/hac/PartitionFsSnapshotGenerator.h>
+#include <pietendo/hac/RomFsSnapshotGenerator.h>
+#include <utility>
+
+namespace
+{
+// Where the data of the section being mounted starts: the offset of the section within the archive and that of its
+// data layer within the section.
+thread_local int64_t mountingSectionOffset = 0;
+thread_local int64_t mountingDataOffset = 0;
+} // namespace
+
+namespace tc::io
+{
+
+// Stands in for tc::io::SubStream inside NcaProcess.cpp, which opens each section as a window into the archive just
+// before decrypting it and building its snapshot. Telling the block source where the window starts lets the cache
+// name the section by its number in the header, and the offset probe of the section starts from it.
+struct MountedSubStream : public SubStream
+{
+    MountedSubStream() = default;
+
+    MountedSubStream(const std::shared_ptr<IStream> &stream, int64_t offset, int64_t length)
+        : SubStream(stream, offset, length)
+    {
+        mountingSectionOffset = offset;
+        mountingDataOffset = 0;
+        MountingSection(*stream, offset);
+    }
+};
+
+} // namespace tc::io
+
+namespace pie::hac
+{
+
+// Stands in for a snapshot generator inside NcaProcess.cpp. The generator reads the tables of the filesystem from
+// the decrypted section, and every file of the snapshot is a window into it, so caching the section caches both. The
+// offset probe above the cache finds where a file starts within the archive without decrypting any of it.
+template <typename Generator> struct SectionSnapshotGenerator : public Generator
+{
+    template <typename... Options>
+    SectionSnapshotGenerator(const std::shared_ptr<tc::io::IStream> &section, Options &&...options)
+        : Generator(
+              std::make_shared<OffsetProbeStream>(CacheSection(section), mountingSectionOffset + mountingDataOffset),
+              std::forward<Options>(options)...)
+    {
+    }
+};
+
+using SectionPartitionFsSnapshotGenerator = SectionSnapshotGenerator<PartitionFsSnapshotGenerator>;
+using SectionRomFsSnapshotGenerator = SectionSnapshotGenerator<RomFsSnapshotGenerator>;
+
+// Stands in for a hash layer stream inside NcaProcess.cpp. While a trusted container is mounting, the section is read
+// straight from its data layer, the last one the header describes, so no hash level is read or checked. Otherwise it
+// is the hash layer stream itself.
+template <typename Verified, typename Header> class TrustableStream : public tc::io::IStream
+{
+public:
+    TrustableStream(const std::shared_ptr<tc::io::IStream> &stream, const Header &header)
+        : inner(open(stream, header))
+    {
+    }
+
+    bool canRead() const override
+    {
+        return inner->canRead();
+    }
+
+    bool canWrite() const override
+    {
+        return inner->canWrite();
+    }
+
+    bool canSeek() const override
+    {
+        return inner->canSeek();
+    }
+
+    int64_t length() override
+    {
+        return inner->length();
+    }
+
+    int64_t position() override
+    {
+        return inner->position();
+    }
+
+    size_t read(byte_t *ptr, size_t count) override
+    {
+        return inner->read(ptr, count);
+    }
+
+    size_t write(const byte_t *ptr, size_t count) override
+    {
+        return inner->write(ptr, count);
+    }
+
+    int64_t seek(int64_t offset, tc::io::SeekOrigin origin) override
+    {
+        return inner->seek(offset, origin);
+    }
+
+    void setLength(int64_t length) override
+    {
+        inner->setLength(length);
+    }
+
+    void flush() override
+    {
+        inner->flush();
+    }
+
+    void dispose() override
+    {
+        inner->dispose();
+    }
+
+private:
+    static std::shared_ptr<tc::io::IStream> open(const std::shared_ptr<tc::io::IStream> &stream, const Header &header)
+    {
+        const auto &layers = header.getLayerInfo();
+
+        if (!layers.empty())
+        {
+            mountingDataOffset = layers.back().offset;
+        }
+
+        if (!MountingTrusted() || layers.empty())
+        {
+            return std::make_shared<Verified>(stream, header);
+        }
+
+        return std::make_shared<tc::io::SubStream>(stream, layers.back().offset, layers.back().size);
+    }
+
+    std::shared_ptr<tc::io::IStream> inner;
+};
+
+using TrustableHierarchicalSha256Stream = TrustableStream<HierarchicalSha256Stream, HierarchicalSha256Header>;
+using TrustableHierarchicalIntegrityStream =
+    TrustableStream<HierarchicalIntegrityStream, HierarchicalIntegrityHeader>;
+
+} // namespace pie::hac
+
+#define SubStream MountedSubStream
+#define HierarchicalSha256Stream TrustableHierarchicalSha256Stream
+#define HierarchicalIntegrityStream TrustableHierarchicalIntegrityStream
+#define PartitionFsSnapshotGenerator SectionPartitionFsSnapshotGenerator
+#define RomFsSnapshotGenerator SectionRomFsSnapshotGenerator
+#include "../deps/nstool/src/NcaProcess.cpp"
+#undef RomFsSnapshotGenerator
+#undef PartitionFsSnapshotGenerator
+#undef HierarchicalIntegrityStream
+#undef HierarchicalSha256Stream
+#undef SubStream
@@ -0,0 +1,44 @@
+#include "nstool-session.h"
+
+#include "container.h"
+#include "split-source.h"
+
+namespace
+{
+thread_local NstoolSession *currentSession = nullptr;
+} // namespace
+
+NstoolSession SessionFor(const std::vector<std::string> &args, std::shared_ptr<const CancellationToken> cancellation)
+{
+    NstoolSession session = {args, nullptr, nullptr, std::move(cancellation)};
+
+    if (args.size() < 2)
+    {
+        return session;
+    }
+
+    const auto parts = FindSplitParts(args.back());
+
+    if (parts.size() > 1 || parts.front() != args.back())
+    {
+        session.container = Container::Open(args, {InputBackend::Stream, AccessPattern::Normal, parts});
+        session.args.back() = parts.front();
+    }
+
+    return session;
+}
+
+ScopedNstoolSession::ScopedNstoolSession(NstoolSession *session) : previous(currentSession)
+{
+    currentSession = session;
+}
+
+ScopedNstoolSession::~ScopedNstoolSession()
+{
+    currentSession = previous;
+}
+
+NstoolSession *CurrentNstoolSession()
+{
+    return currentSession;
+}
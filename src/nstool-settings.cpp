@@ -0,0 +1,39 @@
+// nstool's Settings.cpp, compiled with its key bag coming from the KeyCache while a session is bound to the thread.
+// binding.cjs leaves the original out of the build so that it is only compiled here.
+#include "KeyBag.h"
+#include "Settings.h"
+#include "key-cache.h"
+#include "nstool-session.h"
+
+namespace nstool
+{
+
+// Stands in for KeyBagInitializer inside Settings.cpp. With a session the key bag for its arguments comes from the
+// KeyCache, which only parses the key files and derives the keys again when one of them has changed. Without one,
+// including while the KeyCache itself is loading, nstool's own initializer runs.
+struct CachedKeyBagInitializer : public KeyBag
+{
+    template <typename... Paths>
+    CachedKeyBagInitializer(bool isDev, const Paths &...paths) : KeyBag(load(isDev, paths...))
+    {
+    }
+
+private:
+    template <typename... Paths> static KeyBag load(bool isDev, const Paths &...paths)
+    {
+        const auto *session = CurrentNstoolSession();
+
+        if (session == nullptr)
+        {
+            return KeyBagInitializer(isDev, paths...);
+        }
+
+        return KeyCache::Instance().Get(session->args);
+    }
+};
+
+} // namespace nstool
+
+#define KeyBagInitializer CachedKeyBagInitializer
+#include "../deps/nstool/src/Settings.cpp"
+#undef KeyBagInitializer
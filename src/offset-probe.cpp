@@ -0,0 +1,121 @@
+#include "offset-probe.h"
+
+#include <utility>
+
+namespace
+{
+const std::string moduleName = "OffsetProbeStream";
+
+// The probe on the calling thread: whether one is active, and the offset it found.
+struct Probe
+{
+    bool active = false;
+    std::optional<int64_t> offset;
+};
+
+thread_local Probe probe;
+} // namespace
+
+OffsetProbeStream::OffsetProbeStream(std::shared_ptr<tc::io::IStream> inner, int64_t base)
+    : inner(std::move(inner)), base(base)
+{
+}
+
+bool OffsetProbeStream::canRead() const
+{
+    return inner != nullptr && inner->canRead();
+}
+
+bool OffsetProbeStream::canWrite() const
+{
+    return inner != nullptr && inner->canWrite();
+}
+
+bool OffsetProbeStream::canSeek() const
+{
+    return inner != nullptr && inner->canSeek();
+}
+
+int64_t OffsetProbeStream::length()
+{
+    if (!inner)
+    {
+        throw tc::ObjectDisposedException(moduleName, "The stream has been disposed.");
+    }
+
+    return inner->length();
+}
+
+int64_t OffsetProbeStream::position()
+{
+    if (!inner)
+    {
+        throw tc::ObjectDisposedException(moduleName, "The stream has been disposed.");
+    }
+
+    return inner->position();
+}
+
+size_t OffsetProbeStream::read(byte_t *ptr, size_t count)
+{
+    if (!probe.active)
+    {
+        return inner->read(ptr, count);
+    }
+
+    // Only the outermost probe counts; the ones below it belong to the container this one is read from.
+    if (!probe.offset)
+    {
+        probe.offset = base + position();
+    }
+
+    return 0;
+}
+
+size_t OffsetProbeStream::write(const byte_t *ptr, size_t count)
+{
+    return inner->write(ptr, count);
+}
+
+int64_t OffsetProbeStream::seek(int64_t offset, tc::io::SeekOrigin origin)
+{
+    return inner->seek(offset, origin);
+}
+
+void OffsetProbeStream::setLength(int64_t length)
+{
+    inner->setLength(length);
+}
+
+void OffsetProbeStream::flush()
+{
+    inner->flush();
+}
+
+void OffsetProbeStream::dispose()
+{
+    if (inner)
+    {
+        inner->dispose();
+        inner.reset();
+    }
+}
+
+std::optional<int64_t> ProbeDataOffset(tc::io::IStream &file)
+{
+    byte_t first = 0;
+    const auto previous = std::exchange(probe, Probe{true, std::nullopt});
+
+    try
+    {
+        file.seek(0, tc::io::SeekOrigin::Begin);
+        file.read(&first, 1);
+    }
+    catch (...)
+    {
+        probe = previous;
+        throw;
+    }
+
+    return std::exchange(probe, previous).offset;
+}
@@ -0,0 +1,166 @@
+#include "output-sink.h"
+
+#include "nstool-output.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// The real standard output; everything else in the addon sees the per-thread stream under that name.
+#undef cout
+
+namespace
+{
+
+constexpr size_t headSize = 64 * 1024;
+
+thread_local std::ostream *currentStream = nullptr;
+
+} // namespace
+
+std::ostream &NstoolOutput()
+{
+    return currentStream != nullptr ? *currentStream : std::cout;
+}
+
+void OutputSink::write(const char *data, size_t size)
+{
+    buffer.write(data, static_cast<std::streamsize>(size));
+}
+
+std::string OutputSink::take()
+{
+    return std::move(buffer).str();
+}
+
+OutputPipe::OutputPipe(size_t capacity) : capacity(capacity)
+{
+}
+
+void OutputPipe::write(const char *data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if (head.size() < headSize)
+    {
+        head.append(data, std::min(size, headSize - head.size()));
+    }
+
+    while (size > 0)
+    {
+        writable.wait(lock, [this]() { return readerClosed || pending.size() - readOffset < capacity; });
+
+        if (readerClosed)
+        {
+            return;
+        }
+
+        const auto count = std::min(size, capacity - (pending.size() - readOffset));
+
+        pending.append(data, count);
+        data += count;
+        size -= count;
+        readable.notify_one();
+    }
+}
+
+size_t OutputPipe::Read(char *data, size_t size)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    readable.wait(lock, [this]() { return writerClosed || readOffset < pending.size(); });
+
+    const auto count = std::min(size, pending.size() - readOffset);
+
+    std::memcpy(data, pending.data() + readOffset, count);
+    readOffset += count;
+
+    // Drop what has been read once it outweighs what is still pending, so the buffer stays within capacity.
+    if (readOffset >= pending.size() - readOffset)
+    {
+        pending.erase(0, readOffset);
+        readOffset = 0;
+    }
+
+    writable.notify_one();
+
+    return count;
+}
+
+void OutputPipe::CloseWriter()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    writerClosed = true;
+    readable.notify_all();
+}
+
+void OutputPipe::CloseReader()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    readerClosed = true;
+    pending.clear();
+    readOffset = 0;
+    writable.notify_all();
+}
+
+std::string OutputPipe::Head()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return head;
+}
+
+PipeReader::PipeReader(OutputPipe &pipe) : pipe(pipe)
+{
+}
+
+PipeReader::int_type PipeReader::underflow()
+{
+    const auto count = pipe.Read(buffer, sizeof(buffer));
+
+    if (count == 0)
+    {
+        return traits_type::eof();
+    }
+
+    setg(buffer, buffer, buffer + count);
+
+    return traits_type::to_int_type(buffer[0]);
+}
+
+SinkBuffer::SinkBuffer(OutputSink &sink) : sink(sink)
+{
+}
+
+SinkBuffer::int_type SinkBuffer::overflow(int_type character)
+{
+    if (traits_type::eq_int_type(character, traits_type::eof()))
+    {
+        return traits_type::not_eof(character);
+    }
+
+    const char value = traits_type::to_char_type(character);
+
+    sink.write(&value, 1);
+
+    return character;
+}
+
+std::streamsize SinkBuffer::xsputn(const char *data, std::streamsize size)
+{
+    sink.write(data, static_cast<size_t>(size));
+
+    return size;
+}
+
+ScopedOutputSink::ScopedOutputSink(OutputSink &sink) : buffer(sink), stream(&buffer), previous(currentStream)
+{
+    // Every insertion is flushed to the sink as it is made, so a pipe hands nstool's output on while it is written.
+    stream.setf(std::ios::unitbuf);
+    currentStream = &stream;
+}
+
+ScopedOutputSink::~ScopedOutputSink()
+{
+    currentStream = previous;
+}
@@ -0,0 +1,259 @@
+#include "package-fs.h"
+#include "offset-probe.h"
+#include <algorithm>
+
+namespace
+{
+// The identity of the source, combined over the parts of a split dump: their total size, the latest modification
+// time and the inode and device of the first part. Nothing when a part cannot be examined.
+std::optional<FileIdentity> sourceIdentity(const Container &container)
+{
+    std::optional<FileIdentity> combined;
+
+    for (const auto &part : container.Parts())
+    {
+        const auto identity = IdentifyFile(part);
+
+        if (!identity)
+        {
+            return std::nullopt;
+        }
+
+        if (!combined)
+        {
+            combined = identity;
+            continue;
+        }
+
+        combined->size += identity->size;
+        combined->modified = std::max(combined->modified, identity->modified);
+    }
+
+    return combined;
+}
+} // namespace
+
+PackageFileSystem::PackageFileSystem(std::shared_ptr<const Container> container, bool cached)
+    : container(std::move(container)), cached(cached)
+{
+    auto source = cached ? ArchiveBlockSource(*this->container, "/") : std::nullopt;
+    ScopedBlockSource scope(source ? &*source : nullptr);
+
+    root = this->container->Mount();
+}
+
+PackageFileSystem::PackageFileSystem(
+    std::shared_ptr<const Container> container, std::shared_ptr<tc::io::IFileSystem> root, bool cached)
+    : container(std::move(container)), root(std::move(root)), cached(cached)
+{
+}
+
+std::shared_ptr<tc::io::IStream> PackageFileSystem::OpenFile(const std::string &path)
+{
+    const auto location = resolve(path, false);
+    std::shared_ptr<tc::io::IStream> stream;
+
+    location.fileSystem->openFile(location.path, tc::io::FileMode::Open, tc::io::FileAccess::Read, stream);
+
+    return stream;
+}
+
+void PackageFileSystem::ListDirectory(const std::string &path, tc::io::sDirectoryListing &listing)
+{
+    const auto location = resolve(path, true);
+
+    location.fileSystem->getDirectoryListing(location.path, listing);
+}
+
+std::optional<int64_t> PackageFileSystem::DataOffset(const std::string &path)
+{
+    const auto parts = SplitVirtualPath(path);
+
+    if (parts.empty())
+    {
+        return std::nullopt;
+    }
+
+    // Mounts every nested container on the path.
+    resolve(path, false);
+
+    auto *fileSystem = root.get();
+    std::string key;
+    std::string relative;
+    int64_t offset = 0;
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        key += "/" + parts[i];
+        relative += "/" + parts[i];
+
+        const auto found = i + 1 < parts.size() ? nested.find(key) : nested.end();
+
+        if (i + 1 < parts.size() && found == nested.end())
+        {
+            continue;
+        }
+
+        auto known = nestedOffsets.find(key);
+        std::optional<int64_t> within;
+
+        if (known != nestedOffsets.end())
+        {
+            within = known->second;
+        }
+        else
+        {
+            std::shared_ptr<tc::io::IStream> stream;
+
+            fileSystem->openFile(tc::io::Path(relative), tc::io::FileMode::Open, tc::io::FileAccess::Read, stream);
+            within = ProbeDataOffset(*stream);
+
+            if (found != nested.end())
+            {
+                nestedOffsets.emplace(key, within);
+            }
+        }
+
+        if (!within)
+        {
+            return std::nullopt;
+        }
+
+        offset += *within;
+
+        if (found != nested.end())
+        {
+            fileSystem = found->second.get();
+            relative.clear();
+        }
+    }
+
+    return offset;
+}
+
+const std::shared_ptr<const Container> &PackageFileSystem::GetContainer() const
+{
+    return container;
+}
+
+PackageFileSystem::Location PackageFileSystem::resolve(const std::string &path, bool descendIntoLast)
+{
+    const auto parts = SplitVirtualPath(path);
+
+    auto *fileSystem = root.get();
+    std::string mountPath;
+    std::string relative;
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        relative += "/" + parts[i];
+
+        if (i + 1 == parts.size() && !descendIntoLast)
+        {
+            break;
+        }
+
+        const auto key = mountPath + relative;
+        auto found = nested.find(key);
+
+        if (found == nested.end())
+        {
+            if (!Container::IsContainerName(parts[i]))
+            {
+                continue;
+            }
+
+            std::shared_ptr<tc::io::IStream> stream;
+
+            try
+            {
+                fileSystem->openFile(
+                    tc::io::Path(relative), tc::io::FileMode::Open, tc::io::FileAccess::Read, stream);
+            }
+            catch (const tc::io::IOException &)
+            {
+                // A directory whose name merely looks like a container.
+                continue;
+            }
+
+            auto source = cached ? ArchiveBlockSource(*container, key) : std::nullopt;
+            ScopedBlockSource scope(source ? &*source : nullptr);
+
+            found = nested.emplace(key, container->MountNested(stream, parts[i])).first;
+        }
+
+        fileSystem = found->second.get();
+        mountPath = key;
+        relative.clear();
+    }
+
+    return {fileSystem, tc::io::Path(relative.empty() ? "/" : relative)};
+}
+
+std::optional<BlockSource> ArchiveBlockSource(const Container &container, const std::string &path)
+{
+    // Blocks read past the hash layers of a trusted container must never be served to one that checks them.
+    if (!BlockCache::Instance().Enabled() || container.Trusted())
+    {
+        return std::nullopt;
+    }
+
+    const auto identity = sourceIdentity(container);
+
+    if (!identity)
+    {
+        return std::nullopt;
+    }
+
+    return BlockSource{*identity, container.KeyFingerprint(), path, &container.Keys(), {}, -1};
+}
+
+size_t ReadAt(tc::io::IStream &stream, int64_t offset, byte_t *destination, size_t size)
+{
+    stream.seek(offset, tc::io::SeekOrigin::Begin);
+
+    size_t total = 0;
+
+    while (total < size)
+    {
+        const auto count = stream.read(destination + total, size - total);
+
+        if (count == 0)
+        {
+            break;
+        }
+
+        total += count;
+    }
+
+    return total;
+}
+
+std::vector<std::string> SplitVirtualPath(const std::string &path)
+{
+    std::vector<std::string> parts;
+    std::string part;
+
+    for (const auto character : path)
+    {
+        if (character == '/' || character == '\\')
+        {
+            if (!part.empty())
+            {
+                parts.push_back(std::move(part));
+                part.clear();
+            }
+
+            continue;
+        }
+
+        part += character;
+    }
+
+    if (!part.empty())
+    {
+        parts.push_back(std::move(part));
+    }
+
+    return parts;
+}
@@ -0,0 +1,1039 @@
+#include "package.h"
+
+#include "addon-data.h"
+#include "compact-tree.h"
+#include "extract.h"
+#include "json-value.h"
+#include "node-nstool.h"
+#include "string-list.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+const nlohmann::ordered_json &information(PackageState &state)
+{
+    if (!state.information)
+    {
+        // nstool reads the package through the container, so split dumps and the mapped input backend work as well.
+        NstoolSession session = {state.args, state.container, nullptr, nullptr};
+        session.args.back() = state.container->Parts().front();
+
+        // The sections the run mounts are read through the block cache, as they may become the package's own.
+        auto source = ArchiveBlockSource(*state.container, "/");
+        ScopedBlockSource scope(source ? &*source : nullptr);
+
+        state.information = parse(invoke(session));
+
+        // The run has parsed the headers already, so a package that was not mounted yet reads through its filesystem.
+        if (!state.fileSystem && session.fileSystem)
+        {
+            state.fileSystem = std::make_unique<PackageFileSystem>(state.container, session.fileSystem, true);
+        }
+    }
+
+    return *state.information;
+}
+
+// The package's own filesystem, mounted on first use. Called with the mutex held.
+PackageFileSystem &fileSystem(PackageState &state)
+{
+    if (!state.fileSystem)
+    {
+        state.fileSystem = std::make_unique<PackageFileSystem>(state.container, true);
+    }
+
+    return *state.fileSystem;
+}
+
+// The addon options { input, access, parts, trusted }, where input is "stream" or "mmap", access is "normal",
+// "sequential" or "random", parts lists the parts of a split dump in order and trusted is a boolean.
+ContainerOptions containerOptions(const Napi::Value &value)
+{
+    ContainerOptions options;
+
+    if (!value.IsObject())
+    {
+        return options;
+    }
+
+    const auto settings = value.As<Napi::Object>();
+    const auto input = settings.Get("input");
+    const auto access = settings.Get("access");
+
+    options.parts = StringList(settings.Get("parts"));
+    options.trusted = settings.Get("trusted").ToBoolean().Value();
+
+    if (input.IsString() && input.ToString().Utf8Value() == "mmap")
+    {
+        options.input = InputBackend::Mapped;
+    }
+
+    if (access.IsString())
+    {
+        const auto pattern = access.ToString().Utf8Value();
+
+        options.access = pattern == "sequential" ? AccessPattern::Sequential
+                         : pattern == "random"   ? AccessPattern::Random
+                                                 : AccessPattern::Normal;
+    }
+
+    return options;
+}
+
+// Resolves the settings and keys of a package. Nothing is mounted until the package is first used.
+std::shared_ptr<PackageState> openPackage(std::vector<std::string> args, const ContainerOptions &options)
+{
+    auto opened = std::make_shared<PackageState>();
+
+    opened->args = std::move(args);
+    opened->container = Container::Open(opened->args, options);
+
+    return opened;
+}
+
+struct ExtractionRequest
+{
+    std::filesystem::path outputDirectory;
+    std::string path;
+    // The { files, include } of a selection, when one was given instead of a path. Patterns are expanded against the
+    // package before planning, see ExpandRomFsPatterns().
+    bool selected;
+    std::vector<std::string> files;
+    std::vector<std::string> include;
+    unsigned concurrency;
+    uint64_t chunkSize;
+};
+
+// The second argument is either a virtual path or a selection object of the form { files, include }.
+ExtractionRequest extractionRequest(const Napi::CallbackInfo &info)
+{
+    ExtractionRequest request = {
+        ToHostPath(info[0].ToString().Utf8Value()),
+        "/",
+        false,
+        {},
+        {},
+        info[2].IsUndefined() ? 1 : info[2].ToNumber().Uint32Value(),
+        info[3].IsUndefined() ? DefaultExtractionChunkSize : static_cast<uint64_t>(info[3].ToNumber().Int64Value()),
+    };
+
+    if (info[1].IsString())
+    {
+        request.path = info[1].ToString().Utf8Value();
+    }
+    else if (info[1].IsObject())
+    {
+        const auto selection = info[1].As<Napi::Object>();
+
+        request.selected = true;
+        request.files = StringList(selection.Get("files"));
+        request.include = StringList(selection.Get("include"));
+    }
+
+    return request;
+}
+
+ExtractionReport extract(PackageState &state, const ExtractionRequest &request, const ExtractionControl &control = {})
+{
+    std::vector<ExtractionJob> jobs;
+    std::shared_ptr<const Container> container;
+
+    {
+        // Only planning needs the package's own filesystem; the copy threads mount their own.
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        if (state.closed)
+        {
+            throw std::runtime_error("The package has been closed.");
+        }
+
+        auto &packageFileSystem = fileSystem(state);
+
+        jobs = request.selected
+                   ? PlanSelection(
+                         packageFileSystem,
+                         Selection(request.files, ExpandRomFsPatterns(packageFileSystem, request.include)),
+                         request.outputDirectory)
+                   : PlanExtraction(packageFileSystem, request.path, request.outputDirectory);
+        container = state.container;
+    }
+
+    return RunExtraction(container, std::move(jobs), request.concurrency, request.chunkSize, control);
+}
+
+Napi::Object reportToJavaScript(Napi::Env env, const ExtractionReport &report)
+{
+    auto files = Napi::Array::New(env, report.written.size());
+
+    for (uint32_t i = 0; i < report.written.size(); ++i)
+    {
+        files.Set(i, Napi::String::New(env, FromHostPath(report.written[i])));
+    }
+
+    auto throughput = Napi::Object::New(env);
+    throughput.Set("fileCount", Napi::Number::New(env, static_cast<double>(report.written.size())));
+    throughput.Set("bytes", Napi::Number::New(env, static_cast<double>(report.bytes)));
+    throughput.Set("seconds", Napi::Number::New(env, report.seconds));
+    throughput.Set(
+        "bytesPerSecond",
+        Napi::Number::New(env, report.seconds > 0 ? static_cast<double>(report.bytes) / report.seconds : 0));
+    throughput.Set("concurrency", Napi::Number::New(env, report.concurrency));
+    throughput.Set("chunkSize", Napi::Number::New(env, static_cast<double>(report.chunkSize)));
+
+    auto result = Napi::Object::New(env);
+    result.Set("files", files);
+    result.Set("throughput", throughput);
+    result.Set("trusted", Napi::Boolean::New(env, report.trusted));
+
+    return result;
+}
+
+// Converts an optional JavaScript length, where undefined and negative values mean "to the end of the file".
+int64_t requestedLength(const Napi::Value &value)
+{
+    return value.IsUndefined() ? -1 : std::max<int64_t>(value.ToNumber().Int64Value(), 0);
+}
+
+// Clamps a requested read to the bytes the stream actually has after offset. A negative length means "to the end".
+size_t readableLength(tc::io::IStream &stream, int64_t offset, int64_t length)
+{
+    const auto available = std::max<int64_t>(stream.length() - offset, 0);
+
+    return static_cast<size_t>(length < 0 ? available : std::min(length, available));
+}
+
+// Reads a range of a file on the libuv threadpool and resolves with a Buffer that takes over the decrypted bytes. The
+// file is either opened for this read from the package's own filesystem, or kept open by a PackageFile.
+class ReadWorker : public Napi::AsyncWorker
+{
+public:
+    ReadWorker(Napi::Env env, std::shared_ptr<PackageState> state, std::string path, int64_t offset, int64_t length)
+        : Napi::AsyncWorker(env), state(std::move(state)), path(std::move(path)), offset(offset), length(length),
+          deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    ReadWorker(Napi::Env env, std::shared_ptr<PackageFile> file, int64_t offset, int64_t length)
+        : Napi::AsyncWorker(env), state(file->package), file(std::move(file)), offset(offset), length(length),
+          deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            if (state->closed || (file && file->closed))
+            {
+                SetError("The package has been closed.");
+                return;
+            }
+
+            if (file)
+            {
+                std::lock_guard<std::mutex> lock(file->mutex);
+
+                if (!file->stream)
+                {
+                    file->fileSystem = std::make_unique<PackageFileSystem>(state->container, true);
+                    file->stream = file->fileSystem->OpenFile(file->path);
+                }
+
+                read(*file->stream);
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            read(*fileSystem(*state).OpenFile(path));
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        auto *bytes = data.release();
+
+        deferred.Resolve(
+            Napi::Buffer<uint8_t>::New(Env(), bytes, size, [](Napi::Env, uint8_t *released) { delete[] released; }));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    void read(tc::io::IStream &stream)
+    {
+        size = readableLength(stream, offset, length);
+        data = std::make_unique<byte_t[]>(size);
+        size = ReadAt(stream, offset, data.get(), size);
+    }
+
+    std::shared_ptr<PackageState> state;
+    std::shared_ptr<PackageFile> file;
+    std::string path;
+    int64_t offset;
+    int64_t length;
+    std::unique_ptr<byte_t[]> data;
+    size_t size = 0;
+    Napi::Promise::Deferred deferred;
+};
+
+Napi::Object progressToJavaScript(Napi::Env env, const ExtractionProgress &progress)
+{
+    auto result = Napi::Object::New(env);
+    result.Set("bytesDone", Napi::Number::New(env, static_cast<double>(progress.bytesDone)));
+    result.Set("bytesTotal", Napi::Number::New(env, static_cast<double>(progress.bytesTotal)));
+    result.Set("currentFile", Napi::String::New(env, progress.currentFile));
+    result.Set("filesDone", Napi::Number::New(env, static_cast<double>(progress.filesDone)));
+    result.Set("fileCount", Napi::Number::New(env, static_cast<double>(progress.fileCount)));
+
+    return result;
+}
+
+void deliverProgress(Napi::Env env, Napi::Function callback, ExtractionProgress *progress)
+{
+    if (env != nullptr && callback != nullptr)
+    {
+        callback.Call({progressToJavaScript(env, *progress)});
+    }
+
+    delete progress;
+}
+
+// The outcome of an asynchronous extraction. With a progress callback the promise is only settled once the last
+// progress update has been delivered, so no update arrives after the promise resolves.
+struct ExtractionSettlement
+{
+    explicit ExtractionSettlement(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    void Settle(Napi::Env env)
+    {
+        if (report)
+        {
+            deferred.Resolve(reportToJavaScript(env, *report));
+            return;
+        }
+
+        deferred.Reject(Napi::Error::New(env, error).Value());
+    }
+
+    Napi::Promise::Deferred deferred;
+    std::optional<ExtractionReport> report;
+    std::string error;
+};
+
+// Extracts on the libuv threadpool; the extraction itself fans out over its own threads.
+class ExtractWorker : public Napi::AsyncWorker
+{
+public:
+    ExtractWorker(
+        Napi::Env env,
+        std::shared_ptr<PackageState> state,
+        ExtractionRequest request,
+        const Napi::Value &onProgress,
+        std::shared_ptr<CancellationToken> cancellation)
+        : Napi::AsyncWorker(env), state(std::move(state)), request(std::move(request)),
+          cancellation(std::move(cancellation)), settlement(std::make_shared<ExtractionSettlement>(env))
+    {
+        if (onProgress.IsFunction())
+        {
+            // The meter limits how often updates are queued, so the queue needs no bound of its own.
+            progress = Napi::ThreadSafeFunction::New(
+                env, onProgress.As<Napi::Function>(), "nstool extraction progress", 0, 1,
+                [settlement = settlement](Napi::Env env) { settlement->Settle(env); });
+        }
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return settlement->deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        ExtractionControl control;
+        control.cancellation = cancellation;
+
+        if (progress)
+        {
+            control.onProgress = [this](const ExtractionProgress &update)
+            { progress.NonBlockingCall(new ExtractionProgress(update), deliverProgress); };
+        }
+
+        try
+        {
+            settlement->report = extract(*state, request, control);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        settle();
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        settlement->error = error.Message();
+        settle();
+    }
+
+private:
+    void settle()
+    {
+        if (progress)
+        {
+            progress.Release();
+            return;
+        }
+
+        settlement->Settle(Env());
+    }
+
+    std::shared_ptr<PackageState> state;
+    ExtractionRequest request;
+    std::shared_ptr<CancellationToken> cancellation;
+    std::shared_ptr<ExtractionSettlement> settlement;
+    Napi::ThreadSafeFunction progress;
+};
+
+template <typename T> Napi::TypedArrayOf<T> typedArray(Napi::Env env, const std::vector<T> &values)
+{
+    auto array = Napi::TypedArrayOf<T>::New(env, values.size());
+    std::copy(values.begin(), values.end(), array.Data());
+
+    return array;
+}
+
+// Every part is backed by its own ArrayBuffer, so the result can be transferred to a worker thread.
+Napi::Object compactTreeToJavaScript(Napi::Env env, const CompactTree &tree)
+{
+    auto result = Napi::Object::New(env);
+    result.Set("parent", typedArray(env, tree.parent));
+    result.Set("nameOffset", typedArray(env, tree.nameOffset));
+    result.Set("nameLength", typedArray(env, tree.nameLength));
+    result.Set("size", typedArray(env, tree.size));
+    result.Set("dataOffset", typedArray(env, tree.dataOffset));
+    result.Set("flags", typedArray(env, tree.flags));
+    result.Set("names", Napi::Buffer<char>::Copy(env, tree.names.data(), tree.names.size()));
+
+    return result;
+}
+
+CompactTree compactTree(PackageState &state, bool nested)
+{
+    std::lock_guard<std::mutex> lock(state.mutex);
+
+    if (state.closed)
+    {
+        throw std::runtime_error("The package has been closed.");
+    }
+
+    return BuildCompactTree(fileSystem(state), nested);
+}
+
+// Flattens the tree on the libuv threadpool; only copying the arrays into JavaScript happens on the main thread.
+class CompactTreeWorker : public Napi::AsyncWorker
+{
+public:
+    CompactTreeWorker(Napi::Env env, std::shared_ptr<PackageState> state, bool nested)
+        : Napi::AsyncWorker(env), state(std::move(state)), nested(nested), deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            tree = compactTree(*state, nested);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(compactTreeToJavaScript(Env(), tree));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::shared_ptr<PackageState> state;
+    bool nested;
+    CompactTree tree;
+    Napi::Promise::Deferred deferred;
+};
+
+// Opens a package on the libuv threadpool, where the keys are loaded and the source is opened and sniffed, and
+// resolves with the Package.
+class OpenWorker : public Napi::AsyncWorker
+{
+public:
+    OpenWorker(Napi::Env env, std::vector<std::string> args, ContainerOptions options)
+        : Napi::AsyncWorker(env), args(std::move(args)), options(std::move(options)),
+          deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            opened = openPackage(std::move(args), options);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        const auto &constructor = Env().GetInstanceData<AddonData>()->package;
+
+        deferred.Resolve(constructor.New({Napi::External<std::shared_ptr<PackageState>>::New(Env(), &opened)}));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::vector<std::string> args;
+    ContainerOptions options;
+    std::shared_ptr<PackageState> opened;
+    Napi::Promise::Deferred deferred;
+};
+
+// Produces the information document on the libuv threadpool; only converting it into JavaScript happens on the main
+// thread.
+class InfoWorker : public Napi::AsyncWorker
+{
+public:
+    InfoWorker(Napi::Env env, std::shared_ptr<PackageState> state)
+        : Napi::AsyncWorker(env), state(std::move(state)), deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+
+            if (state->closed)
+            {
+                SetError("The package has been closed.");
+                return;
+            }
+
+            document = &information(*state);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        // The document is set once and never changed afterwards, so it is read without the mutex.
+        deferred.Resolve(ToJavaScript(Env(), *document));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::shared_ptr<PackageState> state;
+    const nlohmann::ordered_json *document = nullptr;
+    Napi::Promise::Deferred deferred;
+};
+
+} // namespace
+
+Napi::Function Package::Define(Napi::Env env)
+{
+    auto function = DefineClass(
+        env,
+        "Package",
+        {
+            StaticMethod("openAsync", &Package::OpenAsync),
+            InstanceMethod("info", &Package::Info),
+            InstanceMethod("infoAsync", &Package::InfoAsync),
+            InstanceMethod("tree", &Package::Tree),
+            InstanceMethod("children", &Package::Children),
+            InstanceMethod("exportTree", &Package::ExportTree),
+            InstanceMethod("exportTreeAsync", &Package::ExportTreeAsync),
+            InstanceMethod("extract", &Package::Extract),
+            InstanceMethod("extractAsync", &Package::ExtractAsync),
+            InstanceMethod("read", &Package::Read),
+            InstanceMethod("readAsync", &Package::ReadAsync),
+            InstanceMethod("close", &Package::Close),
+        });
+
+    env.GetInstanceData<AddonData>()->package = Napi::Persistent(function);
+
+    return function;
+}
+
+// new Package(args, options) takes the nstool arguments as an array and the addon options
+// { input, access, parts, trusted }, see containerOptions().
+Package::Package(const Napi::CallbackInfo &info) : Napi::ObjectWrap<Package>(info)
+{
+    // Packages opened by openAsync() arrive open.
+    if (info[0].IsExternal())
+    {
+        state = *info[0].As<Napi::External<std::shared_ptr<PackageState>>>().Data();
+        return;
+    }
+
+    try
+    {
+        state = openPackage(StringList(info[0]), containerOptions(info[1]));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+    }
+}
+
+Napi::Value Package::OpenAsync(const Napi::CallbackInfo &info)
+{
+    auto *worker = new OpenWorker(info.Env(), StringList(info[0]), containerOptions(info[1]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value Package::Info(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(opened->mutex);
+
+        return ToJavaScript(info.Env(), information(*opened));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+// infoAsync() returns a promise of the information info() returns, produced on the libuv threadpool.
+Napi::Value Package::InfoAsync(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    auto *worker = new InfoWorker(info.Env(), opened);
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value Package::Tree(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(opened->mutex);
+        const auto &document = information(*opened);
+
+        if (!document.contains("data") || !document["data"].contains("tree"))
+        {
+            return info.Env().Undefined();
+        }
+
+        return ToJavaScript(info.Env(), document["data"]["tree"]);
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+// children(path) lists one level of the tree as [{ name, type, size }], where type is "directory", "file" or
+// "container" for a file holding a nested container whose contents children() lists in turn. Nothing below the
+// listed level is read, so browsing a large RomFS costs only the directories actually visited.
+Napi::Value Package::Children(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    const auto env = info.Env();
+    const auto path = info[0].IsUndefined() ? std::string("/") : info[0].ToString().Utf8Value();
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(opened->mutex);
+        tc::io::sDirectoryListing listing;
+
+        fileSystem(*opened).ListDirectory(path, listing);
+
+        const auto base = path.empty() || path.back() == '/' ? path : path + "/";
+        auto children = Napi::Array::New(env, listing.dir_list.size() + listing.file_list.size());
+        uint32_t index = 0;
+
+        for (const auto &name : listing.dir_list)
+        {
+            auto child = Napi::Object::New(env);
+            child.Set("name", name);
+            child.Set("type", "directory");
+            children.Set(index++, child);
+        }
+
+        for (const auto &name : listing.file_list)
+        {
+            const auto size = fileSystem(*opened).OpenFile(base + name)->length();
+
+            auto child = Napi::Object::New(env);
+            child.Set("name", name);
+            child.Set("type", Container::IsContainerName(name) ? "container" : "file");
+            child.Set("size", Napi::Number::New(env, static_cast<double>(size)));
+            children.Set(index++, child);
+        }
+
+        return children;
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(env, error.what()).ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+}
+
+// exportTree(nested) returns the whole tree as { parent, nameOffset, nameLength, size, flags, names }: typed arrays
+// with one element per entry and a Buffer holding every name, see CompactTree.
+Napi::Value Package::ExportTree(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        return compactTreeToJavaScript(info.Env(), compactTree(*opened, info[0].ToBoolean().Value()));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+Napi::Value Package::ExportTreeAsync(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    auto *worker = new CompactTreeWorker(info.Env(), opened, info[0].ToBoolean().Value());
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+// extract(outputDirectory, pathOrSelection, concurrency, chunkSize) copies a file, a directory or a selection of files
+// out of the package and reports what was written and how fast. With more than one thread, files larger than
+// chunkSize bytes (64 MiB when undefined, 0 to disable) are split into chunks decrypted in parallel.
+Napi::Value Package::Extract(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    const auto request = extractionRequest(info);
+
+    try
+    {
+        return reportToJavaScript(info.Env(), extract(*opened, request));
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+// extractAsync(outputDirectory, pathOrSelection, concurrency, chunkSize, onProgress, cancellation) extracts like
+// extract() on the libuv threadpool. onProgress, when given, receives { bytesDone, bytesTotal, currentFile, filesDone,
+// fileCount } at most every 100 ms and once at the end, before the promise settles. Cancelling the Cancellation stops
+// the copy threads at their next chunk and removes the partial output.
+Napi::Value Package::ExtractAsync(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    auto *worker =
+        new ExtractWorker(info.Env(), opened, extractionRequest(info), info[4], Cancellation::TokenFrom(info[5]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+// read(path, offset, length[, target]) decrypts a range of a file inside the package. Without a target it returns a
+// new Buffer holding the bytes; with one it fills the target from its start and returns the number of bytes read.
+// An undefined length reads to the end of the file.
+Napi::Value Package::Read(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    const auto path = info[0].ToString().Utf8Value();
+    const auto offset = info[1].IsUndefined() ? 0 : info[1].ToNumber().Int64Value();
+    const auto hasTarget = info.Length() > 3 && info[3].IsBuffer();
+
+    if (offset < 0)
+    {
+        Napi::RangeError::New(info.Env(), "The offset must not be negative.").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    try
+    {
+        std::lock_guard<std::mutex> lock(opened->mutex);
+        const auto stream = fileSystem(*opened).OpenFile(path);
+        const auto length = readableLength(*stream, offset, requestedLength(info[2]));
+
+        if (hasTarget)
+        {
+            const auto target = info[3].As<Napi::Buffer<uint8_t>>();
+            const auto size = std::min(length, target.Length());
+
+            return Napi::Number::New(
+                info.Env(), static_cast<double>(ReadAt(*stream, offset, target.Data(), size)));
+        }
+
+        auto buffer = Napi::Buffer<uint8_t>::New(info.Env(), length);
+        ReadAt(*stream, offset, buffer.Data(), buffer.Length());
+
+        return buffer;
+    }
+    catch (const std::exception &error)
+    {
+        Napi::Error::New(info.Env(), error.what()).ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+}
+
+// readAsync(path, offset, length) reads like read() on the libuv threadpool and returns a promise of a new Buffer.
+Napi::Value Package::ReadAsync(const Napi::CallbackInfo &info)
+{
+    const auto opened = Acquire(info.Env());
+
+    if (!opened)
+    {
+        return info.Env().Undefined();
+    }
+
+    const auto offset = info[1].IsUndefined() ? 0 : info[1].ToNumber().Int64Value();
+
+    if (offset < 0)
+    {
+        Napi::RangeError::New(info.Env(), "The offset must not be negative.").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    auto *worker = new ReadWorker(info.Env(), opened, info[0].ToString().Utf8Value(), offset, requestedLength(info[2]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value Package::Close(const Napi::CallbackInfo &info)
+{
+    // Work that already holds the state finishes with it, or fails at its next check; the source is released with
+    // the last reference. Nothing here waits for a read in progress.
+    if (state)
+    {
+        state->closed = true;
+    }
+
+    state.reset();
+
+    return info.Env().Undefined();
+}
+
+std::shared_ptr<PackageState> Package::Acquire(Napi::Env env) const
+{
+    if (!state)
+    {
+        Napi::Error::New(env, "The package has been closed.").ThrowAsJavaScriptException();
+    }
+
+    return state;
+}
+
+Napi::Function PackageReader::Define(Napi::Env env)
+{
+    return DefineClass(
+        env,
+        "PackageReader",
+        {
+            InstanceMethod("readAsync", &PackageReader::ReadAsync),
+            InstanceMethod("close", &PackageReader::Close),
+        });
+}
+
+PackageReader::PackageReader(const Napi::CallbackInfo &info) : Napi::ObjectWrap<PackageReader>(info)
+{
+    if (!info[0].IsObject())
+    {
+        Napi::TypeError::New(info.Env(), "A package is required.").ThrowAsJavaScriptException();
+        return;
+    }
+
+    const auto *wrapped = Package::Unwrap(info[0].As<Napi::Object>());
+
+    if (wrapped == nullptr)
+    {
+        return;
+    }
+
+    auto package = wrapped->Acquire(info.Env());
+
+    if (!package)
+    {
+        return;
+    }
+
+    file = std::make_shared<PackageFile>();
+    file->package = std::move(package);
+    file->path = info[1].ToString().Utf8Value();
+}
+
+// readAsync(offset, length) reads like Package.readAsync() from the file the reader keeps open.
+Napi::Value PackageReader::ReadAsync(const Napi::CallbackInfo &info)
+{
+    if (!file)
+    {
+        Napi::Error::New(info.Env(), "The reader has been closed.").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    const auto offset = info[0].IsUndefined() ? 0 : info[0].ToNumber().Int64Value();
+
+    if (offset < 0)
+    {
+        Napi::RangeError::New(info.Env(), "The offset must not be negative.").ThrowAsJavaScriptException();
+        return info.Env().Undefined();
+    }
+
+    auto *worker = new ReadWorker(info.Env(), file, offset, requestedLength(info[1]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}
+
+Napi::Value PackageReader::Close(const Napi::CallbackInfo &info)
+{
+    // Like Package::Close, a read in progress keeps the file until it finishes.
+    if (file)
+    {
+        file->closed = true;
+    }
+
+    file.reset();
+
+    return info.Env().Undefined();
+}
@@ -0,0 +1,66 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+void ParallelFor(size_t count, unsigned concurrency, const std::function<void(size_t index)> &work)
+{
+    const auto threadCount = std::clamp<size_t>(concurrency, 1, std::max<size_t>(1, count));
+
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    const auto run = [&]()
+    {
+        try
+        {
+            while (!failed)
+            {
+                const auto index = next++;
+
+                if (index >= count)
+                {
+                    break;
+                }
+
+                work(index);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        threads.emplace_back(run);
+    }
+
+    run();
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
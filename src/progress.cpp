@@ -0,0 +1,81 @@
+#include "progress.h"
+
+namespace
+{
+
+int64_t now()
+{
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+} // namespace
+
+ProgressMeter::ProgressMeter(
+    uint64_t bytesTotal, size_t fileCount, ProgressCallback report, std::chrono::steady_clock::duration interval)
+    : bytesTotal(bytesTotal), fileCount(fileCount), report(std::move(report)), interval(interval.count()),
+      lastReport(now())
+{
+}
+
+void ProgressMeter::FileStarted(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(currentFileMutex);
+        currentFile = path;
+    }
+
+    maybeReport();
+}
+
+void ProgressMeter::Advance(uint64_t bytes)
+{
+    bytesDone += bytes;
+    maybeReport();
+}
+
+void ProgressMeter::FileDone()
+{
+    ++filesDone;
+    maybeReport();
+}
+
+void ProgressMeter::Finish()
+{
+    if (report)
+    {
+        report(snapshot());
+    }
+}
+
+void ProgressMeter::maybeReport()
+{
+    if (!report)
+    {
+        return;
+    }
+
+    const auto current = now();
+    auto last = lastReport.load(std::memory_order_relaxed);
+
+    // Only the thread that moves the timestamp forward reports.
+    if (current - last < interval || !lastReport.compare_exchange_strong(last, current))
+    {
+        return;
+    }
+
+    report(snapshot());
+}
+
+ExtractionProgress ProgressMeter::snapshot()
+{
+    ExtractionProgress progress;
+    progress.bytesDone = bytesDone;
+    progress.bytesTotal = bytesTotal;
+    progress.filesDone = filesDone;
+    progress.fileCount = fileCount;
+
+    std::lock_guard<std::mutex> lock(currentFileMutex);
+    progress.currentFile = currentFile;
+
+    return progress;
+}
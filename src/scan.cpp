@@ -0,0 +1,309 @@
+#include "scan.h"
+
+#include "extract.h"
+#include "file-type.h"
+#include "json-value.h"
+#include "key-cache.h"
+#include "node-nstool.h"
+#include "parallel.h"
+#include "string-list.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+std::string lowercase(std::string value)
+{
+    std::transform(
+        value.begin(), value.end(), value.begin(),
+        [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+
+    return value;
+}
+
+bool isSelected(const std::filesystem::path &path, const std::vector<std::string> &extensions)
+{
+    if (extensions.empty())
+    {
+        return true;
+    }
+
+    const auto extension = FromHostPath(path.extension());
+
+    return !extension.empty() &&
+           std::find(extensions.begin(), extensions.end(), lowercase(extension.substr(1))) != extensions.end();
+}
+
+// Content archives are only recognised with the header key, so the keys the scan's arguments select are loaded, from
+// the key cache, before the file is sniffed.
+nstool::Settings::FileType sniff(const std::filesystem::path &path, const std::vector<std::string> &args)
+{
+    // Any --type will do for loading keys, and naming one keeps nstool from sniffing the file itself.
+    auto keyArgs = args;
+    keyArgs.insert(keyArgs.end(), {"--type", "nca", FromHostPath(path)});
+
+    const auto keys = KeyCache::Instance().Get(keyArgs);
+    tc::io::FileStream stream(tc::io::Path(FromHostPath(path)), tc::io::FileMode::Open, tc::io::FileAccess::Read);
+
+    return SniffFileType(stream, keys);
+}
+
+// Holds the scanning threads while the consumer's stream is full, until it is read from again.
+class FlowGate
+{
+public:
+    void Pause()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused = true;
+    }
+
+    void Resume()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused = false;
+        resumed.notify_all();
+    }
+
+    void Wait(const CancellationToken &cancellation)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        // Cancelling does not wake the gate, so look at the token now and then.
+        while (paused)
+        {
+            cancellation.ThrowIfCancelled();
+            resumed.wait_for(lock, std::chrono::milliseconds(100));
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable resumed;
+    bool paused = false;
+};
+
+// Shared by the scanning thread and the finalizer of its thread-safe function, which settles the promise once every
+// entry has been delivered.
+struct ScanState
+{
+    explicit ScanState(Napi::Env env) : deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    ScanOptions options;
+    Napi::Promise::Deferred deferred;
+    Napi::ThreadSafeFunction onEntry;
+    FlowGate gate;
+    std::thread thread;
+    std::atomic<uint32_t> count = 0;
+    std::string error;
+};
+
+// Returns false when the consumer wants no more entries for now.
+bool deliver(Napi::Env env, Napi::Function callback, ScanEntry *entry)
+{
+    bool more = true;
+
+    // Without an environment the function is being torn down and the entry is only released.
+    if (env != nullptr && callback != nullptr)
+    {
+        auto object = Napi::Object::New(env);
+        object.Set("source", entry->source);
+        object.Set("type", entry->type);
+
+        if (entry->result.document)
+        {
+            object.Set("result", ToJavaScript(env, *entry->result.document));
+        }
+        else
+        {
+            auto result = Napi::Object::New(env);
+            result.Set("error", true);
+            result.Set("errorMessage", entry->result.error);
+            object.Set("result", result);
+        }
+
+        const auto wanted = callback.Call({object});
+        more = !wanted.IsBoolean() || wanted.As<Napi::Boolean>().Value();
+    }
+
+    delete entry;
+
+    return more;
+}
+
+} // namespace
+
+std::vector<std::filesystem::path> FindCandidates(const ScanOptions &options)
+{
+    std::vector<std::filesystem::path> candidates;
+    const auto directoryOptions = std::filesystem::directory_options::skip_permission_denied;
+
+    if (!std::filesystem::is_directory(options.root))
+    {
+        throw std::runtime_error("The root to scan is not a directory: " + FromHostPath(options.root));
+    }
+
+    const auto consider = [&](const std::filesystem::directory_entry &entry)
+    {
+        std::error_code error;
+
+        options.cancellation->ThrowIfCancelled();
+
+        if (entry.is_regular_file(error) && isSelected(entry.path(), options.extensions))
+        {
+            candidates.push_back(entry.path());
+        }
+    };
+
+    std::error_code error;
+
+    if (options.recursive)
+    {
+        for (std::filesystem::recursive_directory_iterator it(options.root, directoryOptions, error), end;
+             !error && it != end; it.increment(error))
+        {
+            consider(*it);
+        }
+    }
+    else
+    {
+        for (std::filesystem::directory_iterator it(options.root, directoryOptions, error), end; !error && it != end;
+             it.increment(error))
+        {
+            consider(*it);
+        }
+    }
+
+    // Directory order differs between filesystems; sorting keeps scans of the same tree comparable.
+    std::sort(candidates.begin(), candidates.end());
+
+    return candidates;
+}
+
+void RunScan(const ScanOptions &options, const std::function<void(ScanEntry &&entry)> &emit)
+{
+    const auto candidates = FindCandidates(options);
+
+    ParallelFor(candidates.size(), options.concurrency,
+        [&](size_t index)
+        {
+            options.cancellation->ThrowIfCancelled();
+
+            ScanEntry entry;
+            entry.source = FromHostPath(candidates[index]);
+
+            try
+            {
+                const auto type = sniff(candidates[index], options.args);
+
+                if (type == nstool::Settings::FILE_TYPE_ERROR)
+                {
+                    return;
+                }
+
+                entry.type = FileTypeName(type);
+
+                auto args = options.args;
+                args.insert(args.end(), {"--type", entry.type, entry.source});
+
+                entry.result.document = parse(invoke(args, options.cancellation));
+            }
+            catch (const OperationCancelled &)
+            {
+                throw;
+            }
+            catch (const std::exception &error)
+            {
+                entry.result.error = error.what();
+            }
+
+            emit(std::move(entry));
+        });
+}
+
+Napi::Value Scan(const Napi::CallbackInfo &info)
+{
+    auto env = info.Env();
+    auto state = std::make_shared<ScanState>(env);
+
+    state->options.root = ToHostPath(info[0].ToString().Utf8Value());
+    state->options.extensions = StringList(info[1]);
+    state->options.recursive = info[2].ToBoolean().Value();
+    state->options.concurrency = info[3].IsUndefined() ? 1 : info[3].ToNumber().Uint32Value();
+    state->options.args = StringList(info[4]);
+    state->options.cancellation = Cancellation::TokenFrom(info[6]);
+
+    std::transform(
+        state->options.extensions.begin(), state->options.extensions.end(), state->options.extensions.begin(),
+        lowercase);
+
+    // A bounded queue makes the scanning threads wait while JavaScript falls behind.
+    state->onEntry = Napi::ThreadSafeFunction::New(
+        env, info[5].As<Napi::Function>(), "nstool scan", 64, 1,
+        [state](Napi::Env env)
+        {
+            state->thread.join();
+
+            if (!state->error.empty())
+            {
+                state->deferred.Reject(Napi::Error::New(env, state->error).Value());
+                return;
+            }
+
+            state->deferred.Resolve(Napi::Number::New(env, state->count));
+        });
+
+    state->thread = std::thread(
+        [state]()
+        {
+            try
+            {
+                RunScan(state->options,
+                    [&](ScanEntry &&entry)
+                    {
+                        state->gate.Wait(*state->options.cancellation);
+                        ++state->count;
+                        state->onEntry.BlockingCall(
+                            new ScanEntry(std::move(entry)),
+                            [state](Napi::Env env, Napi::Function callback, ScanEntry *entry)
+                            {
+                                // A consumer that is gone never asks again, so only a live one can hold the scan.
+                                if (!deliver(env, callback, entry) && env != nullptr)
+                                {
+                                    state->gate.Pause();
+                                }
+                            });
+                    });
+            }
+            catch (const std::exception &error)
+            {
+                state->error = error.what();
+            }
+
+            state->onEntry.Release();
+        });
+
+    auto control = Napi::Object::New(env);
+    control.Set("done", state->deferred.Promise());
+    control.Set(
+        "resume", Napi::Function::New(
+                      env,
+                      [state](const Napi::CallbackInfo &info)
+                      {
+                          state->gate.Resume();
+                          return info.Env().Undefined();
+                      }));
+
+    return control;
+}
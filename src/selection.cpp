@@ -0,0 +1,158 @@
+#include "selection.h"
+
+#include "package-fs.h"
+#include <algorithm>
+
+namespace
+{
+
+bool matchSegment(const char *pattern, const char *text)
+{
+    for (; *pattern != '\0'; ++pattern, ++text)
+    {
+        if (*pattern == '*')
+        {
+            // Try every split of the remaining text against the rest of the pattern.
+            for (const char *rest = text;; ++rest)
+            {
+                if (matchSegment(pattern + 1, rest))
+                {
+                    return true;
+                }
+
+                if (*rest == '\0')
+                {
+                    return false;
+                }
+            }
+        }
+
+        if (*text == '\0' || (*pattern != '?' && *pattern != *text))
+        {
+            return false;
+        }
+    }
+
+    return *text == '\0';
+}
+
+// Matches path segments against pattern segments. With partial set, a path that ends before the pattern does is
+// accepted when some longer path could still match.
+bool matchSegments(
+    const std::vector<std::string> &pattern, size_t p, const std::vector<std::string> &path, size_t s, bool partial)
+{
+    for (; p < pattern.size(); ++p, ++s)
+    {
+        if (s == path.size())
+        {
+            return partial || std::all_of(
+                                  pattern.begin() + static_cast<std::ptrdiff_t>(p), pattern.end(),
+                                  [](const std::string &segment) { return segment == "**"; });
+        }
+
+        if (pattern[p] == "**")
+        {
+            for (size_t rest = s; rest <= path.size(); ++rest)
+            {
+                if (matchSegments(pattern, p + 1, path, rest, partial))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        if (!matchSegment(pattern[p].c_str(), path[s].c_str()))
+        {
+            return false;
+        }
+    }
+
+    return s == path.size();
+}
+
+bool startsWith(const std::vector<std::string> &path, const std::vector<std::string> &prefix)
+{
+    return prefix.size() <= path.size() && std::equal(prefix.begin(), prefix.end(), path.begin());
+}
+
+} // namespace
+
+Selection::Selection(const std::vector<std::string> &paths, const std::vector<std::string> &patterns)
+{
+    for (const auto &path : paths)
+    {
+        this->paths.push_back(SplitVirtualPath(path));
+        requested.insert(JoinVirtualPath(this->paths.back()));
+    }
+
+    for (const auto &pattern : patterns)
+    {
+        this->patterns.push_back(SplitVirtualPath(pattern));
+    }
+}
+
+bool Selection::Matches(const std::vector<std::string> &path) const
+{
+    for (const auto &selected : paths)
+    {
+        if (startsWith(path, selected))
+        {
+            return true;
+        }
+    }
+
+    for (const auto &pattern : patterns)
+    {
+        if (matchSegments(pattern, 0, path, 0, false))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Selection::MayContain(const std::vector<std::string> &path) const
+{
+    for (const auto &selected : paths)
+    {
+        if (startsWith(selected, path) || startsWith(path, selected))
+        {
+            return true;
+        }
+    }
+
+    for (const auto &pattern : patterns)
+    {
+        if (matchSegments(pattern, 0, path, 0, true))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool Selection::IsRequested(const std::vector<std::string> &path) const
+{
+    return requested.count(JoinVirtualPath(path)) != 0;
+}
+
+const std::set<std::string> &Selection::Requested() const
+{
+    return requested;
+}
+
+std::string JoinVirtualPath(const std::vector<std::string> &parts)
+{
+    std::string joined;
+
+    for (const auto &part : parts)
+    {
+        joined += "/" + part;
+    }
+
+    return joined.empty() ? "/" : joined;
+}
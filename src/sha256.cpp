@@ -0,0 +1,386 @@
+#include "sha256.h"
+
+#include "cpu-features.h"
+#include <algorithm>
+#include <cstring>
+
+// Lets the block function below reach the state of mbedtls 3's contexts, whose members are private otherwise.
+#define MBEDTLS_ALLOW_PRIVATE_ACCESS
+#include <mbedtls/sha256.h>
+
+#if !defined(MBEDTLS_PRIVATE)
+#define MBEDTLS_PRIVATE(member) member
+#endif
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+#define NSTOOL_SHA_X86
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define NSTOOL_SHA_X86_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#define NSTOOL_SHA_X86_TARGET
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define NSTOOL_SHA_ARM64
+// The SHA2 intrinsics are only declared while the crypto extension is enabled, so enable it before <arm_neon.h> for
+// this file; dispatch makes sure the instructions only run where the CPU has them.
+#if defined(__clang__)
+#if __clang_major__ < 18
+#pragma clang attribute push(__attribute__((target("crypto"))), apply_to = function)
+#else
+#pragma clang attribute push(__attribute__((target("sha2"))), apply_to = function)
+#endif
+#define NSTOOL_SHA_ARM64_POP_CLANG
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("arch=armv8-a+crypto")
+#define NSTOOL_SHA_ARM64_POP_GCC
+#endif
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+
+constexpr uint32_t roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr uint32_t initialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+inline uint32_t rotateRight(uint32_t value, unsigned count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+
+void compressSoftware(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+    for (; count > 0; --count, blocks += 64)
+    {
+        uint32_t w[64];
+
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (uint32_t(blocks[i * 4]) << 24) | (uint32_t(blocks[i * 4 + 1]) << 16) |
+                   (uint32_t(blocks[i * 4 + 2]) << 8) | uint32_t(blocks[i * 4 + 3]);
+        }
+
+        for (int i = 16; i < 64; ++i)
+        {
+            const auto s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const auto s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int i = 0; i < 64; ++i)
+        {
+            const auto s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+            const auto choice = (e & f) ^ (~e & g);
+            const auto t1 = h + s1 + choice + roundConstants[i] + w[i];
+            const auto s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+            const auto majority = (a & b) ^ (a & c) ^ (b & c);
+            const auto t2 = s0 + majority;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#if defined(NSTOOL_SHA_X86)
+// Each group of four rounds adds the next four schedule words; sha256msg1 and sha256msg2 extend the schedule four
+// words at a time, three groups ahead of their use.
+NSTOOL_SHA_X86_TARGET void compressShaNi(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The instructions keep the state as ABEF and CDGH.
+    __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[0])), 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(&state[4])), 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (; count > 0; --count, blocks += 64)
+    {
+        const auto abefSaved = abef;
+        const auto cdghSaved = cdgh;
+        __m128i words[4];
+
+        for (int i = 0; i < 4; ++i)
+        {
+            words[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(blocks + i * 16)), byteSwap);
+        }
+
+        for (int group = 0; group < 16; ++group)
+        {
+            auto &current = words[group % 4];
+            auto &previous = words[(group + 3) % 4];
+            auto &next = words[(group + 1) % 4];
+
+            auto message = _mm_add_epi32(
+                current, _mm_loadu_si128(reinterpret_cast<const __m128i *>(&roundConstants[group * 4])));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+
+            if (group >= 3 && group <= 14)
+            {
+                next = _mm_add_epi32(next, _mm_alignr_epi8(current, previous, 4));
+                next = _mm_sha256msg2_epu32(next, current);
+            }
+
+            message = _mm_shuffle_epi32(message, 0x0E);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, message);
+
+            if (group >= 1 && group <= 12)
+            {
+                previous = _mm_sha256msg1_epu32(previous, current);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, abefSaved);
+        cdgh = _mm_add_epi32(cdgh, cdghSaved);
+    }
+
+    const auto feba = _mm_shuffle_epi32(abef, 0x1B);
+    const auto dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[0]), _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(&state[4]), _mm_alignr_epi8(dchg, feba, 8));
+}
+#endif
+
+#if defined(NSTOOL_SHA_ARM64)
+void compressArmv8(uint32_t state[8], const uint8_t *blocks, size_t count)
+{
+    uint32x4_t abcd = vld1q_u32(&state[0]);
+    uint32x4_t efgh = vld1q_u32(&state[4]);
+
+    for (; count > 0; --count, blocks += 64)
+    {
+        const auto abcdSaved = abcd;
+        const auto efghSaved = efgh;
+        uint32x4_t words[4];
+
+        for (int i = 0; i < 4; ++i)
+        {
+            words[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + i * 16)));
+        }
+
+        for (int group = 0; group < 16; ++group)
+        {
+            auto &current = words[group % 4];
+            const auto message = vaddq_u32(current, vld1q_u32(&roundConstants[group * 4]));
+
+            // Extends the schedule by the four words used three groups later.
+            if (group < 12)
+            {
+                current = vsha256su1q_u32(
+                    vsha256su0q_u32(current, words[(group + 1) % 4]), words[(group + 2) % 4], words[(group + 3) % 4]);
+            }
+
+            const auto abcdBefore = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, message);
+            efgh = vsha256h2q_u32(efgh, abcdBefore, message);
+        }
+
+        abcd = vaddq_u32(abcd, abcdSaved);
+        efgh = vaddq_u32(efgh, efghSaved);
+    }
+
+    vst1q_u32(&state[0], abcd);
+    vst1q_u32(&state[4], efgh);
+}
+#endif
+
+using BlockFunction = void (*)(uint32_t state[8], const uint8_t *blocks, size_t count);
+
+Sha256Backend detectBackend()
+{
+    for (const auto backend : {Sha256Backend::ShaNi, Sha256Backend::Armv8})
+    {
+        if (IsSha256BackendAvailable(backend))
+        {
+            return backend;
+        }
+    }
+
+    return Sha256Backend::Software;
+}
+
+BlockFunction blockFunction(Sha256Backend backend)
+{
+#if defined(NSTOOL_SHA_X86)
+    if (backend == Sha256Backend::ShaNi && IsSha256BackendAvailable(backend))
+    {
+        return compressShaNi;
+    }
+#elif defined(NSTOOL_SHA_ARM64)
+    if (backend == Sha256Backend::Armv8 && IsSha256BackendAvailable(backend))
+    {
+        return compressArmv8;
+    }
+#else
+    static_cast<void>(backend);
+#endif
+
+    return compressSoftware;
+}
+
+void storeBigEndian(uint8_t *destination, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        destination[i] = static_cast<uint8_t>(value >> (8 * (size - 1 - i)));
+    }
+}
+
+} // namespace
+
+#if defined(NSTOOL_SHA_ARM64_POP_CLANG)
+#pragma clang attribute pop
+#elif defined(NSTOOL_SHA_ARM64_POP_GCC)
+#pragma GCC pop_options
+#endif
+
+Sha256Backend ActiveSha256Backend()
+{
+    static const auto backend = detectBackend();
+
+    return backend;
+}
+
+std::string Sha256BackendName(Sha256Backend backend)
+{
+    switch (backend)
+    {
+    case Sha256Backend::ShaNi:
+        return "sha-ni";
+    case Sha256Backend::Armv8:
+        return "armv8";
+    default:
+        return "software";
+    }
+}
+
+bool IsSha256BackendAvailable(Sha256Backend backend)
+{
+    switch (backend)
+    {
+#if defined(NSTOOL_SHA_X86)
+    case Sha256Backend::ShaNi:
+        return DetectCpuFeatures().sha2;
+#endif
+#if defined(NSTOOL_SHA_ARM64)
+    case Sha256Backend::Armv8:
+        return DetectCpuFeatures().sha2;
+#endif
+    case Sha256Backend::Software:
+        return true;
+    default:
+        return false;
+    }
+}
+
+Sha256::Sha256(Sha256Backend backend) : compress(blockFunction(backend))
+{
+    std::memcpy(state, initialState, sizeof(state));
+}
+
+void Sha256::Update(const uint8_t *data, size_t size)
+{
+    length += size;
+
+    if (buffered > 0)
+    {
+        const auto taken = std::min(size, sizeof(buffer) - buffered);
+
+        std::memcpy(buffer + buffered, data, taken);
+        buffered += taken;
+        data += taken;
+        size -= taken;
+
+        if (buffered < sizeof(buffer))
+        {
+            return;
+        }
+
+        compress(state, buffer, 1);
+        buffered = 0;
+    }
+
+    // Whole blocks are hashed straight from the caller's memory.
+    compress(state, data, size / 64);
+    data += size / 64 * 64;
+    size %= 64;
+
+    std::memcpy(buffer, data, size);
+    buffered = size;
+}
+
+Sha256Hash Sha256::Finalize()
+{
+    const auto bits = length * 8;
+    uint8_t padding[128] = {0x80};
+    const auto paddingSize = (buffered < 56 ? 56 : 120) - buffered;
+
+    storeBigEndian(padding + paddingSize, bits, 8);
+    Update(padding, paddingSize + 8);
+
+    Sha256Hash hash;
+
+    for (int i = 0; i < 8; ++i)
+    {
+        storeBigEndian(hash.data() + i * 4, state[i], 4);
+    }
+
+    return hash;
+}
+
+Sha256Hash Sha256Digest(const uint8_t *data, size_t size)
+{
+    Sha256 hash;
+    hash.Update(data, size);
+
+    return hash.Finalize();
+}
+
+#if defined(MBEDTLS_SHA256_PROCESS_ALT)
+// mbedtls compresses every 64-byte block through this function when MBEDTLS_SHA256_PROCESS_ALT is set, see
+// scripts/mbedtls-config.h. That includes the hierarchical hash layers libpietendo checks while NCA sections are read,
+// so they run on the same backend as the addon's own hashing.
+extern "C" int mbedtls_internal_sha256_process(mbedtls_sha256_context *ctx, const unsigned char data[64])
+{
+    static const auto compress = blockFunction(ActiveSha256Backend());
+
+    compress(ctx->MBEDTLS_PRIVATE(state), data, 1);
+
+    return 0;
+}
+#endif
@@ -0,0 +1,280 @@
+#include "split-source.h"
+#include "extract.h"
+#include "package-fs.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <system_error>
+
+namespace
+{
+const std::string moduleName = "ConcatenatedStream";
+
+bool isDigit(char character)
+{
+    return std::isdigit(static_cast<unsigned char>(character)) != 0;
+}
+
+bool exists(const std::string &path)
+{
+    std::error_code error;
+
+    return std::filesystem::is_regular_file(ToHostPath(path), error);
+}
+
+// prefix + "0", prefix + "1", ... (or "00", "01", ... with two digits) for as long as the files exist.
+std::vector<std::string> numberedParts(const std::string &prefix, size_t digits)
+{
+    std::vector<std::string> parts;
+    const auto limit = digits == 1 ? 10 : 100;
+
+    for (int number = 0; number < limit; ++number)
+    {
+        auto suffix = std::to_string(number);
+        suffix.insert(0, digits - suffix.size(), '0');
+
+        if (!exists(prefix + suffix))
+        {
+            break;
+        }
+
+        parts.push_back(prefix + suffix);
+    }
+
+    return parts;
+}
+
+std::string lowercase(std::string text)
+{
+    std::transform(
+        text.begin(), text.end(), text.begin(),
+        [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+
+    return text;
+}
+
+bool endsWith(const std::string &text, const std::string &suffix)
+{
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Whether a name, such as that of an archive-bit directory, ends in a package extension.
+bool isPackageName(const std::string &name)
+{
+    const auto lower = lowercase(name);
+
+    return endsWith(lower, ".nsp") || endsWith(lower, ".xci");
+}
+
+// The path with its part number removed and the number of digits in it, or no digits when the name is not that of
+// a part: "game.xc0" and "game.ns0", "game.nsp.00" and "game.xci.00", or "00" inside an archive-bit directory.
+std::pair<std::string, size_t> partPrefix(const std::string &path)
+{
+    const auto separator = path.find_last_of("/\\");
+    const auto name = path.substr(separator == std::string::npos ? 0 : separator + 1);
+    const auto size = name.size();
+
+    if (size >= 4 && name[size - 4] == '.' && isDigit(name[size - 1]))
+    {
+        const auto letters = lowercase(name.substr(size - 3, 2));
+
+        if (letters == "xc" || letters == "ns")
+        {
+            return {path.substr(0, path.size() - 1), 1};
+        }
+    }
+
+    if (size < 2 || !isDigit(name[size - 2]) || !isDigit(name[size - 1]))
+    {
+        return {path, 0};
+    }
+
+    if (size > 3 && name[size - 3] == '.' && isPackageName(name.substr(0, size - 3)))
+    {
+        return {path.substr(0, path.size() - 2), 2};
+    }
+
+    if (size == 2 && separator != std::string::npos)
+    {
+        const auto parent = path.substr(0, separator);
+        const auto parentSeparator = parent.find_last_of("/\\");
+
+        if (isPackageName(parent.substr(parentSeparator == std::string::npos ? 0 : parentSeparator + 1)))
+        {
+            return {path.substr(0, path.size() - 2), 2};
+        }
+    }
+
+    return {path, 0};
+}
+} // namespace
+
+std::vector<std::string> FindSplitParts(const std::string &path)
+{
+    std::error_code error;
+
+    if (std::filesystem::is_directory(ToHostPath(path), error))
+    {
+        auto directory = path;
+
+        while (directory.size() > 1 && (directory.back() == '/' || directory.back() == '\\'))
+        {
+            directory.pop_back();
+        }
+
+        const auto separator = directory.find_last_of("/\\");
+
+        if (!isPackageName(directory.substr(separator == std::string::npos ? 0 : separator + 1)))
+        {
+            return {path};
+        }
+
+        auto parts = numberedParts(directory + "/", 2);
+
+        return parts.empty() ? std::vector<std::string>{path} : parts;
+    }
+
+    const auto [prefix, digits] = partPrefix(path);
+
+    if (digits == 0)
+    {
+        return {path};
+    }
+
+    auto parts = numberedParts(prefix, digits);
+
+    // A numbered file whose first parts are missing is read on its own.
+    if (std::find(parts.begin(), parts.end(), path) == parts.end())
+    {
+        return {path};
+    }
+
+    return parts;
+}
+
+ConcatenatedStream::ConcatenatedStream(const std::vector<std::shared_ptr<tc::io::IStream>> &parts)
+{
+    for (const auto &stream : parts)
+    {
+        const auto length = stream->length();
+
+        this->parts.push_back({stream, size, length});
+        size += length;
+    }
+}
+
+bool ConcatenatedStream::canRead() const
+{
+    return !parts.empty();
+}
+
+bool ConcatenatedStream::canWrite() const
+{
+    return false;
+}
+
+bool ConcatenatedStream::canSeek() const
+{
+    return !parts.empty();
+}
+
+int64_t ConcatenatedStream::length()
+{
+    if (parts.empty())
+    {
+        throw tc::ObjectDisposedException(moduleName, "The stream has been disposed.");
+    }
+
+    return size;
+}
+
+int64_t ConcatenatedStream::position()
+{
+    return offset;
+}
+
+size_t ConcatenatedStream::read(byte_t *ptr, size_t count)
+{
+    const auto available = std::max<int64_t>(length() - offset, 0);
+    const auto wanted = static_cast<size_t>(std::min<int64_t>(static_cast<int64_t>(count), available));
+    size_t total = 0;
+
+    // The last part that starts at or before the position.
+    auto part = std::upper_bound(
+                    parts.begin(), parts.end(), offset,
+                    [](int64_t position, const Part &candidate) { return position < candidate.start; }) -
+                1;
+
+    for (; total < wanted && part != parts.end(); ++part)
+    {
+        const auto within = offset + static_cast<int64_t>(total) - part->start;
+        const auto size = static_cast<size_t>(std::min<int64_t>(
+            static_cast<int64_t>(wanted - total), std::max<int64_t>(part->length - within, 0)));
+        const auto count = ReadAt(*part->stream, within, ptr + total, size);
+
+        total += count;
+
+        // A part that is shorter than it was when the stream was opened ends the read.
+        if (count != size)
+        {
+            break;
+        }
+    }
+
+    offset += static_cast<int64_t>(total);
+
+    return total;
+}
+
+size_t ConcatenatedStream::write(const byte_t *, size_t)
+{
+    throw tc::NotSupportedException(moduleName, "The stream is read-only.");
+}
+
+int64_t ConcatenatedStream::seek(int64_t offset, tc::io::SeekOrigin origin)
+{
+    const auto base = origin == tc::io::SeekOrigin::Begin     ? 0
+                      : origin == tc::io::SeekOrigin::Current ? this->offset
+                                                              : length();
+
+    if (base + offset < 0)
+    {
+        throw tc::ArgumentOutOfRangeException(moduleName, "The seek would move before the start of the stream.");
+    }
+
+    this->offset = base + offset;
+
+    return this->offset;
+}
+
+void ConcatenatedStream::setLength(int64_t)
+{
+    throw tc::NotSupportedException(moduleName, "The stream is read-only.");
+}
+
+void ConcatenatedStream::flush()
+{
+}
+
+void ConcatenatedStream::dispose()
+{
+    for (const auto &part : parts)
+    {
+        part.stream->dispose();
+    }
+
+    parts.clear();
+}
+
+Napi::Value SplitParts(const Napi::CallbackInfo &info)
+{
+    const auto parts = FindSplitParts(info[0].ToString().Utf8Value());
+    auto result = Napi::Array::New(info.Env(), parts.size());
+
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        result.Set(static_cast<uint32_t>(i), Napi::String::New(info.Env(), parts[i]));
+    }
+
+    return result;
+}
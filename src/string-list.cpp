@@ -0,0 +1,21 @@
+#include "string-list.h"
+
+std::vector<std::string> StringList(const Napi::Value &value)
+{
+    std::vector<std::string> strings;
+
+    if (!value.IsArray())
+    {
+        return strings;
+    }
+
+    const auto array = value.As<Napi::Array>();
+    strings.reserve(array.Length());
+
+    for (uint32_t i = 0; i < array.Length(); ++i)
+    {
+        strings.push_back(array.Get(i).ToString().Utf8Value());
+    }
+
+    return strings;
+}
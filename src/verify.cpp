@@ -0,0 +1,676 @@
+#include "verify.h"
+
+#include "file-type.h"
+#include "package-fs.h"
+#include "parallel.h"
+#include "selection.h"
+#include "sha256.h"
+#include "string-list.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+
+namespace
+{
+
+// Files are handed to the threads in chunks of this size, so one large section keeps every thread busy.
+constexpr uint64_t chunkSize = 16 * 1024 * 1024;
+constexpr size_t readSize = 1024 * 1024;
+// The granularity a failing chunk is searched with for its first bad offset, the smallest hash block size in use.
+constexpr size_t probeSize = 0x4000;
+
+constexpr size_t hfs0HeaderSize = 0x10;
+constexpr size_t hfs0EntrySize = 0x40;
+// Far more than any partition filesystem holds; a larger count means the header is not one.
+constexpr uint32_t hfs0MaximumEntries = 0x10000;
+
+template <typename T> T readLittleEndian(const byte_t *data)
+{
+    T value = 0;
+
+    for (size_t i = 0; i < sizeof(T); ++i)
+    {
+        value |= static_cast<T>(data[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+struct Hfs0Entry
+{
+    std::string name;
+    // Absolute in the source.
+    int64_t offset;
+    uint64_t size;
+    uint32_t hashTargetSize;
+    uint64_t hashTargetOffset;
+    Sha256Hash hash;
+};
+
+std::vector<Hfs0Entry> readHfs0(tc::io::IStream &source, int64_t offset)
+{
+    byte_t header[hfs0HeaderSize];
+
+    if (ReadAt(source, offset, header, sizeof(header)) != sizeof(header) || std::memcmp(header, "HFS0", 4) != 0)
+    {
+        throw std::runtime_error("No partition filesystem at offset " + std::to_string(offset) + ".");
+    }
+
+    const auto count = readLittleEndian<uint32_t>(header + 4);
+    const auto stringTableSize = readLittleEndian<uint32_t>(header + 8);
+
+    if (count > hfs0MaximumEntries)
+    {
+        throw std::runtime_error("The partition filesystem at offset " + std::to_string(offset) + " is corrupt.");
+    }
+
+    std::vector<byte_t> table(count * hfs0EntrySize + stringTableSize);
+
+    if (ReadAt(source, offset + hfs0HeaderSize, table.data(), table.size()) != table.size())
+    {
+        throw std::runtime_error("The partition filesystem at offset " + std::to_string(offset) + " is truncated.");
+    }
+
+    const auto dataOffset = offset + static_cast<int64_t>(hfs0HeaderSize + table.size());
+    const auto *strings = reinterpret_cast<const char *>(table.data() + count * hfs0EntrySize);
+    std::vector<Hfs0Entry> entries;
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const auto *entry = table.data() + i * hfs0EntrySize;
+        const auto nameOffset = readLittleEndian<uint32_t>(entry + 16);
+        Hfs0Entry parsed;
+
+        if (nameOffset < stringTableSize)
+        {
+            parsed.name.assign(strings + nameOffset, strnlen(strings + nameOffset, stringTableSize - nameOffset));
+        }
+
+        parsed.offset = dataOffset + static_cast<int64_t>(readLittleEndian<uint64_t>(entry));
+        parsed.size = readLittleEndian<uint64_t>(entry + 8);
+        parsed.hashTargetSize = readLittleEndian<uint32_t>(entry + 20);
+        parsed.hashTargetOffset = readLittleEndian<uint64_t>(entry + 24);
+        std::memcpy(parsed.hash.data(), entry + 32, parsed.hash.size());
+
+        entries.push_back(std::move(parsed));
+    }
+
+    return entries;
+}
+
+// One region to check: a hashed range of the raw source, or a chunk of a file read through its section's stream
+// stack, which checks the hash blocks it reads.
+struct VerificationUnit
+{
+    size_t section;
+    std::string path;
+    int64_t offset;
+    uint64_t length;
+    std::optional<Sha256Hash> expected;
+};
+
+struct VerificationPlan
+{
+    std::vector<SectionVerification> sections;
+    std::vector<VerificationUnit> units;
+    std::map<std::string, size_t> sectionIndex;
+
+    size_t Section(const std::string &path, const std::string &kind)
+    {
+        const auto [found, added] = sectionIndex.emplace(path, sections.size());
+
+        if (added)
+        {
+            SectionVerification section;
+            section.section = path;
+            section.kind = kind;
+            section.coverage = kind == "hfs0" ? "full" : "files";
+            sections.push_back(std::move(section));
+        }
+
+        return found->second;
+    }
+
+    void Add(VerificationUnit unit, bool newRegion)
+    {
+        auto &section = sections[unit.section];
+        section.bytes += unit.length;
+        section.regions += newRegion ? 1 : 0;
+
+        units.push_back(std::move(unit));
+    }
+
+    void Fail(size_t section, const std::string &error)
+    {
+        sections[section].ok = false;
+
+        if (sections[section].error.empty())
+        {
+            sections[section].error = error;
+        }
+    }
+};
+
+// The gamecard header at 0x100 holds the location and hash of the root partition filesystem. Its entries are the
+// partitions, hashed over their headers, and the entries of each partition are hashed over their first bytes.
+void planGamecard(tc::io::IStream &source, VerificationPlan &plan)
+{
+    byte_t header[0x200];
+    int64_t base = -1;
+
+    // Dumps that keep the card's initial data start 0x1000 bytes later.
+    for (const int64_t candidate : {0, 0x1000})
+    {
+        if (ReadAt(source, candidate, header, sizeof(header)) == sizeof(header) &&
+            std::memcmp(header + 0x100, "HEAD", 4) == 0)
+        {
+            base = candidate;
+            break;
+        }
+    }
+
+    const auto root = plan.Section("/", "hfs0");
+
+    if (base < 0)
+    {
+        plan.Fail(root, "The gamecard header was not found.");
+        return;
+    }
+
+    const auto rootOffset = base + static_cast<int64_t>(readLittleEndian<uint64_t>(header + 0x130));
+    Sha256Hash rootHash;
+    std::memcpy(rootHash.data(), header + 0x140, rootHash.size());
+
+    plan.Add({root, "/", rootOffset, readLittleEndian<uint64_t>(header + 0x138), rootHash}, true);
+
+    std::vector<Hfs0Entry> partitions;
+
+    try
+    {
+        partitions = readHfs0(source, rootOffset);
+    }
+    catch (const std::exception &error)
+    {
+        plan.Fail(root, error.what());
+        return;
+    }
+
+    for (const auto &partition : partitions)
+    {
+        const auto path = "/" + partition.name;
+
+        if (partition.hashTargetSize > 0)
+        {
+            plan.Add(
+                {root, path, partition.offset + static_cast<int64_t>(partition.hashTargetOffset),
+                 partition.hashTargetSize, partition.hash},
+                true);
+        }
+
+        if (partition.size == 0)
+        {
+            continue;
+        }
+
+        const auto section = plan.Section(path, "hfs0");
+
+        try
+        {
+            for (const auto &entry : readHfs0(source, partition.offset))
+            {
+                if (entry.hashTargetSize > 0)
+                {
+                    plan.Add(
+                        {section, path + "/" + entry.name, entry.offset + static_cast<int64_t>(entry.hashTargetOffset),
+                         entry.hashTargetSize, entry.hash},
+                        true);
+                }
+            }
+        }
+        catch (const std::exception &error)
+        {
+            plan.Fail(section, error.what());
+        }
+    }
+}
+
+bool isContentArchiveName(const std::string &name)
+{
+    return FileTypeFromExtension(name) == nstool::Settings::FILE_TYPE_NCA;
+}
+
+// The section directory a file belongs to, such as "/secure/<id>.nca/0", or an empty string for files outside any
+// content archive, which carry no hashes of their own.
+std::string sectionOf(const std::vector<std::string> &segments, bool sourceIsContentArchive)
+{
+    std::optional<size_t> sectionSegment = sourceIsContentArchive ? std::optional<size_t>(0) : std::nullopt;
+
+    for (size_t i = 0; i + 1 < segments.size(); ++i)
+    {
+        if (isContentArchiveName(segments[i]))
+        {
+            sectionSegment = i + 1;
+        }
+    }
+
+    if (!sectionSegment || *sectionSegment + 1 >= segments.size())
+    {
+        return "";
+    }
+
+    return JoinVirtualPath(std::vector<std::string>(segments.begin(), segments.begin() + *sectionSegment + 1));
+}
+
+void planContents(
+    PackageFileSystem &fileSystem, std::vector<std::string> &segments, bool sourceIsContentArchive,
+    VerificationPlan &plan)
+{
+    const auto path = JoinVirtualPath(segments);
+    tc::io::sDirectoryListing listing;
+
+    try
+    {
+        fileSystem.ListDirectory(path, listing);
+    }
+    catch (const std::exception &error)
+    {
+        // A content archive that cannot be mounted, for example for want of its keys.
+        plan.Fail(plan.Section(path, "nca"), error.what());
+        return;
+    }
+
+    for (const auto &name : listing.file_list)
+    {
+        segments.push_back(name);
+
+        const auto section = sectionOf(segments, sourceIsContentArchive);
+
+        if (Container::IsContainerName(name))
+        {
+            planContents(fileSystem, segments, sourceIsContentArchive, plan);
+        }
+        else if (!section.empty())
+        {
+            const auto filePath = JoinVirtualPath(segments);
+            const auto index = plan.Section(section, "nca");
+
+            try
+            {
+                const auto size = static_cast<uint64_t>(fileSystem.OpenFile(filePath)->length());
+
+                plan.Add({index, filePath, 0, std::min(size, chunkSize), std::nullopt}, true);
+
+                for (uint64_t offset = chunkSize; offset < size; offset += chunkSize)
+                {
+                    plan.Add(
+                        {index, filePath, static_cast<int64_t>(offset), std::min(chunkSize, size - offset),
+                         std::nullopt},
+                        false);
+                }
+            }
+            catch (const std::exception &error)
+            {
+                plan.Fail(index, error.what());
+            }
+        }
+
+        segments.pop_back();
+    }
+
+    for (const auto &name : listing.dir_list)
+    {
+        segments.push_back(name);
+        planContents(fileSystem, segments, sourceIsContentArchive, plan);
+        segments.pop_back();
+    }
+}
+
+// The first failure seen in a section, by region order and then offset, whatever order the threads finish in.
+struct Failure
+{
+    size_t unit;
+    int64_t offset;
+    std::string error;
+};
+
+class Verifier
+{
+public:
+    Verifier(
+        const std::shared_ptr<const Container> &container, const VerificationPlan &plan,
+        const CancellationToken &cancellation)
+        : container(container), plan(plan), cancellation(cancellation)
+    {
+    }
+
+    void Run(unsigned concurrency)
+    {
+        ParallelFor(
+            concurrency, concurrency,
+            [&](size_t)
+            {
+                PackageFileSystem fileSystem(container);
+                const auto source = container->OpenSource();
+                std::vector<byte_t> buffer(readSize);
+
+                for (auto index = next++; index < plan.units.size(); index = next++)
+                {
+                    cancellation.ThrowIfCancelled();
+
+                    const auto &unit = plan.units[index];
+
+                    if (unit.expected)
+                    {
+                        checkHashedRegion(index, *source, buffer);
+                    }
+                    else
+                    {
+                        checkFileChunk(index, fileSystem, buffer);
+                    }
+                }
+            });
+    }
+
+    uint64_t Bytes() const
+    {
+        return bytes;
+    }
+
+    const std::map<size_t, Failure> &Failures() const
+    {
+        return failures;
+    }
+
+private:
+    void checkHashedRegion(size_t index, tc::io::IStream &source, std::vector<byte_t> &buffer)
+    {
+        const auto &unit = plan.units[index];
+        Sha256 hash;
+        uint64_t done = 0;
+
+        while (done < unit.length)
+        {
+            const auto wanted = static_cast<size_t>(std::min<uint64_t>(buffer.size(), unit.length - done));
+            const auto count = ReadAt(source, unit.offset + static_cast<int64_t>(done), buffer.data(), wanted);
+
+            if (count == 0)
+            {
+                break;
+            }
+
+            hash.Update(buffer.data(), count);
+            done += count;
+        }
+
+        bytes += done;
+
+        if (done < unit.length)
+        {
+            fail(index, unit.offset + static_cast<int64_t>(done), "The hashed region ends past the end of the source.");
+        }
+        else if (hash.Finalize() != *unit.expected)
+        {
+            fail(index, unit.offset, "The hash of " + unit.path + " does not match.");
+        }
+    }
+
+    void checkFileChunk(size_t index, PackageFileSystem &fileSystem, std::vector<byte_t> &buffer)
+    {
+        const auto &unit = plan.units[index];
+        uint64_t done = 0;
+
+        try
+        {
+            const auto stream = fileSystem.OpenFile(unit.path);
+
+            while (done < unit.length)
+            {
+                cancellation.ThrowIfCancelled();
+
+                const auto wanted = static_cast<size_t>(std::min<uint64_t>(buffer.size(), unit.length - done));
+                const auto count = ReadAt(*stream, unit.offset + static_cast<int64_t>(done), buffer.data(), wanted);
+
+                if (count == 0)
+                {
+                    fail(index, unit.offset + static_cast<int64_t>(done), unit.path + " ends early.");
+                    break;
+                }
+
+                done += count;
+            }
+        }
+        catch (const OperationCancelled &)
+        {
+            throw;
+        }
+        catch (const std::exception &error)
+        {
+            fail(index, locate(fileSystem, unit, unit.offset + static_cast<int64_t>(done)), error.what());
+        }
+
+        bytes += done;
+    }
+
+    // Narrows a failed read down to the first probe-sized block that cannot be read, starting where it failed.
+    int64_t locate(PackageFileSystem &fileSystem, const VerificationUnit &unit, int64_t from)
+    {
+        std::vector<byte_t> probe(probeSize);
+        const auto end = unit.offset + static_cast<int64_t>(unit.length);
+
+        try
+        {
+            const auto stream = fileSystem.OpenFile(unit.path);
+
+            for (auto offset = from; offset < end; offset += probeSize)
+            {
+                try
+                {
+                    const auto size = static_cast<size_t>(std::min<int64_t>(probeSize, end - offset));
+                    ReadAt(*stream, offset, probe.data(), size);
+                }
+                catch (const std::exception &)
+                {
+                    return offset;
+                }
+            }
+        }
+        catch (const std::exception &)
+        {
+            // The file cannot even be opened again; report where the read failed.
+        }
+
+        return from;
+    }
+
+    void fail(size_t index, int64_t offset, const std::string &error)
+    {
+        std::lock_guard<std::mutex> lock(failureMutex);
+
+        const auto section = plan.units[index].section;
+        const auto found = failures.find(section);
+
+        if (found == failures.end() || std::tie(index, offset) < std::tie(found->second.unit, found->second.offset))
+        {
+            failures[section] = {index, offset, error};
+        }
+    }
+
+    std::shared_ptr<const Container> container;
+    const VerificationPlan &plan;
+    const CancellationToken &cancellation;
+    std::atomic<size_t> next = 0;
+    std::atomic<uint64_t> bytes = 0;
+    std::mutex failureMutex;
+    std::map<size_t, Failure> failures;
+};
+
+Napi::Object reportToJavaScript(Napi::Env env, const VerificationReport &report)
+{
+    auto sections = Napi::Array::New(env, report.sections.size());
+
+    for (uint32_t i = 0; i < report.sections.size(); ++i)
+    {
+        const auto &section = report.sections[i];
+        auto object = Napi::Object::New(env);
+
+        object.Set("section", section.section);
+        object.Set("kind", section.kind);
+        object.Set("coverage", section.coverage);
+        object.Set("ok", section.ok);
+        object.Set("bytes", static_cast<double>(section.bytes));
+        object.Set("regions", static_cast<double>(section.regions));
+
+        if (section.firstBadOffset >= 0)
+        {
+            auto firstBad = Napi::Object::New(env);
+            firstBad.Set("path", section.firstBadPath);
+            firstBad.Set("offset", static_cast<double>(section.firstBadOffset));
+            object.Set("firstBad", firstBad);
+        }
+        else
+        {
+            object.Set("firstBad", env.Null());
+        }
+
+        if (!section.error.empty())
+        {
+            object.Set("error", section.error);
+        }
+
+        sections.Set(i, object);
+    }
+
+    auto throughput = Napi::Object::New(env);
+    throughput.Set("bytes", static_cast<double>(report.bytes));
+    throughput.Set("seconds", report.seconds);
+    throughput.Set("bytesPerSecond", report.seconds > 0 ? static_cast<double>(report.bytes) / report.seconds : 0);
+    throughput.Set("concurrency", report.concurrency);
+
+    auto result = Napi::Object::New(env);
+    result.Set("ok", report.Ok());
+    result.Set("sections", sections);
+    result.Set("throughput", throughput);
+
+    return result;
+}
+
+class VerifyWorker : public Napi::AsyncWorker
+{
+public:
+    VerifyWorker(
+        Napi::Env env, std::vector<std::string> args, ContainerOptions options, unsigned concurrency,
+        std::shared_ptr<CancellationToken> cancellation)
+        : Napi::AsyncWorker(env), args(std::move(args)), options(std::move(options)), concurrency(concurrency),
+          cancellation(std::move(cancellation)), deferred(Napi::Promise::Deferred::New(env))
+    {
+    }
+
+    Napi::Promise GetPromise() const
+    {
+        return deferred.Promise();
+    }
+
+protected:
+    void Execute() override
+    {
+        try
+        {
+            report = RunVerification(Container::Open(args, options), concurrency, *cancellation);
+        }
+        catch (const std::exception &error)
+        {
+            SetError(error.what());
+        }
+    }
+
+    void OnOK() override
+    {
+        deferred.Resolve(reportToJavaScript(Env(), report));
+    }
+
+    void OnError(const Napi::Error &error) override
+    {
+        deferred.Reject(error.Value());
+    }
+
+private:
+    std::vector<std::string> args;
+    ContainerOptions options;
+    unsigned concurrency;
+    std::shared_ptr<CancellationToken> cancellation;
+    VerificationReport report;
+    Napi::Promise::Deferred deferred;
+};
+
+} // namespace
+
+bool VerificationReport::Ok() const
+{
+    return std::all_of(
+        sections.begin(), sections.end(), [](const SectionVerification &section) { return section.ok; });
+}
+
+VerificationReport RunVerification(
+    const std::shared_ptr<const Container> &container, unsigned concurrency, const CancellationToken &cancellation)
+{
+    const auto started = std::chrono::steady_clock::now();
+    VerificationPlan plan;
+
+    if (container->Type() == nstool::Settings::FILE_TYPE_GAMECARD)
+    {
+        planGamecard(*container->OpenSource(), plan);
+    }
+
+    PackageFileSystem fileSystem(container);
+    std::vector<std::string> segments;
+
+    planContents(fileSystem, segments, container->Type() == nstool::Settings::FILE_TYPE_NCA, plan);
+
+    VerificationReport report;
+    report.concurrency = std::clamp<unsigned>(concurrency, 1, std::max<unsigned>(1, plan.units.size()));
+
+    Verifier verifier(container, plan, cancellation);
+    verifier.Run(report.concurrency);
+
+    report.sections = std::move(plan.sections);
+
+    for (const auto &[section, failure] : verifier.Failures())
+    {
+        auto &verification = report.sections[section];
+
+        verification.ok = false;
+        verification.firstBadPath = plan.units[failure.unit].path;
+        verification.firstBadOffset = failure.offset;
+
+        if (verification.error.empty())
+        {
+            verification.error = failure.error;
+        }
+    }
+
+    report.bytes = verifier.Bytes();
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    return report;
+}
+
+Napi::Value Verify(const Napi::CallbackInfo &info)
+{
+    const auto concurrency = info[1].IsUndefined() ? 1 : info[1].ToNumber().Uint32Value();
+    ContainerOptions options;
+    options.parts = StringList(info[3]);
+
+    auto *worker = new VerifyWorker(
+        info.Env(), StringList(info[0]), std::move(options), concurrency, Cancellation::TokenFrom(info[2]));
+    auto promise = worker->GetPromise();
+
+    worker->Queue();
+
+    return promise;
+}